@@ -0,0 +1,276 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/block_compression.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "math/math_utility.h"
+#include "math/vector.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BC1.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Quantizes a component in range [0,255] to the range [0,max_value].
+static inline uint16_t quantize_component(float value, float max_value) {
+    return (uint16_t)(float_clamp(value, 0.0f, 255.0f) * max_value / 255.0f +
+                      0.5f);
+}
+
+// Packs a color to the 16-bit RGB565 format.
+static inline uint16_t pack_rgb565(vector3 color) {
+    uint16_t r = quantize_component(color.r, 31.0f);
+    uint16_t g = quantize_component(color.g, 63.0f);
+    uint16_t b = quantize_component(color.b, 31.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// Unpacks a RGB565 color to 8 bits per component. The high bits are replicated
+// into the low bits so that 0 maps to 0 and the maximum maps to 255.
+static inline void unpack_rgb565(uint8_t rgb[3], uint16_t color) {
+    uint8_t r = (color >> 11) & 0x1F;
+    uint8_t g = (color >> 5) & 0x3F;
+    uint8_t b = color & 0x1F;
+    rgb[0] = (uint8_t)((r << 3) | (r >> 2));
+    rgb[1] = (uint8_t)((g << 2) | (g >> 4));
+    rgb[2] = (uint8_t)((b << 3) | (b >> 2));
+}
+
+// Builds the four colors that the 2-bit indices of a BC1 block refer to.
+static void build_bc1_palette(uint8_t palette[4][3], uint16_t color0,
+                              uint16_t color1) {
+    unpack_rgb565(palette[0], color0);
+    unpack_rgb565(palette[1], color1);
+    for (int c = 0; c < 3; c++) {
+        int c0 = palette[0][c];
+        int c1 = palette[1][c];
+        if (color0 > color1) {
+            // Four-color mode.
+            palette[2][c] = (uint8_t)((2 * c0 + c1 + 1) / 3);
+            palette[3][c] = (uint8_t)((c0 + 2 * c1 + 1) / 3);
+        } else {
+            // Three-color mode, the fourth color is transparent black.
+            palette[2][c] = (uint8_t)((c0 + c1 + 1) / 2);
+            palette[3][c] = 0;
+        }
+    }
+}
+
+// Finds the axis along which the colors vary the most, that is the eigenvector
+// with the largest eigenvalue of the covariance matrix. Uses power iteration,
+// refer to:
+// https://en.wikipedia.org/wiki/Power_iteration
+// Returns a zero vector if the colors do not vary.
+static vector3 find_principal_axis(const uint8_t texels[16][3],
+                                   vector3 mean) {
+    float covariance[3][3] = {{0.0f}};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {texels[i][0] - mean.r, texels[i][1] - mean.g,
+                      texels[i][2] - mean.b};
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++) {
+                covariance[row][column] += d[row] * d[column];
+            }
+        }
+    }
+    // Start from the channel with the largest variance. A fixed start such as
+    // (1, 1, 1) fails when the axis is orthogonal to it, for example in a
+    // block of red and green texels, where the iteration converges to zero.
+    int largest = 0;
+    for (int c = 1; c < 3; c++) {
+        if (covariance[c][c] > covariance[largest][largest]) {
+            largest = c;
+        }
+    }
+    if (covariance[largest][largest] == 0.0f) {
+        return VECTOR3_ZERO;
+    }
+    vector3 axis = VECTOR3_ZERO;
+    axis.elements[largest] = 1.0f;
+    for (int iteration = 0; iteration < 8; iteration++) {
+        vector3 next = VECTOR3_ZERO;
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++) {
+                next.elements[row] +=
+                    covariance[row][column] * axis.elements[column];
+            }
+        }
+        axis = vector3_normalize(next);
+    }
+    return axis;
+}
+
+void encode_bc1_block(uint8_t block[BC1_BLOCK_SIZE],
+                      const uint8_t texels[16][3]) {
+    vector3 mean = VECTOR3_ZERO;
+    for (int i = 0; i < 16; i++) {
+        mean.r += texels[i][0];
+        mean.g += texels[i][1];
+        mean.b += texels[i][2];
+    }
+    mean = vector3_multiply_scalar(mean, 1.0f / 16.0f);
+
+    // Use the extreme colors projected onto the principal axis as endpoints.
+    // If the axis is a zero vector, use the corners of the bounding box of the
+    // colors instead, which are the same color if all colors are the same.
+    vector3 axis = find_principal_axis(texels, mean);
+    vector3 min_color = {{INFINITY, INFINITY, INFINITY}};
+    vector3 max_color = {{-INFINITY, -INFINITY, -INFINITY}};
+    float min_projection = 0.0f;
+    float max_projection = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        vector3 color = (vector3){{texels[i][0], texels[i][1], texels[i][2]}};
+        float projection = vector3_dot(vector3_subtract(color, mean), axis);
+        min_projection = float_min(min_projection, projection);
+        max_projection = float_max(max_projection, projection);
+        min_color = vector3_min(min_color, color);
+        max_color = vector3_max(max_color, color);
+    }
+    if (vector3_magnitude_squared(axis) != 0.0f) {
+        max_color =
+            vector3_add(mean, vector3_multiply_scalar(axis, max_projection));
+        min_color =
+            vector3_add(mean, vector3_multiply_scalar(axis, min_projection));
+    }
+    uint16_t color0 = pack_rgb565(max_color);
+    uint16_t color1 = pack_rgb565(min_color);
+    // The four-color mode requires color0 > color1.
+    if (color0 < color1) {
+        uint16_t temp = color0;
+        color0 = color1;
+        color1 = temp;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        uint8_t palette[4][3];
+        build_bc1_palette(palette, color0, color1);
+        for (int i = 0; i < 16; i++) {
+            int best_index = 0;
+            int best_distance = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = texels[i][c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_index = p;
+                }
+            }
+            indices |= (uint32_t)best_index << (i * 2);
+        }
+    }
+    // If color0 == color1, all indices are 0 and refer to color0.
+
+    block[0] = color0 & 0xFF;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xFF;
+    block[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        block[4 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+void decode_bc1_texel(uint8_t rgb[3], const uint8_t block[BC1_BLOCK_SIZE],
+                      int index) {
+    uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+    uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+    int palette_index = (block[4 + index / 4] >> ((index % 4) * 2)) & 0x3;
+    uint8_t palette[4][3];
+    build_bc1_palette(palette, color0, color1);
+    rgb[0] = palette[palette_index][0];
+    rgb[1] = palette[palette_index][1];
+    rgb[2] = palette[palette_index][2];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BC4.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Gets the value that a 3-bit index of a BC4 block refers to.
+static inline uint8_t bc4_palette_value(uint8_t value0, uint8_t value1,
+                                        int palette_index) {
+    if (palette_index == 0) {
+        return value0;
+    }
+    if (palette_index == 1) {
+        return value1;
+    }
+    if (value0 > value1) {
+        // Six interpolated values.
+        int weight = palette_index - 1;
+        return (uint8_t)(((7 - weight) * value0 + weight * value1 + 3) / 7);
+    }
+    // Four interpolated values, plus 0 and 255.
+    if (palette_index == 6) {
+        return 0;
+    }
+    if (palette_index == 7) {
+        return 0xFF;
+    }
+    int weight = palette_index - 1;
+    return (uint8_t)(((5 - weight) * value0 + weight * value1 + 2) / 5);
+}
+
+void encode_bc4_block(uint8_t block[BC4_BLOCK_SIZE], const uint8_t texels[16]) {
+    uint8_t min_value = 0xFF;
+    uint8_t max_value = 0;
+    for (int i = 0; i < 16; i++) {
+        min_value = texels[i] < min_value ? texels[i] : min_value;
+        max_value = texels[i] > max_value ? texels[i] : max_value;
+    }
+    // Use the eight values mode, which requires value0 > value1.
+    uint8_t value0 = max_value;
+    uint8_t value1 = min_value;
+
+    uint64_t indices = 0;
+    if (value0 != value1) {
+        uint8_t palette[8];
+        for (int p = 0; p < 8; p++) {
+            palette[p] = bc4_palette_value(value0, value1, p);
+        }
+        for (int i = 0; i < 16; i++) {
+            int best_index = 0;
+            int best_distance = INT32_MAX;
+            for (int p = 0; p < 8; p++) {
+                int distance = abs(texels[i] - palette[p]);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_index = p;
+                }
+            }
+            indices |= (uint64_t)best_index << (i * 3);
+        }
+    }
+
+    block[0] = value0;
+    block[1] = value1;
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+uint8_t decode_bc4_texel(const uint8_t block[BC4_BLOCK_SIZE], int index) {
+    // The 48 bits of indices may cross byte boundaries, so read the two bytes
+    // containing the 3-bit index.
+    int bit = index * 3;
+    int byte = 2 + bit / 8;
+    int shift = bit % 8;
+    uint32_t bits = block[byte];
+    if (byte + 1 < BC4_BLOCK_SIZE) {
+        bits |= (uint32_t)block[byte + 1] << 8;
+    }
+    int palette_index = (bits >> shift) & 0x7;
+    return bc4_palette_value(block[0], block[1], palette_index);
+}
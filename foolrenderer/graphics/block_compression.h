@@ -0,0 +1,63 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_BLOCK_COMPRESSION_H_
+#define FOOLRENDERER_GRAPHICS_BLOCK_COMPRESSION_H_
+
+#include <stdint.h>
+
+// Block compression formats store a 4x4 block of texels in a fixed number of
+// bytes. Each block holds two endpoint values and a small index per texel, and
+// a texel is decoded by interpolating between the endpoints according to its
+// index. The formats implemented here follow Direct3D's BC1 and BC4, refer to:
+// https://docs.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+//
+// The texels in a block are indexed as y * 4 + x, where (x, y) is the position
+// of the texel in the block. Like all texture data in foolrenderer, the first
+// row is the bottom row.
+
+#define BC1_BLOCK_SIZE 8
+#define BC4_BLOCK_SIZE 8
+
+///
+/// \brief Compresses 16 RGB texels into a BC1 block.
+///
+/// The endpoints are chosen along the principal axis of the colors in the
+/// block, always in the four-color mode.
+///
+/// \param block The 8 bytes block to write to.
+/// \param texels The R, G, B components of the 16 texels of the block.
+///
+void encode_bc1_block(uint8_t block[BC1_BLOCK_SIZE],
+                      const uint8_t texels[16][3]);
+
+///
+/// \brief Decodes a texel from a BC1 block.
+///
+/// \param rgb The decoded R, G, B components.
+/// \param block The block to decode.
+/// \param index The index of the texel in the block, range from 0 to 15.
+///
+void decode_bc1_texel(uint8_t rgb[3], const uint8_t block[BC1_BLOCK_SIZE],
+                      int index);
+
+///
+/// \brief Compresses 16 single component texels into a BC4 block.
+///
+/// \param block The 8 bytes block to write to.
+/// \param texels The values of the 16 texels of the block.
+///
+void encode_bc4_block(uint8_t block[BC4_BLOCK_SIZE], const uint8_t texels[16]);
+
+///
+/// \brief Decodes a texel from a BC4 block.
+///
+/// \param block The block to decode.
+/// \param index The index of the texel in the block, range from 0 to 15.
+/// \return Returns the value of the texel.
+///
+uint8_t decode_bc4_texel(const uint8_t block[BC4_BLOCK_SIZE], int index);
+
+#endif  // FOOLRENDERER_GRAPHICS_BLOCK_COMPRESSION_H_
@@ -7,6 +7,123 @@
 
 #include <stdint.h>
 
+// The tables below are generated with GAMMA equal to 2.2, they must be
+// regenerated if GAMMA changes.
+
+// The i-th element is powf(i / 255.0f, GAMMA).
+const float srgb8_to_linear_table[256] = {
+    0.0f, 5.07705136e-06f, 2.33280025e-05f, 5.69217555e-05f, 0.000107187356f,
+    0.000175123962f, 0.000261543726f, 0.000367136206f, 0.00049250375f,
+    0.000638182799f, 0.000804658455f, 0.000992374262f, 0.00120173942f,
+    0.00143313443f, 0.00168691506f, 0.00196341588f, 0.0022629532f,
+    0.00258582551f, 0.00293231825f, 0.00330270291f, 0.00369723933f,
+    0.00411617709f, 0.00455975486f, 0.00502820313f, 0.00552174449f,
+    0.00604059314f, 0.00658495678f, 0.00715503655f, 0.00775102666f,
+    0.00837311707f, 0.00902149081f, 0.00969632808f, 0.010397803f, 0.0111260824f,
+    0.0118813347f, 0.0126637202f, 0.0134733971f, 0.0143105192f, 0.0151752383f,
+    0.0160677005f, 0.0169880521f, 0.0179364327f, 0.0189129822f, 0.0199178383f,
+    0.0209511314f, 0.0220129937f, 0.0231035557f, 0.0242229421f, 0.0253712758f,
+    0.0265486818f, 0.0277552791f, 0.0289911851f, 0.0302565172f, 0.0315513909f,
+    0.0328759141f, 0.0342302062f, 0.0356143676f, 0.0370285138f, 0.0384727456f,
+    0.039947167f, 0.04145189f, 0.0429870076f, 0.0445526242f, 0.0461488403f,
+    0.0477757566f, 0.0494334623f, 0.0511220545f, 0.0528416298f, 0.0545922816f,
+    0.0563740991f, 0.0581871793f, 0.0600316115f, 0.0619074777f, 0.063814871f,
+    0.0657538846f, 0.067724593f, 0.0697270855f, 0.0717614517f, 0.0738277659f,
+    0.075926125f, 0.0780565888f, 0.0802192613f, 0.0824142098f, 0.0846415088f,
+    0.086901255f, 0.089193508f, 0.0915183574f, 0.0938758701f, 0.0962661207f,
+    0.0986891985f, 0.101145163f, 0.103634097f, 0.106156066f, 0.108711153f,
+    0.111299418f, 0.113920934f, 0.116575778f, 0.119264014f, 0.121985711f,
+    0.124740943f, 0.12752977f, 0.130352274f, 0.133208513f, 0.136098549f,
+    0.139022455f, 0.14198029f, 0.144972131f, 0.14799802f, 0.151058048f,
+    0.154152259f, 0.157280728f, 0.160443515f, 0.163640663f, 0.166872263f,
+    0.170138374f, 0.173439026f, 0.176774323f, 0.18014428f, 0.183548987f,
+    0.186988503f, 0.190462872f, 0.193972155f, 0.197516426f, 0.20109573f,
+    0.204710111f, 0.208359644f, 0.212044388f, 0.215764388f, 0.219519734f,
+    0.223310426f, 0.227136552f, 0.230998144f, 0.234895274f, 0.238828003f,
+    0.242796376f, 0.246800438f, 0.250840247f, 0.254915863f, 0.259027362f,
+    0.263174742f, 0.267358094f, 0.271577448f, 0.275832862f, 0.280124396f,
+    0.284452081f, 0.288816005f, 0.293216169f, 0.297652662f, 0.302125514f,
+    0.306634784f, 0.311180532f, 0.315762758f, 0.320381582f, 0.325036973f,
+    0.32972905f, 0.334457815f, 0.339223355f, 0.344025671f, 0.348864853f,
+    0.353740931f, 0.358653933f, 0.36360392f, 0.368590951f, 0.373615056f,
+    0.378676265f, 0.383774668f, 0.388910264f, 0.394083142f, 0.399293333f,
+    0.404540837f, 0.409825772f, 0.415148109f, 0.420507938f, 0.425905317f,
+    0.431340218f, 0.436812758f, 0.442322969f, 0.447870851f, 0.453456491f,
+    0.459079921f, 0.464741141f, 0.470440269f, 0.476177275f, 0.48195225f,
+    0.487765223f, 0.493616223f, 0.499505281f, 0.505432487f, 0.511397839f,
+    0.517401397f, 0.523443162f, 0.529523253f, 0.535641611f, 0.541798353f,
+    0.547993541f, 0.554227114f, 0.560499191f, 0.566809773f, 0.57315886f,
+    0.57954663f, 0.585973024f, 0.592438042f, 0.598941803f, 0.605484307f,
+    0.612065613f, 0.618685722f, 0.625344753f, 0.632042646f, 0.638779461f,
+    0.645555258f, 0.652370095f, 0.659224033f, 0.666116953f, 0.673049092f,
+    0.680020332f, 0.687030852f, 0.694080532f, 0.701169491f, 0.708297789f,
+    0.715465426f, 0.722672462f, 0.729918897f, 0.73720479f, 0.744530201f,
+    0.75189507f, 0.759299576f, 0.7667436f, 0.774227321f, 0.781750679f,
+    0.789313734f, 0.796916544f, 0.804559112f, 0.812241495f, 0.819963694f,
+    0.827725828f, 0.835527778f, 0.843369722f, 0.851251662f, 0.859173596f,
+    0.867135525f, 0.875137568f, 0.883179724f, 0.891262054f, 0.899384499f,
+    0.907547176f, 0.915750146f, 0.923993349f, 0.932276845f, 0.940600693f,
+    0.948964953f, 0.957369566f, 0.96581465f, 0.974300206f, 0.982826233f,
+    0.991392851f, 1.0f};
+
+// The i-th element is the smallest float whose value converted by
+// float_to_uint8(convert_to_srgb_color(value)) is i. Found by searching all
+// float values in range [0,1].
+const float linear_to_srgb8_table[256] = {
+    0.0f, 5.07704999e-06f, 2.3327997e-05f, 5.69217445e-05f, 0.000107187334f,
+    0.000175123932f, 0.000261543668f, 0.000367136148f, 0.000492503692f,
+    0.000638182682f, 0.000804658281f, 0.000992374029f, 0.00120173919f,
+    0.0014331342f, 0.00168691494f, 0.00196341588f, 0.00226295274f,
+    0.00258582504f, 0.00293231779f, 0.00330270245f, 0.00369723886f,
+    0.00411617616f, 0.00455975393f, 0.00502820266f, 0.00552174402f,
+    0.00604059268f, 0.00658495631f, 0.00715503562f, 0.00775102573f,
+    0.00837311614f, 0.00902148988f, 0.00969632715f, 0.0103978012f,
+    0.0111260805f, 0.0118813328f, 0.0126637183f, 0.0134733953f, 0.0143105173f,
+    0.0151752364f, 0.0160676986f, 0.0169880502f, 0.0179364309f, 0.0189129803f,
+    0.0199178364f, 0.0209511295f, 0.0220129918f, 0.0231035538f, 0.0242229383f,
+    0.025371274f, 0.0265486799f, 0.0277552754f, 0.0289911833f, 0.0302565154f,
+    0.0315513872f, 0.0328759141f, 0.0342302024f, 0.0356143638f, 0.0370285101f,
+    0.0384727418f, 0.039947167f, 0.0414518863f, 0.0429870039f, 0.0445526205f,
+    0.0461488366f, 0.0477757491f, 0.0494334549f, 0.051122047f, 0.0528416224f,
+    0.0545922741f, 0.0563740917f, 0.0581871718f, 0.0600316003f, 0.0619074702f,
+    0.063814871f, 0.0657538772f, 0.0677245855f, 0.0697270781f, 0.0717614442f,
+    0.0738277584f, 0.0759261176f, 0.0780565813f, 0.0802192539f, 0.0824142024f,
+    0.0846415013f, 0.0869012475f, 0.0891935006f, 0.0915183425f, 0.0938758627f,
+    0.0962661132f, 0.098689191f, 0.101145156f, 0.103634089f, 0.106156059f,
+    0.108711138f, 0.111299403f, 0.113920927f, 0.116575763f, 0.119263999f,
+    0.121985704f, 0.124740936f, 0.12752977f, 0.130352274f, 0.133208498f,
+    0.136098534f, 0.13902244f, 0.141980276f, 0.144972116f, 0.147998005f,
+    0.151058033f, 0.154152244f, 0.157280713f, 0.1604435f, 0.163640663f,
+    0.166872263f, 0.170138359f, 0.173439026f, 0.176774308f, 0.18014428f,
+    0.183548987f, 0.186988488f, 0.190462857f, 0.193972155f, 0.197516412f,
+    0.201095715f, 0.204710096f, 0.208359644f, 0.212044373f, 0.215764388f,
+    0.219519719f, 0.223310396f, 0.227136523f, 0.230998114f, 0.234895259f,
+    0.238827974f, 0.242796347f, 0.246800408f, 0.250840247f, 0.254915863f,
+    0.259027332f, 0.263174713f, 0.267358065f, 0.271577418f, 0.275832832f,
+    0.280124366f, 0.284452051f, 0.288815975f, 0.293216139f, 0.297652632f,
+    0.302125484f, 0.306634754f, 0.311180502f, 0.315762728f, 0.320381552f,
+    0.325036943f, 0.329729021f, 0.334457815f, 0.339223325f, 0.344025642f,
+    0.348864824f, 0.353740901f, 0.358653903f, 0.36360389f, 0.368590921f,
+    0.373615026f, 0.378676236f, 0.383774638f, 0.388910234f, 0.394083112f,
+    0.399293303f, 0.404540807f, 0.409825712f, 0.415148079f, 0.420507908f,
+    0.425905287f, 0.431340188f, 0.436812729f, 0.44232294f, 0.447870821f,
+    0.453456461f, 0.459079891f, 0.464741111f, 0.470440239f, 0.476177245f,
+    0.48195222f, 0.487765193f, 0.493616194f, 0.499505252f, 0.505432487f,
+    0.511397839f, 0.517401338f, 0.523443162f, 0.529523194f, 0.535641611f,
+    0.541798353f, 0.547993481f, 0.554227054f, 0.560499132f, 0.566809714f,
+    0.57315886f, 0.57954663f, 0.585972965f, 0.592438042f, 0.598941803f,
+    0.605484307f, 0.612065613f, 0.618685722f, 0.625344694f, 0.632042587f,
+    0.638779461f, 0.645555258f, 0.652370095f, 0.659223974f, 0.666116953f,
+    0.673049033f, 0.680020332f, 0.687030792f, 0.694080532f, 0.701169491f,
+    0.708297789f, 0.715465426f, 0.722672462f, 0.729918897f, 0.73720479f,
+    0.744530141f, 0.75189507f, 0.759299517f, 0.7667436f, 0.774227321f,
+    0.781750679f, 0.789313734f, 0.796916544f, 0.804559112f, 0.812241495f,
+    0.819963694f, 0.827725768f, 0.835527778f, 0.843369722f, 0.851251602f,
+    0.859173536f, 0.867135525f, 0.875137568f, 0.883179724f, 0.891261995f,
+    0.899384499f, 0.907547176f, 0.915750086f, 0.923993289f, 0.932276845f,
+    0.940600693f, 0.948964894f, 0.957369566f, 0.96581459f, 0.974300146f,
+    0.982826233f, 0.991392791f, 0.99999994f};
+
 extern uint8_t float_to_uint8(float value);
 
 extern float uint8_to_float(uint8_t value);
@@ -14,3 +131,19 @@ extern float uint8_to_float(uint8_t value);
 extern float convert_to_linear_color(float vlaue);
 
 extern float convert_to_srgb_color(float value);
+
+extern float srgb8_to_linear(uint8_t value);
+
+extern uint8_t linear_to_srgb8(float value);
+
+extern uint32_t encode_small_float(float value, int mantissa_bits);
+
+extern float decode_small_float(uint32_t bits, int mantissa_bits);
+
+extern uint16_t float_to_half(float value);
+
+extern float half_to_float(uint16_t value);
+
+extern uint32_t pack_r11g11b10f(float r, float g, float b);
+
+extern void unpack_r11g11b10f(float rgb[3], uint32_t value);
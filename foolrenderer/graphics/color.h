@@ -9,8 +9,15 @@
 #include <math.h>
 #include <stdint.h>
 
+#include "math/math_utility.h"
+
 #define GAMMA (2.2f)
 
+// Lookup tables used by srgb8_to_linear() and linear_to_srgb8(), defined in
+// color.c. Do not use them directly.
+extern const float srgb8_to_linear_table[256];
+extern const float linear_to_srgb8_table[256];
+
 inline uint8_t float_to_uint8(float value) { return value * 0xFF; }
 
 inline float uint8_to_float(uint8_t value) { return value / 255.0f; }
@@ -40,4 +47,180 @@ inline float convert_to_linear_color(float vlaue) {
     return powf(vlaue, GAMMA);
 }
 
+///
+/// \brief Converts an 8-bit sRGB color component to linear space.
+///
+/// Gives the same result as convert_to_linear_color(uint8_to_float(value)),
+/// but reads the result from a table instead of calling powf().
+///
+/// \param value The R, G or B component of a 8-bit sRGB color.
+/// \return Returns the converted value.
+///
+inline float srgb8_to_linear(uint8_t value) {
+    return srgb8_to_linear_table[value];
+}
+
+///
+/// \brief Converts a linear color component to sRGB space, and quantizes the
+///        result to 8 bits.
+///
+/// Gives exactly the same result as
+/// float_to_uint8(convert_to_srgb_color(float_clamp01(value))) for any input,
+/// but without calling powf(). Values out of range [0,1] are clamped.
+///
+/// \param value The R, G or B component of a linear color.
+/// \return Returns the converted value.
+///
+inline uint8_t linear_to_srgb8(float value) {
+    // The i-th element of the table is the smallest linear value that is
+    // encoded as i, so the result is the index of the last element that is
+    // less than or equal to the value. The table is sorted, use binary search.
+    // Comparisons with NaN are false, so NaN is encoded as 0.
+    uint8_t result = 0;
+    for (int step = 128; step > 0; step >>= 1) {
+        if (value >= linear_to_srgb8_table[result + step]) {
+            result += step;
+        }
+    }
+    return result;
+}
+
+// Floating point formats with fewer bits than float, used by HDR color buffers.
+// All of them have a 5-bit exponent with a bias of 15, like the IEEE 754 half
+// precision format, and differ in the number of mantissa bits:
+//
+// Format           | Sign | Exponent | Mantissa
+// ---------------- | ---- | -------- | --------
+// Half             | 1    | 5        | 10
+// R11G11B10F (R/G) | 0    | 5        | 6
+// R11G11B10F (B)   | 0    | 5        | 5
+//
+// Refer to the OpenGL specification section 2.1.3 and 2.1.4:
+// https://www.khronos.org/registry/OpenGL/specs/gl/glspec33.core.pdf
+
+#define SMALL_FLOAT_EXPONENT_BIAS 15
+#define SMALL_FLOAT_MAX_EXPONENT 30
+
+union float_bits {
+    float value;
+    uint32_t bits;
+};
+
+///
+/// \brief Encodes the absolute value of a float as an unsigned small float.
+///
+/// The value is rounded to the nearest representable value. Values too large
+/// to represent are clamped to the largest finite value, NaN is encoded as 0.
+///
+/// \param value The value to encode.
+/// \param mantissa_bits The number of mantissa bits of the small float.
+/// \return Returns the exponent and mantissa bits of the small float.
+///
+inline uint32_t encode_small_float(float value, int mantissa_bits) {
+    uint32_t max_exponent = SMALL_FLOAT_MAX_EXPONENT;
+    uint32_t max_finite =
+        (max_exponent << mantissa_bits) | ((1u << mantissa_bits) - 1);
+    union float_bits f = {.value = fabsf(value)};
+    if (f.value != f.value) {
+        return 0;
+    }
+    int exponent = (int)(f.bits >> 23) - 127 + SMALL_FLOAT_EXPONENT_BIAS;
+    uint32_t mantissa = f.bits & 0x7FFFFF;
+    int shift = 23 - mantissa_bits;
+    if (exponent <= 0) {
+        // Denormalized, the implicit leading 1 becomes explicit.
+        shift += 1 - exponent;
+        if (shift > 24) {
+            return 0;
+        }
+        mantissa |= 0x800000;
+        exponent = 0;
+    }
+    if (exponent > SMALL_FLOAT_MAX_EXPONENT) {
+        return max_finite;
+    }
+    // Round to nearest, ties to even. A carry out of the mantissa correctly
+    // increments the exponent.
+    uint32_t result = ((uint32_t)exponent << mantissa_bits) | mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t half = 1u << (shift - 1);
+    if (remainder > half || (remainder == half && (result & 1))) {
+        result++;
+    }
+    return result < max_finite ? result : max_finite;
+}
+
+///
+/// \brief Decodes an unsigned small float.
+///
+/// \param bits The exponent and mantissa bits of the small float.
+/// \param mantissa_bits The number of mantissa bits of the small float.
+/// \return Returns the decoded value.
+///
+inline float decode_small_float(uint32_t bits, int mantissa_bits) {
+    uint32_t exponent = bits >> mantissa_bits;
+    uint32_t mantissa = bits & ((1u << mantissa_bits) - 1);
+    if (exponent == 0) {
+        return ldexpf((float)mantissa,
+                      1 - SMALL_FLOAT_EXPONENT_BIAS - mantissa_bits);
+    }
+    if (exponent > SMALL_FLOAT_MAX_EXPONENT) {
+        return mantissa == 0 ? INFINITY : NAN;
+    }
+    union float_bits f;
+    f.bits = (exponent + 127 - SMALL_FLOAT_EXPONENT_BIAS) << 23 |
+             mantissa << (23 - mantissa_bits);
+    return f.value;
+}
+
+///
+/// \brief Converts a float to a half precision float.
+///
+/// \param value The value to convert.
+/// \return Returns the bits of the half precision float.
+///
+inline uint16_t float_to_half(float value) {
+    uint16_t sign = signbit(value) && value == value ? 0x8000 : 0;
+    return sign | (uint16_t)encode_small_float(value, 10);
+}
+
+///
+/// \brief Converts a half precision float to a float.
+///
+/// \param value The bits of the half precision float.
+/// \return Returns the converted value.
+///
+inline float half_to_float(uint16_t value) {
+    float result = decode_small_float(value & 0x7FFF, 10);
+    return value & 0x8000 ? -result : result;
+}
+
+///
+/// \brief Packs a color in the R11G11B10F format.
+///
+/// The format cannot represent negative values, they are clamped to 0.
+///
+/// \param r The R component of the color.
+/// \param g The G component of the color.
+/// \param b The B component of the color.
+/// \return Returns the packed color, R in the lowest bits.
+///
+inline uint32_t pack_r11g11b10f(float r, float g, float b) {
+    return encode_small_float(float_max(r, 0.0f), 6) |
+           encode_small_float(float_max(g, 0.0f), 6) << 11 |
+           encode_small_float(float_max(b, 0.0f), 5) << 22;
+}
+
+///
+/// \brief Unpacks a color in the R11G11B10F format.
+///
+/// \param rgb The unpacked R, G, B components.
+/// \param value The packed color.
+///
+inline void unpack_r11g11b10f(float rgb[3], uint32_t value) {
+    rgb[0] = decode_small_float(value & 0x7FF, 6);
+    rgb[1] = decode_small_float(value >> 11 & 0x7FF, 6);
+    rgb[2] = decode_small_float(value >> 22 & 0x3FF, 5);
+}
+
 #endif  // FOOLRENDERER_GRAPHICS_COLOR_H_
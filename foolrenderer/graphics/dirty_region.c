@@ -0,0 +1,113 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/dirty_region.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "graphics/framebuffer.h"
+#include "math/math_utility.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+
+static inline bool is_empty(struct pixel_rectangle rectangle) {
+    return rectangle.right <= rectangle.left ||
+           rectangle.top <= rectangle.bottom;
+}
+
+static inline struct pixel_rectangle merge(struct pixel_rectangle a,
+                                           struct pixel_rectangle b) {
+    return (struct pixel_rectangle){
+        uint32_min(a.left, b.left), uint32_min(a.bottom, b.bottom),
+        uint32_max(a.right, b.right), uint32_max(a.top, b.top)};
+}
+
+static inline uint64_t get_area(struct pixel_rectangle rectangle) {
+    return (uint64_t)(rectangle.right - rectangle.left) *
+           (rectangle.top - rectangle.bottom);
+}
+
+static void remove_rectangle(struct dirty_region *region, uint32_t index) {
+    region->rectangles[index] =
+        region->rectangles[--region->rectangle_count];
+}
+
+void clear_dirty_region(struct dirty_region *region) {
+    region->rectangle_count = 0;
+}
+
+void add_dirty_rectangle(struct dirty_region *region,
+                         struct pixel_rectangle rectangle) {
+    if (is_empty(rectangle)) {
+        return;
+    }
+    // Absorb the rectangles overlapping the new one. A merged rectangle may
+    // overlap rectangles it did not before, so start over after each merge.
+    bool is_merged = true;
+    while (is_merged) {
+        is_merged = false;
+        for (uint32_t i = 0; i < region->rectangle_count; i++) {
+            if (do_rectangles_overlap(region->rectangles[i], rectangle)) {
+                rectangle = merge(region->rectangles[i], rectangle);
+                remove_rectangle(region, i);
+                is_merged = true;
+                break;
+            }
+        }
+    }
+    if (region->rectangle_count < MAX_DIRTY_RECTANGLES) {
+        region->rectangles[region->rectangle_count++] = rectangle;
+        return;
+    }
+    // The region is full, merge the new rectangle into the one whose area
+    // grows the least. The merged rectangle may now overlap others, which
+    // only costs some pixels rendered twice.
+    uint32_t best = 0;
+    uint64_t best_growth = UINT64_MAX;
+    for (uint32_t i = 0; i < region->rectangle_count; i++) {
+        struct pixel_rectangle merged = merge(region->rectangles[i], rectangle);
+        uint64_t growth = get_area(merged) - get_area(region->rectangles[i]);
+        if (growth < best_growth) {
+            best = i;
+            best_growth = growth;
+        }
+    }
+    region->rectangles[best] = merge(region->rectangles[best], rectangle);
+}
+
+bool do_rectangles_overlap(struct pixel_rectangle a, struct pixel_rectangle b) {
+    return a.left < b.right && b.left < a.right && a.bottom < b.top &&
+           b.bottom < a.top;
+}
+
+struct pixel_rectangle get_screen_bounds(matrix4x4 local2clip, vector3 min,
+                                         vector3 max, uint32_t width,
+                                         uint32_t height) {
+    struct pixel_rectangle screen = {0, 0, width, height};
+    vector2 lower = {{INFINITY, INFINITY}};
+    vector2 upper = {{-INFINITY, -INFINITY}};
+    for (uint32_t i = 0; i < 8; i++) {
+        vector4 corner = {{i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+                           i & 4 ? max.z : min.z, 1.0f}};
+        vector4 position = matrix4x4_multiply_vector4(local2clip, corner);
+        if (position.w <= 0.0f) {
+            return screen;
+        }
+        // The same mapping as the viewport transform of the rasterizer, the
+        // pixel centers are at integer coordinates.
+        float x = (position.x / position.w + 1.0f) * 0.5f * (float)width;
+        float y = (position.y / position.w + 1.0f) * 0.5f * (float)height;
+        lower = (vector2){{float_min(lower.x, x), float_min(lower.y, y)}};
+        upper = (vector2){{float_max(upper.x, x), float_max(upper.y, y)}};
+    }
+    float left = float_clamp(floorf(lower.x) - 1.0f, 0.0f, (float)width);
+    float bottom = float_clamp(floorf(lower.y) - 1.0f, 0.0f, (float)height);
+    float right = float_clamp(floorf(upper.x) + 2.0f, 0.0f, (float)width);
+    float top = float_clamp(floorf(upper.y) + 2.0f, 0.0f, (float)height);
+    return (struct pixel_rectangle){(uint32_t)left, (uint32_t)bottom,
+                                    (uint32_t)right, (uint32_t)top};
+}
@@ -0,0 +1,79 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_DIRTY_REGION_H_
+#define FOOLRENDERER_GRAPHICS_DIRTY_REGION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "graphics/framebuffer.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+
+// A dirty region is the part of the screen that has to be rendered again when
+// objects change, while the rest of the last frame stays valid. An object that
+// moves or whose material changes dirties the screen bounds it had in the last
+// frame, where it must be erased, and the screen bounds it has in the current
+// frame. Each dirty rectangle is rendered again by setting it as the scissor
+// rectangle, clearing the framebuffer and drawing the objects overlapping it.
+//
+// The region is kept as a few rectangles, so that changes far apart do not
+// dirty the whole screen between them. Overlapping rectangles are merged.
+
+// The number of rectangles a region holds at most. Beyond it, the rectangles
+// that grow the least when merged are merged.
+#define MAX_DIRTY_RECTANGLES 8
+
+struct dirty_region {
+    struct pixel_rectangle rectangles[MAX_DIRTY_RECTANGLES];
+    uint32_t rectangle_count;
+};
+
+///
+/// \brief Empties the region.
+///
+/// \param region Pointer to the region.
+///
+void clear_dirty_region(struct dirty_region *region);
+
+///
+/// \brief Adds a rectangle to the region.
+///
+/// Empty rectangles are ignored.
+///
+/// \param region Pointer to the region.
+/// \param rectangle The rectangle to add.
+///
+void add_dirty_rectangle(struct dirty_region *region,
+                         struct pixel_rectangle rectangle);
+
+///
+/// \brief Tests whether two rectangles overlap.
+///
+/// \return Returns true if the rectangles have a pixel in common.
+///
+bool do_rectangles_overlap(struct pixel_rectangle a, struct pixel_rectangle b);
+
+///
+/// \brief Computes the pixels a box may cover on the screen.
+///
+/// The box is projected to the screen with the viewport covering the whole
+/// screen, see set_viewport(). The bounds are widened by a pixel on each side,
+/// which covers the samples of multisampled framebuffers. The whole screen is
+/// returned if the box crosses the plane of the camera.
+///
+/// \param local2clip The transform from the space of the box to clip space.
+/// \param min The minimum corner of the box.
+/// \param max The maximum corner of the box.
+/// \param width The width of the screen.
+/// \param height The height of the screen.
+/// \return Returns the bounds of the box on the screen, clamped to the screen.
+///
+struct pixel_rectangle get_screen_bounds(matrix4x4 local2clip, vector3 min,
+                                         vector3 max, uint32_t width,
+                                         uint32_t height);
+
+#endif  // FOOLRENDERER_GRAPHICS_DIRTY_REGION_H_
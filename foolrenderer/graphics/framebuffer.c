@@ -19,9 +19,46 @@ struct framebuffer {
     uint32_t width, height;
     struct texture *color_buffer;
     struct texture *depth_buffer;
+    struct texture *motion_vector_buffer;
 };
 
-static uint8_t clear_color[4] = {0};
+static float clear_color[4] = {0.0f};
+
+static struct {
+    bool is_enabled;
+    uint32_t left, bottom;
+    uint32_t width, height;
+} scissor = {0};
+
+static inline uint32_t get_sample_count(const struct texture *texture) {
+    enum texture_format format = get_texture_format(texture);
+    if (format == TEXTURE_FORMAT_RGBA16F_4X ||
+        format == TEXTURE_FORMAT_DEPTH_FLOAT_4X) {
+        return TEXTURE_SAMPLE_COUNT;
+    }
+    return 1;
+}
+
+// Returns true if the texture is in the layout of the buffers attached to the
+// framebuffer other than the given attachment. The rasterizer addresses the
+// pixels of all buffers with the same indices.
+static bool has_same_layout(const struct framebuffer *framebuffer,
+                            enum attachment_type attachment,
+                            const struct texture *texture) {
+    enum texture_layout layout = get_texture_layout(texture);
+    const struct texture *buffers[3] = {framebuffer->color_buffer,
+                                        framebuffer->depth_buffer,
+                                        framebuffer->motion_vector_buffer};
+    const enum attachment_type types[3] = {
+        COLOR_ATTACHMENT, DEPTH_ATTACHMENT, MOTION_VECTOR_ATTACHMENT};
+    for (int i = 0; i < 3; i++) {
+        if (types[i] != attachment && buffers[i] != NULL &&
+            get_texture_layout(buffers[i]) != layout) {
+            return false;
+        }
+    }
+    return true;
+}
 
 struct framebuffer *create_framebuffer(void) {
     struct framebuffer *framebuffer;
@@ -33,6 +70,7 @@ struct framebuffer *create_framebuffer(void) {
     framebuffer->height = 0;
     framebuffer->color_buffer = NULL;
     framebuffer->depth_buffer = NULL;
+    framebuffer->motion_vector_buffer = NULL;
     return framebuffer;
 }
 
@@ -57,21 +95,45 @@ bool attach_texture_to_framebuffer(struct framebuffer *framebuffer,
     }
     bool result = false;
     if (texture != NULL) {
+        // The rasterizer writes the pixels of attachments directly, it handles
+        // the linear and the tiled layouts.
+        enum texture_layout layout = get_texture_layout(texture);
+        if ((layout != TEXTURE_LAYOUT_LINEAR &&
+             layout != TEXTURE_LAYOUT_TILED) ||
+            !has_same_layout(framebuffer, attachment, texture)) {
+            return false;
+        }
         enum texture_format format = get_texture_format(texture);
         switch (attachment) {
             case COLOR_ATTACHMENT:
-                if (format == TEXTURE_FORMAT_RGBA8 ||
-                    format == TEXTURE_FORMAT_SRGB8_A8) {
+                if ((format == TEXTURE_FORMAT_RGBA8 ||
+                     format == TEXTURE_FORMAT_SRGB8_A8 ||
+                     format == TEXTURE_FORMAT_RGBA16F ||
+                     format == TEXTURE_FORMAT_R11G11B10F ||
+                     format == TEXTURE_FORMAT_RGBA16F_4X) &&
+                    (framebuffer->depth_buffer == NULL ||
+                     get_sample_count(framebuffer->depth_buffer) ==
+                         get_sample_count(texture))) {
                     framebuffer->color_buffer = texture;
                     result = true;
                 }
                 break;
             case DEPTH_ATTACHMENT:
-                if (format == TEXTURE_FORMAT_DEPTH_FLOAT) {
+                if ((format == TEXTURE_FORMAT_DEPTH_FLOAT ||
+                     format == TEXTURE_FORMAT_DEPTH_FLOAT_4X) &&
+                    (framebuffer->color_buffer == NULL ||
+                     get_sample_count(framebuffer->color_buffer) ==
+                         get_sample_count(texture))) {
                     framebuffer->depth_buffer = texture;
                     result = true;
                 }
                 break;
+            case MOTION_VECTOR_ATTACHMENT:
+                if (format == TEXTURE_FORMAT_RGBA16F) {
+                    framebuffer->motion_vector_buffer = texture;
+                    result = true;
+                }
+                break;
         }
     } else {
         switch (attachment) {
@@ -83,12 +145,17 @@ bool attach_texture_to_framebuffer(struct framebuffer *framebuffer,
                 framebuffer->depth_buffer = NULL;
                 result = true;
                 break;
+            case MOTION_VECTOR_ATTACHMENT:
+                framebuffer->motion_vector_buffer = NULL;
+                result = true;
+                break;
         }
     }
     // Update the framebuffer size.
     if (result) {
         if (framebuffer->color_buffer == NULL &&
-            framebuffer->depth_buffer == NULL) {
+            framebuffer->depth_buffer == NULL &&
+            framebuffer->motion_vector_buffer == NULL) {
             framebuffer->width = 0;
             framebuffer->height = 0;
         } else {
@@ -96,43 +163,107 @@ bool attach_texture_to_framebuffer(struct framebuffer *framebuffer,
             framebuffer->height = UINT32_MAX;
             SET_MIN_SIZE(framebuffer->color_buffer);
             SET_MIN_SIZE(framebuffer->depth_buffer);
+            SET_MIN_SIZE(framebuffer->motion_vector_buffer);
         }
     }
     return result;
 }
 
 void set_clear_color(float red, float green, float blue, float alpha) {
-    clear_color[0] = float_to_uint8(float_clamp01(red));
-    clear_color[1] = float_to_uint8(float_clamp01(green));
-    clear_color[2] = float_to_uint8(float_clamp01(blue));
-    clear_color[3] = float_to_uint8(float_clamp01(alpha));
+    clear_color[0] = float_clamp01(red);
+    clear_color[1] = float_clamp01(green);
+    clear_color[2] = float_clamp01(blue);
+    clear_color[3] = float_clamp01(alpha);
+}
+
+void set_scissor(uint32_t left, uint32_t bottom, uint32_t width,
+                 uint32_t height) {
+    scissor.is_enabled = true;
+    scissor.left = left;
+    scissor.bottom = bottom;
+    scissor.width = width;
+    scissor.height = height;
+}
+
+void disable_scissor(void) { scissor.is_enabled = false; }
+
+struct pixel_rectangle get_scissor_rectangle(
+    const struct framebuffer *framebuffer) {
+    struct pixel_rectangle rectangle = {0, 0, framebuffer->width,
+                                        framebuffer->height};
+    if (scissor.is_enabled) {
+        // The sums are done in 64 bits, so that they do not wrap around.
+        uint64_t right = (uint64_t)scissor.left + scissor.width;
+        uint64_t top = (uint64_t)scissor.bottom + scissor.height;
+        rectangle.left = uint32_min(scissor.left, framebuffer->width);
+        rectangle.bottom = uint32_min(scissor.bottom, framebuffer->height);
+        rectangle.right = right < framebuffer->width ? (uint32_t)right
+                                                     : framebuffer->width;
+        rectangle.top =
+            top < framebuffer->height ? (uint32_t)top : framebuffer->height;
+    }
+    return rectangle;
+}
+
+// Encodes the clear color in the format of the color buffer.
+static void encode_clear_color(uint8_t pixel[8], enum texture_format format) {
+    if (format == TEXTURE_FORMAT_RGBA16F) {
+        uint16_t half[4];
+        for (int i = 0; i < 4; i++) {
+            half[i] = float_to_half(clear_color[i]);
+        }
+        memcpy(pixel, half, sizeof(half));
+    } else if (format == TEXTURE_FORMAT_R11G11B10F) {
+        uint32_t packed =
+            pack_r11g11b10f(clear_color[0], clear_color[1], clear_color[2]);
+        memcpy(pixel, &packed, sizeof(packed));
+    } else {
+        // format == TEXTURE_FORMAT_RGBA8 || format == TEXTURE_FORMAT_SRGB8_A8
+        // The clear color is written as is, without gamma correction.
+        for (int i = 0; i < 4; i++) {
+            pixel[i] = float_to_uint8(clear_color[i]);
+        }
+    }
 }
 
 void clear_framebuffer(struct framebuffer *framebuffer) {
     if (framebuffer == NULL) {
         return;
     }
-    struct texture *buffer;
-    size_t pixel_count = (size_t)framebuffer->width * framebuffer->height;
-    // Clear color buffer.
-    buffer = framebuffer->color_buffer;
+    struct pixel_rectangle area = get_scissor_rectangle(framebuffer);
+    if (area.right <= area.left || area.top <= area.bottom) {
+        return;
+    }
+    // The clears are deferred by the textures, only the tiles partially inside
+    // the area are written now. The rasterizer writes the other tiles when it
+    // first touches them.
+    uint32_t width = area.right - area.left;
+    uint32_t height = area.top - area.bottom;
+    // Clear color buffer, the samples of multisampled buffers are written in
+    // the format of a single sample.
+    struct texture *buffer = framebuffer->color_buffer;
     if (buffer != NULL) {
-        uint8_t *pixels = get_texture_pixels(buffer);
-        for (size_t i = 0; i < pixel_count; i++) {
-            uint8_t *pixel = pixels + i * 4;
-            pixel[0] = clear_color[0];
-            pixel[1] = clear_color[1];
-            pixel[2] = clear_color[2];
-            pixel[3] = clear_color[3];
-        }
+        enum texture_format format = get_texture_format(buffer);
+        uint8_t clear_pixel[8];
+        encode_clear_color(clear_pixel, format == TEXTURE_FORMAT_RGBA16F_4X
+                                            ? TEXTURE_FORMAT_RGBA16F
+                                            : format);
+        clear_texture(buffer, area.left, area.bottom, width, height,
+                      clear_pixel);
     }
     // Clear depth buffer.
     buffer = framebuffer->depth_buffer;
     if (buffer != NULL) {
-        float *pixels = get_texture_pixels(buffer);
-        for (size_t i = 0; i < pixel_count; i++) {
-            pixels[i] = 1.0f;
-        }
+        float clear_depth = 1.0f;
+        clear_texture(buffer, area.left, area.bottom, width, height,
+                      &clear_depth);
+    }
+    // Clear motion vector buffer, the half precision 0 is all zero bits.
+    buffer = framebuffer->motion_vector_buffer;
+    if (buffer != NULL) {
+        uint16_t clear_motion[4] = {0};
+        clear_texture(buffer, area.left, area.bottom, width, height,
+                      clear_motion);
     }
 }
 
@@ -154,7 +285,110 @@ struct texture *get_framebuffer_attachment(struct framebuffer *framebuffer,
             return framebuffer->color_buffer;
         case DEPTH_ATTACHMENT:
             return framebuffer->depth_buffer;
+        case MOTION_VECTOR_ATTACHMENT:
+            return framebuffer->motion_vector_buffer;
         default:
             return NULL;
     }
 }
+
+uint32_t get_framebuffer_sample_count(const struct framebuffer *framebuffer) {
+    if (framebuffer->color_buffer != NULL) {
+        return get_sample_count(framebuffer->color_buffer);
+    }
+    if (framebuffer->depth_buffer != NULL) {
+        return get_sample_count(framebuffer->depth_buffer);
+    }
+    return 1;
+}
+
+enum texture_layout get_framebuffer_layout(
+    const struct framebuffer *framebuffer) {
+    const struct texture *buffers[3] = {framebuffer->color_buffer,
+                                        framebuffer->depth_buffer,
+                                        framebuffer->motion_vector_buffer};
+    for (int i = 0; i < 3; i++) {
+        if (buffers[i] != NULL) {
+            return get_texture_layout(buffers[i]);
+        }
+    }
+    return TEXTURE_LAYOUT_LINEAR;
+}
+
+bool resolve_multisample_texture(struct texture *target,
+                                 const struct texture *source) {
+    if (target == NULL || source == NULL ||
+        get_texture_format(target) != TEXTURE_FORMAT_RGBA16F ||
+        get_texture_format(source) != TEXTURE_FORMAT_RGBA16F_4X ||
+        get_texture_layout(target) != TEXTURE_LAYOUT_LINEAR) {
+        return false;
+    }
+    uint32_t width = get_texture_width(source);
+    uint32_t height = get_texture_height(source);
+    if (get_texture_width(target) != width ||
+        get_texture_height(target) != height) {
+        return false;
+    }
+    size_t pixel_count = (size_t)width * height;
+    // Both textures are linear, the storage of the source is read in place and
+    // get_texture_pixels() returns the storage of the target.
+    const uint16_t *planes = get_texture_storage_const(source);
+    const uint8_t *is_compressed =
+        (const uint8_t *)(planes + pixel_count * 4 * TEXTURE_SAMPLE_COUNT);
+    uint16_t *pixels = get_texture_pixels(target);
+    // Plane 0 is the resolved color of the compressed pixels, which are most
+    // of the image, so it is copied as a whole and only the pixels on edges are
+    // averaged afterwards. Each pixel is resolved on its own, so the image may
+    // be split into parts resolved in parallel.
+    memcpy(pixels, planes, pixel_count * 4 * sizeof(uint16_t));
+    for (size_t first = 0; first < pixel_count; first += 8) {
+        size_t count = pixel_count - first < 8 ? pixel_count - first : 8;
+        if (count == 8) {
+            // Test the flags of eight pixels at once, the group is skipped if
+            // none of its bytes is 0, refer to:
+            // https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
+            uint64_t flags;
+            memcpy(&flags, is_compressed + first, sizeof(flags));
+            if (((flags - 0x0101010101010101u) & ~flags &
+                 0x8080808080808080u) == 0) {
+                continue;
+            }
+        }
+        for (size_t i = first; i < first + count; i++) {
+            if (is_compressed[i]) {
+                continue;
+            }
+            float sum[4] = {0.0f};
+            for (uint32_t s = 0; s < TEXTURE_SAMPLE_COUNT; s++) {
+                const uint16_t *sample = planes + (s * pixel_count + i) * 4;
+                for (int c = 0; c < 4; c++) {
+                    sum[c] += half_to_float(sample[c]);
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                pixels[i * 4 + c] =
+                    float_to_half(sum[c] * (1.0f / TEXTURE_SAMPLE_COUNT));
+            }
+        }
+    }
+    // The tiles a deferred clear has not written yet hold stale samples, they
+    // are resolved to the clear color instead.
+    for (uint32_t y = 0; y < height; y += TEXTURE_CLEAR_TILE_SIZE) {
+        for (uint32_t x = 0; x < width; x += TEXTURE_CLEAR_TILE_SIZE) {
+            const uint16_t *clear_color =
+                get_texture_clear_texel(source, x, y);
+            if (clear_color == NULL) {
+                continue;
+            }
+            uint32_t x_end = uint32_min(x + TEXTURE_CLEAR_TILE_SIZE, width);
+            uint32_t y_end = uint32_min(y + TEXTURE_CLEAR_TILE_SIZE, height);
+            for (uint32_t row = y; row < y_end; row++) {
+                for (uint32_t column = x; column < x_end; column++) {
+                    memcpy(pixels + ((size_t)row * width + column) * 4,
+                           clear_color, 4 * sizeof(uint16_t));
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -11,7 +11,21 @@
 
 #include "graphics/texture.h"
 
-enum attachment_type { COLOR_ATTACHMENT, DEPTH_ATTACHMENT };
+enum attachment_type {
+    COLOR_ATTACHMENT,
+    DEPTH_ATTACHMENT,
+    MOTION_VECTOR_ATTACHMENT
+};
+
+///
+/// \brief A rectangle of pixels, from (left, bottom) to (right, top), right and
+///        top excluded. The rectangle is empty if right <= left or top <=
+///        bottom.
+///
+struct pixel_rectangle {
+    uint32_t left, bottom;
+    uint32_t right, top;
+};
 
 ///
 /// \brief A framebuffer is a collection of buffers that can be used as the
@@ -47,14 +61,44 @@ void destroy_framebuffer(struct framebuffer *framebuffer);
 ///
 /// Different attachment type correspond to specific valid texture types:
 ///
-/// Attachment Type  | Texture Format
-/// ---------------- | -----------------------------
-/// COLOR_ATTACHMENT | TEXTURE_FORMAT_RGBA8, TEXTURE_FORMAT_SRGB8_A8
-/// DEPTH_ATTACHMENT | TEXTURE_FORMAT_DEPTH_FLOAT
+/// Attachment Type          | Texture Format
+/// ------------------------ | -----------------------------
+/// COLOR_ATTACHMENT         | TEXTURE_FORMAT_RGBA8, TEXTURE_FORMAT_SRGB8_A8,
+///                          | TEXTURE_FORMAT_RGBA16F,
+///                          | TEXTURE_FORMAT_R11G11B10F,
+///                          | TEXTURE_FORMAT_RGBA16F_4X
+/// DEPTH_ATTACHMENT         | TEXTURE_FORMAT_DEPTH_FLOAT,
+///                          | TEXTURE_FORMAT_DEPTH_FLOAT_4X
+/// MOTION_VECTOR_ATTACHMENT | TEXTURE_FORMAT_RGBA16F
+///
+/// Color buffers in TEXTURE_FORMAT_RGBA16F or TEXTURE_FORMAT_R11G11B10F store
+/// high dynamic range colors, use resolve_texture() to tone map them into a
+/// displayable buffer.
+///
+/// The multisampled formats TEXTURE_FORMAT_RGBA16F_4X and
+/// TEXTURE_FORMAT_DEPTH_FLOAT_4X make the framebuffer multisampled, see
+/// draw_triangle(). The color buffer and the depth buffer must have the same
+/// number of samples. Use resolve_multisample_texture() to turn the
+/// multisampled color buffer into a TEXTURE_FORMAT_RGBA16F texture.
+///
+/// The R and G components of the motion vector buffer receive the motion of
+/// each pixel in screen space since the previous frame, in pixels, see
+/// set_previous_position_variable(). It has one vector per pixel, also in
+/// multisampled framebuffers.
+///
+/// The buffers may be in TEXTURE_LAYOUT_LINEAR or, for formats that are not
+/// multisampled, in TEXTURE_LAYOUT_TILED, see set_texture_layout(). In the
+/// tiled layout the pixels of each 4x4 tile are next to each other, so a
+/// triangle touches fewer cache lines. The pixels are converted to the linear
+/// layout when read back with get_texture_pixels(), and by the functions
+/// resolving the buffers into other textures.
 ///
 /// If the texture is a null pointer detachs the current type buffer. Fails if
 /// framebuffer is a null pointer. Fails if the attachment type is invalid.
-/// Fails if the attached texture type is invalid.
+/// Fails if the attached texture type is invalid. Fails if the layout of the
+/// attached texture differs from that of the other attached buffers. Fails if
+/// the number of samples of the texture differs from that of the other
+/// attached buffer.
 ///
 /// If the attached texture size is inconsistent, the width and height of the
 /// framebuffer will use the minimum of all texture sizes respectively.
@@ -82,13 +126,55 @@ bool attach_texture_to_framebuffer(struct framebuffer *framebuffer,
 ///
 void set_clear_color(float red, float green, float blue, float alpha);
 
+///
+/// \brief Sets the scissor rectangle.
+///
+/// While the scissor test is enabled, clear_framebuffer() and draw_triangle()
+/// only write the pixels inside the rectangle, in any framebuffer. Pixels of
+/// a multisampled framebuffer are inside if their center is. The scissor test
+/// is disabled initially.
+///
+/// \param left Left coordinate in pixel.
+/// \param bottom Bottom coordinate in pixel.
+/// \param width Width in pixel.
+/// \param height Height in pixel.
+///
+void set_scissor(uint32_t left, uint32_t bottom, uint32_t width,
+                 uint32_t height);
+
+///
+/// \brief Disables the scissor test, the whole framebuffer is written again.
+///
+void disable_scissor(void);
+
+///
+/// \brief Gets the pixels of the framebuffer that pass the scissor test.
+///
+/// The behavior is undefined if framebuffer is a null pointer.
+///
+/// \param framebuffer Pointer to the framebuffer to get.
+/// \return Returns the intersection of the scissor rectangle and the
+///         framebuffer, the whole framebuffer if the scissor test is disabled.
+///
+struct pixel_rectangle get_scissor_rectangle(
+    const struct framebuffer *framebuffer);
+
 ///
 /// \brief Uses preset values to clear all buffers in the framebuffer.
 ///
 /// Each pixel of the color buffer will be cleared using the value previously
 /// set via the set_clear_color() function. For depth buffers, a fixed value of
-/// 1 will be used to clear each pixel. If framebuffer is a null pointer, the
-/// function does nothing.
+/// 1 will be used to clear each pixel. The motion vector buffer is cleared to
+/// 0, the background does not move. Only the pixels inside the scissor
+/// rectangle are cleared, see set_scissor(). If framebuffer is a null pointer,
+/// the function does nothing.
+///
+/// The buffers are cleared with clear_texture(), which marks the tiles inside
+/// the scissor rectangle instead of writing them. A tile is written when it is
+/// first drawn to, tiles not covered by any triangle stay marked until the
+/// buffer is read back with get_texture_pixels(). Sampling, resolving and the
+/// post-process passes read the clear value of a marked tile instead, so they
+/// never write to the buffer.
 ///
 /// \param framebuffer Pointer to the framebuffer to clear.
 ///
@@ -116,6 +202,31 @@ uint32_t get_framebuffer_width(const struct framebuffer *framebuffer);
 ///
 uint32_t get_framebuffer_height(const struct framebuffer *framebuffer);
 
+///
+/// \brief Gets the number of samples of each pixel of the framebuffer.
+///
+/// Returns TEXTURE_SAMPLE_COUNT if the buffers are in multisampled formats,
+/// otherwise returns 1. The behavior is undefined if framebuffer is a null
+/// pointer.
+///
+/// \param framebuffer Pointer to the framebuffer to get.
+/// \return Returns the number of samples of each pixel.
+///
+uint32_t get_framebuffer_sample_count(const struct framebuffer *framebuffer);
+
+///
+/// \brief Gets the layout of the buffers of the framebuffer.
+///
+/// All buffers of a framebuffer share a layout, see
+/// attach_texture_to_framebuffer(). Returns TEXTURE_LAYOUT_LINEAR if no buffer
+/// is attached. The behavior is undefined if framebuffer is a null pointer.
+///
+/// \param framebuffer Pointer to the framebuffer to get.
+/// \return Returns the layout of the buffers.
+///
+enum texture_layout get_framebuffer_layout(
+    const struct framebuffer *framebuffer);
+
 ///
 /// \brief Gets the buffer of the specified attachment type from the
 ///        framebuffer.
@@ -131,4 +242,24 @@ uint32_t get_framebuffer_height(const struct framebuffer *framebuffer);
 struct texture *get_framebuffer_attachment(struct framebuffer *framebuffer,
                                            enum attachment_type attachment);
 
+///
+/// \brief Averages the samples of each pixel of a multisampled color buffer.
+///
+/// The samples are averaged in linear color space before tone mapping, like
+/// the resolve of GPUs. Compressed pixels are copied without averaging, so the
+/// cost of the resolve grows with the number of pixels on the edges of
+/// triangles rather than with the number of samples.
+///
+/// Fails if target or source is a null pointer. Fails if the format of the
+/// target is not TEXTURE_FORMAT_RGBA16F or the format of the source is not
+/// TEXTURE_FORMAT_RGBA16F_4X. Fails if the textures differ in size. Fails if
+/// the target is not in TEXTURE_LAYOUT_LINEAR.
+///
+/// \param target The texture to write to.
+/// \param source The multisampled texture to read from.
+/// \return Returns true on success, false on failure.
+///
+bool resolve_multisample_texture(struct texture *target,
+                                 const struct texture *source);
+
 #endif  // FOOLRENDERER_GRAPHICS_FRAMEBUFFER_H_
@@ -0,0 +1,283 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/light_clusters.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "math/math_utility.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+
+struct light_clusters {
+    uint32_t tile_count_x;
+    uint32_t tile_count_y;
+    uint32_t slice_count;
+    uint32_t cluster_count;
+    // The view assigned by the last call of assign_lights_to_clusters().
+    matrix4x4 world2clip;
+    matrix4x4 world2view;
+    float near;
+    // Converts log2(depth / near) to the index of the slice.
+    float slice_scale;
+    // The lights of the cluster i are light_indices[offsets[i]] to
+    // light_indices[offsets[i + 1] - 1].
+    uint32_t *offsets;
+    uint32_t *light_indices;
+    size_t light_index_capacity;
+};
+
+// The range of tiles overlapped by a part of the bounding sphere of a light.
+struct tile_range {
+    uint32_t min_x, max_x;
+    uint32_t min_y, max_y;
+};
+
+struct light_clusters *create_light_clusters(uint32_t tile_count_x,
+                                             uint32_t tile_count_y,
+                                             uint32_t slice_count) {
+    if (tile_count_x == 0 || tile_count_y == 0 || slice_count == 0) {
+        return NULL;
+    }
+    struct light_clusters *clusters = malloc(sizeof(struct light_clusters));
+    if (clusters == NULL) {
+        return NULL;
+    }
+    clusters->tile_count_x = tile_count_x;
+    clusters->tile_count_y = tile_count_y;
+    clusters->slice_count = slice_count;
+    clusters->cluster_count = tile_count_x * tile_count_y * slice_count;
+    clusters->world2clip = MATRIX4X4_IDENTITY;
+    clusters->world2view = MATRIX4X4_IDENTITY;
+    clusters->near = 1.0f;
+    clusters->slice_scale = 0.0f;
+    // Until lights are assigned, every cluster is empty.
+    clusters->offsets = calloc(clusters->cluster_count + 1, sizeof(uint32_t));
+    clusters->light_indices = NULL;
+    clusters->light_index_capacity = 0;
+    if (clusters->offsets == NULL) {
+        free(clusters);
+        return NULL;
+    }
+    return clusters;
+}
+
+void destroy_light_clusters(struct light_clusters *clusters) {
+    if (clusters != NULL) {
+        free(clusters->offsets);
+        free(clusters->light_indices);
+        free(clusters);
+    }
+}
+
+static inline uint32_t get_slice(const struct light_clusters *clusters,
+                                 float depth) {
+    if (depth <= clusters->near) {
+        return 0;
+    }
+    float slice = log2f(depth / clusters->near) * clusters->slice_scale;
+    return uint32_min((uint32_t)slice, clusters->slice_count - 1);
+}
+
+// Gets the tile containing a coordinate in normalized device coordinates.
+static inline uint32_t get_tile(float ndc, uint32_t tile_count) {
+    float tile = (ndc * 0.5f + 0.5f) * (float)tile_count;
+    if (!(tile > 0.0f)) {
+        return 0;
+    }
+    return uint32_min((uint32_t)tile, tile_count - 1);
+}
+
+static inline size_t get_cluster_index(const struct light_clusters *clusters,
+                                       uint32_t x, uint32_t y,
+                                       uint32_t slice) {
+    return ((size_t)slice * clusters->tile_count_y + y) *
+               clusters->tile_count_x +
+           x;
+}
+
+// Gets the distance to the near side of the slice.
+static inline float get_slice_depth(const struct light_clusters *clusters,
+                                    uint32_t slice) {
+    return clusters->near * exp2f((float)slice / clusters->slice_scale);
+}
+
+// Finds the tiles overlapped by the box from (center.x - radius, center.y -
+// radius, -max_depth) to (center.x + radius, center.y + radius, -min_depth) in
+// view space. Returns false if the box is outside of the screen.
+static bool find_tile_range(const struct light_clusters *clusters,
+                            matrix4x4 view2clip, vector2 center, float radius,
+                            float min_depth, float max_depth,
+                            struct tile_range *range) {
+    // If the box reaches behind the camera of a perspective projection, its
+    // projection is unbounded.
+    float min_x = INFINITY;
+    float min_y = INFINITY;
+    float max_x = -INFINITY;
+    float max_y = -INFINITY;
+    for (uint32_t i = 0; i < 8; i++) {
+        vector4 corner = {{center.x + (i & 1 ? radius : -radius),
+                           center.y + (i & 2 ? radius : -radius),
+                           i & 4 ? -min_depth : -max_depth, 1.0f}};
+        vector4 clip = matrix4x4_multiply_vector4(view2clip, corner);
+        if (clip.w <= 1e-6f) {
+            min_x = min_y = -1.0f;
+            max_x = max_y = 1.0f;
+            break;
+        }
+        min_x = float_min(min_x, clip.x / clip.w);
+        min_y = float_min(min_y, clip.y / clip.w);
+        max_x = float_max(max_x, clip.x / clip.w);
+        max_y = float_max(max_y, clip.y / clip.w);
+    }
+    if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f) {
+        return false;
+    }
+    range->min_x = get_tile(min_x, clusters->tile_count_x);
+    range->max_x = get_tile(max_x, clusters->tile_count_x);
+    range->min_y = get_tile(min_y, clusters->tile_count_y);
+    range->max_y = get_tile(max_y, clusters->tile_count_y);
+    return true;
+}
+
+// Adds a light to the clusters overlapped by its bounding sphere. The first
+// pass only counts the lights of each cluster in the offset following it, the
+// second pass writes the light to the cluster and decrements its offset.
+// Returns the number of clusters the light is added to.
+static size_t add_light_to_clusters(struct light_clusters *clusters,
+                                    matrix4x4 view2clip, float far,
+                                    vector4 bounds, uint32_t light_index,
+                                    bool is_counting) {
+    vector4 center = matrix4x4_multiply_vector4(
+        clusters->world2view, (vector4){{bounds.x, bounds.y, bounds.z, 1.0f}});
+    float radius = bounds.w;
+    // The camera looks along the negative z axis of the view space.
+    float center_depth = -center.z;
+    float min_depth = center_depth - radius;
+    float max_depth = center_depth + radius;
+    if (max_depth < clusters->near || min_depth > far) {
+        return 0;
+    }
+    uint32_t min_slice = get_slice(clusters, min_depth);
+    uint32_t max_slice = get_slice(clusters, max_depth);
+    size_t cluster_count = 0;
+    for (uint32_t s = min_slice; s <= max_slice; s++) {
+        // Within a slice the sphere is bounded by its widest cross section,
+        // which is narrower than the sphere unless the slice contains the
+        // center.
+        // The first and last slices also contain the positions in front of
+        // and behind them.
+        float slice_min_depth =
+            s == 0 ? min_depth : get_slice_depth(clusters, s);
+        float slice_max_depth = s == clusters->slice_count - 1
+                                    ? max_depth
+                                    : get_slice_depth(clusters, s + 1);
+        float distance = 0.0f;
+        if (center_depth < slice_min_depth) {
+            distance = slice_min_depth - center_depth;
+        } else if (center_depth > slice_max_depth) {
+            distance = center_depth - slice_max_depth;
+        }
+        if (distance >= radius) {
+            continue;
+        }
+        struct tile_range range;
+        if (!find_tile_range(
+                clusters, view2clip, (vector2){{center.x, center.y}},
+                sqrtf(radius * radius - distance * distance),
+                float_max(slice_min_depth, min_depth),
+                float_min(slice_max_depth, max_depth), &range)) {
+            continue;
+        }
+        for (uint32_t y = range.min_y; y <= range.max_y; y++) {
+            for (uint32_t x = range.min_x; x <= range.max_x; x++) {
+                size_t cluster = get_cluster_index(clusters, x, y, s);
+                if (is_counting) {
+                    clusters->offsets[cluster + 1]++;
+                } else {
+                    clusters->light_indices[--clusters->offsets[cluster]] =
+                        light_index;
+                }
+                cluster_count++;
+            }
+        }
+    }
+    return cluster_count;
+}
+
+bool assign_lights_to_clusters(struct light_clusters *clusters,
+                               matrix4x4 world2view, matrix4x4 view2clip,
+                               float near, float far, const vector4 *bounds,
+                               uint32_t light_count) {
+    if (clusters == NULL || (bounds == NULL && light_count != 0) ||
+        !(near > 0.0f) || !(near < far)) {
+        return false;
+    }
+    clusters->world2view = world2view;
+    clusters->world2clip = matrix4x4_multiply(view2clip, world2view);
+    clusters->near = near;
+    clusters->slice_scale = (float)clusters->slice_count / log2f(far / near);
+
+    // The first pass counts the lights of each cluster, the counts are then
+    // turned into offsets, and the second pass writes the light indices.
+    uint32_t *offsets = clusters->offsets;
+    for (uint32_t i = 0; i <= clusters->cluster_count; i++) {
+        offsets[i] = 0;
+    }
+    size_t total_count = 0;
+    for (uint32_t l = 0; l < light_count; l++) {
+        total_count +=
+            add_light_to_clusters(clusters, view2clip, far, bounds[l], l, true);
+    }
+    if (total_count > clusters->light_index_capacity) {
+        uint32_t *light_indices = realloc(clusters->light_indices,
+                                          total_count * sizeof(uint32_t));
+        if (light_indices == NULL) {
+            for (uint32_t i = 0; i <= clusters->cluster_count; i++) {
+                offsets[i] = 0;
+            }
+            return false;
+        }
+        clusters->light_indices = light_indices;
+        clusters->light_index_capacity = total_count;
+    }
+    for (uint32_t i = 0; i < clusters->cluster_count; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    // Each cluster is filled from its end, so that after the second pass the
+    // offset of the cluster is back at its first light.
+    for (uint32_t i = 0; i < clusters->cluster_count; i++) {
+        offsets[i] = offsets[i + 1];
+    }
+    for (uint32_t l = light_count; l-- > 0;) {
+        add_light_to_clusters(clusters, view2clip, far, bounds[l], l, false);
+    }
+    return true;
+}
+
+const uint32_t *get_cluster_lights(const struct light_clusters *clusters,
+                                   vector3 position, uint32_t *light_count) {
+    vector4 world_position = vector3_to_4(position, 1.0f);
+    vector4 clip =
+        matrix4x4_multiply_vector4(clusters->world2clip, world_position);
+    // Only the z component of the view space position is needed.
+    const float *row = clusters->world2view.elements[2];
+    float depth = -(row[0] * position.x + row[1] * position.y +
+                    row[2] * position.z + row[3]);
+    uint32_t x = get_tile(clip.x / clip.w, clusters->tile_count_x);
+    uint32_t y = get_tile(clip.y / clip.w, clusters->tile_count_y);
+    uint32_t slice = get_slice(clusters, depth);
+    size_t cluster = get_cluster_index(clusters, x, y, slice);
+    uint32_t first = clusters->offsets[cluster];
+    *light_count = clusters->offsets[cluster + 1] - first;
+    if (*light_count == 0) {
+        return NULL;
+    }
+    return clusters->light_indices + first;
+}
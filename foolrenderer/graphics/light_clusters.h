@@ -0,0 +1,96 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_LIGHT_CLUSTERS_H_
+#define FOOLRENDERER_GRAPHICS_LIGHT_CLUSTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "math/matrix.h"
+#include "math/vector.h"
+
+// Clustered shading divides the view frustum into a grid of clusters: tiles on
+// the screen, each split into slices along the view depth. Every frame the
+// lights are assigned to the clusters their bounding spheres overlap, and a
+// fragment only evaluates the lights of its own cluster. For the technique,
+// refer to:
+// https://www.cse.chalmers.se/~uffe/clustered_shading_preprint.pdf
+//
+// The slices are spaced exponentially between the near and far distances, so
+// that clusters are roughly as deep as they are wide in a perspective view.
+
+///
+/// \brief The lights assigned to each cluster of the view frustum.
+///
+struct light_clusters;
+
+///
+/// \brief Creates a grid of clusters.
+///
+/// Fails if any count is 0. Fails if memory allocation fails.
+///
+/// \param tile_count_x The number of tiles in the horizontal direction.
+/// \param tile_count_y The number of tiles in the vertical direction.
+/// \param slice_count The number of slices along the view depth.
+/// \return Returns a pointer to the clusters on success, null pointer on
+///         failure.
+///
+struct light_clusters *create_light_clusters(uint32_t tile_count_x,
+                                             uint32_t tile_count_y,
+                                             uint32_t slice_count);
+
+///
+/// \brief Releases the memory of the clusters.
+///
+/// If clusters is a null pointer, the function does nothing.
+///
+/// \param clusters Pointer to the clusters to destroy.
+///
+void destroy_light_clusters(struct light_clusters *clusters);
+
+///
+/// \brief Assigns lights to the clusters of a view.
+///
+/// Each light is described by a bounding sphere in world space, stored as
+/// (center.x, center.y, center.z, radius), outside of which it does not
+/// affect surfaces. In each slice, a light is assigned to every tile
+/// overlapped by the screen rectangle of the part of its sphere within the
+/// slice, which is conservative.
+/// The lights are referred to by their index in the array.
+///
+/// Fails if clusters is a null pointer, if bounds is a null pointer while
+/// light_count is not 0, or if near is not in range (0, far). Fails if memory
+/// allocation fails, then no light is assigned to any cluster.
+///
+/// \param clusters Pointer to the clusters.
+/// \param world2view The view matrix of the camera.
+/// \param view2clip The projection matrix of the camera.
+/// \param near The distance to the nearest slice.
+/// \param far The distance to the farthest slice.
+/// \param bounds The bounding spheres of the lights.
+/// \param light_count The number of lights.
+/// \return Returns true on success, false on failure.
+///
+bool assign_lights_to_clusters(struct light_clusters *clusters,
+                               matrix4x4 world2view, matrix4x4 view2clip,
+                               float near, float far, const vector4 *bounds,
+                               uint32_t light_count);
+
+///
+/// \brief Gets the lights of the cluster containing a position.
+///
+/// Positions outside of the view frustum use the nearest cluster.
+///
+/// \param clusters Pointer to the clusters.
+/// \param position The position in world space.
+/// \param light_count Receives the number of lights of the cluster.
+/// \return Returns the indices of the lights of the cluster, null pointer if
+///         the cluster has no lights.
+///
+const uint32_t *get_cluster_lights(const struct light_clusters *clusters,
+                                   vector3 position, uint32_t *light_count);
+
+#endif  // FOOLRENDERER_GRAPHICS_LIGHT_CLUSTERS_H_
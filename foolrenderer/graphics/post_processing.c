@@ -0,0 +1,416 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/post_processing.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "graphics/color.h"
+#include "graphics/texture.h"
+#include "graphics/tone_mapping.h"
+#include "math/math_utility.h"
+#include "math/vector.h"
+
+// The size of the tiles the chain runs on. With the border of the built-in
+// passes, the two float buffers of a tile take about 2.5 MB, which stays in the
+// last level cache while larger tiles would spend more time on memory and
+// smaller ones more time on their borders.
+#define TILE_SIZE 256
+
+struct post_process_pass {
+    post_process_function apply;
+    uint32_t radius;
+    const void *parameters;
+};
+
+struct post_process_chain {
+    struct post_process_pass passes[MAX_POST_PROCESS_PASSES];
+    uint32_t pass_count;
+    // The sum of the radii of the passes, the width of the border of a tile.
+    uint32_t border;
+    // The buffers the passes read from and write to, each large enough for a
+    // tile and its border. They grow with the border and are kept across
+    // calls.
+    vector4 *buffers[2];
+    size_t buffer_capacity;
+};
+
+struct post_process_chain *create_post_process_chain(void) {
+    struct post_process_chain *chain =
+        malloc(sizeof(struct post_process_chain));
+    if (chain == NULL) {
+        return NULL;
+    }
+    chain->pass_count = 0;
+    chain->border = 0;
+    chain->buffers[0] = NULL;
+    chain->buffers[1] = NULL;
+    chain->buffer_capacity = 0;
+    return chain;
+}
+
+void destroy_post_process_chain(struct post_process_chain *chain) {
+    if (chain != NULL) {
+        free(chain->buffers[0]);
+        free(chain->buffers[1]);
+        free(chain);
+    }
+}
+
+bool add_post_process_pass(struct post_process_chain *chain,
+                           post_process_function pass, uint32_t radius,
+                           const void *parameters) {
+    if (chain == NULL || pass == NULL ||
+        chain->pass_count == MAX_POST_PROCESS_PASSES) {
+        return false;
+    }
+    struct post_process_pass *target = &chain->passes[chain->pass_count++];
+    target->apply = pass;
+    target->radius = radius;
+    target->parameters = parameters;
+    chain->border += radius;
+    return true;
+}
+
+static bool reserve_buffers(struct post_process_chain *chain, size_t size) {
+    if (size <= chain->buffer_capacity) {
+        return true;
+    }
+    for (int i = 0; i < 2; i++) {
+        vector4 *buffer = realloc(chain->buffers[i], size * sizeof(vector4));
+        if (buffer == NULL) {
+            return false;
+        }
+        chain->buffers[i] = buffer;
+    }
+    chain->buffer_capacity = size;
+    return true;
+}
+
+static inline vector4 decode_pixel(const uint8_t *pixels,
+                                   enum texture_format format, size_t index) {
+    if (format == TEXTURE_FORMAT_RGBA16F) {
+        const uint16_t *half = (const uint16_t *)pixels + index * 4;
+        return (vector4){{half_to_float(half[0]), half_to_float(half[1]),
+                          half_to_float(half[2]), half_to_float(half[3])}};
+    }
+    // format == TEXTURE_FORMAT_R11G11B10F
+    float rgb[3];
+    unpack_r11g11b10f(rgb, ((const uint32_t *)pixels)[index]);
+    return (vector4){{rgb[0], rgb[1], rgb[2], 1.0f}};
+}
+
+// Decodes the pixels of the source from (x, y) to (x + width, y + height) into
+// the buffer, the coordinates out of the source are clamped to its edges. The
+// pixels of the tiles a deferred clear has not written yet are read from the
+// clear, see get_texture_clear_texel().
+static void decode_tile(vector4 *buffer, size_t stride,
+                        const struct texture *source, const uint8_t *pixels,
+                        int64_t x, int64_t y, uint32_t width,
+                        uint32_t height) {
+    enum texture_format format = get_texture_format(source);
+    bool is_tiled = get_texture_layout(source) == TEXTURE_LAYOUT_TILED;
+    uint32_t texture_width = get_texture_width(source);
+    uint32_t texture_height = get_texture_height(source);
+    for (uint32_t row = 0; row < height; row++) {
+        int64_t source_y = y + row;
+        source_y = source_y < 0 ? 0 : source_y;
+        source_y = source_y >= texture_height ? texture_height - 1 : source_y;
+        size_t row_offset = (size_t)source_y * texture_width;
+        vector4 *target = buffer + row * stride;
+        for (uint32_t column = 0; column < width; column++) {
+            int64_t source_x = x + column;
+            source_x = source_x < 0 ? 0 : source_x;
+            source_x = source_x >= texture_width ? texture_width - 1 : source_x;
+            const uint8_t *clear_texel = get_texture_clear_texel(
+                source, (uint32_t)source_x, (uint32_t)source_y);
+            if (clear_texel != NULL) {
+                target[column] = decode_pixel(clear_texel, format, 0);
+                continue;
+            }
+            size_t index = is_tiled ? get_tiled_texel_index(
+                                          texture_width, (uint32_t)source_x,
+                                          (uint32_t)source_y)
+                                    : row_offset + (size_t)source_x;
+            target[column] = decode_pixel(pixels, format, index);
+        }
+    }
+}
+
+static void encode_tile(uint8_t *pixels, size_t pixel_size, bool is_srgb,
+                        uint32_t texture_width, uint32_t x, uint32_t y,
+                        const vector4 *buffer, size_t stride, uint32_t width,
+                        uint32_t height) {
+    for (uint32_t row = 0; row < height; row++) {
+        const vector4 *source = buffer + row * stride;
+        uint8_t *target =
+            pixels + ((size_t)(y + row) * texture_width + x) * pixel_size;
+        for (uint32_t column = 0; column < width; column++) {
+            uint8_t *pixel = target + column * pixel_size;
+            for (int c = 0; c < 3; c++) {
+                float value = float_clamp01(source[column].elements[c]);
+                pixel[c] = is_srgb ? linear_to_srgb8(value)
+                                   : float_to_uint8(value);
+            }
+            if (pixel_size == 4) {
+                pixel[3] = float_to_uint8(float_clamp01(source[column].a));
+            }
+        }
+    }
+}
+
+bool apply_post_process_chain(struct post_process_chain *chain,
+                              struct texture *target,
+                              const struct texture *source) {
+    if (chain == NULL || target == NULL || source == NULL) {
+        return false;
+    }
+    enum texture_format source_format = get_texture_format(source);
+    if (source_format != TEXTURE_FORMAT_RGBA16F &&
+        source_format != TEXTURE_FORMAT_R11G11B10F) {
+        return false;
+    }
+    enum texture_format target_format = get_texture_format(target);
+    size_t target_pixel_size;
+    if (target_format == TEXTURE_FORMAT_RGB8 ||
+        target_format == TEXTURE_FORMAT_SRGB8) {
+        target_pixel_size = 3;
+    } else if (target_format == TEXTURE_FORMAT_RGBA8 ||
+               target_format == TEXTURE_FORMAT_SRGB8_A8) {
+        target_pixel_size = 4;
+    } else {
+        return false;
+    }
+    bool is_srgb = target_format == TEXTURE_FORMAT_SRGB8 ||
+                   target_format == TEXTURE_FORMAT_SRGB8_A8;
+    uint32_t texture_width = get_texture_width(target);
+    uint32_t texture_height = get_texture_height(target);
+    if (texture_width != get_texture_width(source) ||
+        texture_height != get_texture_height(source) ||
+        get_texture_layout(target) != TEXTURE_LAYOUT_LINEAR ||
+        (get_texture_layout(source) != TEXTURE_LAYOUT_LINEAR &&
+         get_texture_layout(source) != TEXTURE_LAYOUT_TILED)) {
+        return false;
+    }
+    uint32_t border = chain->border;
+    size_t stride = TILE_SIZE + 2 * (size_t)border;
+    if (!reserve_buffers(chain, stride * stride)) {
+        return false;
+    }
+
+    // The source is read in place, in its own layout. The target is linear, so
+    // get_texture_pixels() returns its storage.
+    const uint8_t *source_pixels = get_texture_storage_const(source);
+    uint8_t *target_pixels = get_texture_pixels(target);
+    for (uint32_t y = 0; y < texture_height; y += TILE_SIZE) {
+        for (uint32_t x = 0; x < texture_width; x += TILE_SIZE) {
+            uint32_t width = uint32_min(TILE_SIZE, texture_width - x);
+            uint32_t height = uint32_min(TILE_SIZE, texture_height - y);
+            vector4 *input = chain->buffers[0];
+            vector4 *output = chain->buffers[1];
+            decode_tile(input, stride, source, source_pixels,
+                        (int64_t)x - border, (int64_t)y - border,
+                        width + 2 * border, height + 2 * border);
+            // The pixels within margin of the edges of the buffer are no longer
+            // valid, since the passes so far could not compute them.
+            uint32_t margin = 0;
+            for (uint32_t i = 0; i < chain->pass_count; i++) {
+                const struct post_process_pass *pass = &chain->passes[i];
+                margin += pass->radius;
+                size_t offset = margin * stride + margin;
+                uint32_t pass_width = width + 2 * (border - margin);
+                uint32_t pass_height = height + 2 * (border - margin);
+                if (pass->radius == 0) {
+                    pass->apply(input + offset, input + offset, stride,
+                                pass_width, pass_height, pass->parameters);
+                    continue;
+                }
+                pass->apply(output + offset, input + offset, stride,
+                            pass_width, pass_height, pass->parameters);
+                vector4 *temp = input;
+                input = output;
+                output = temp;
+            }
+            encode_tile(target_pixels, target_pixel_size, is_srgb,
+                        texture_width, x, y, input + border * stride + border,
+                        stride, width, height);
+        }
+    }
+    return true;
+}
+
+void post_process_tone_mapping(vector4 *output, const vector4 *input,
+                               size_t stride, uint32_t width, uint32_t height,
+                               const void *parameters) {
+    (void)parameters;
+    for (uint32_t row = 0; row < height; row++) {
+        vector4 *target = output + row * stride;
+        if (target != input + row * stride) {
+            for (uint32_t column = 0; column < width; column++) {
+                target[column] = input[row * stride + column];
+            }
+        }
+        tone_map_colors(target, width);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FXAA.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// The edge is skipped if the contrast of the local luma is below the larger of
+// the two thresholds, the second one relative to the maximum local luma.
+#define FXAA_EDGE_THRESHOLD_MIN 0.0312f
+#define FXAA_EDGE_THRESHOLD 0.125f
+// How much the subpixel aliasing is removed, 0 turns it off.
+#define FXAA_SUBPIXEL_QUALITY 0.75f
+#define FXAA_SEARCH_STEP_COUNT 6
+
+// The steps of the search along an edge, they add up to the radius.
+static const int32_t fxaa_search_steps[FXAA_SEARCH_STEP_COUNT] = {1, 1, 1,
+                                                                  2, 2, 4};
+
+// The perceived brightness, the luma of the color after an approximate gamma
+// of 2.
+static inline float fxaa_luma(vector4 color) {
+    return sqrtf(float_max(
+        0.299f * color.r + 0.587f * color.g + 0.114f * color.b, 0.0f));
+}
+
+// The luma halfway between the pixel and the pixel across the edge.
+static inline float fxaa_edge_luma(const vector4 *pixel, ptrdiff_t across) {
+    return 0.5f * (fxaa_luma(pixel[0]) + fxaa_luma(pixel[across]));
+}
+
+static vector4 fxaa_pixel(const vector4 *center, ptrdiff_t stride) {
+    float m = fxaa_luma(center[0]);
+    float n = fxaa_luma(center[stride]);
+    float s = fxaa_luma(center[-stride]);
+    float e = fxaa_luma(center[1]);
+    float w = fxaa_luma(center[-1]);
+    float luma_min = float_min(m, float_min(float_min(n, s), float_min(e, w)));
+    float luma_max = float_max(m, float_max(float_max(n, s), float_max(e, w)));
+    float range = luma_max - luma_min;
+    if (range < float_max(FXAA_EDGE_THRESHOLD_MIN,
+                          luma_max * FXAA_EDGE_THRESHOLD)) {
+        return center[0];
+    }
+    float ne = fxaa_luma(center[stride + 1]);
+    float nw = fxaa_luma(center[stride - 1]);
+    float se = fxaa_luma(center[-stride + 1]);
+    float sw = fxaa_luma(center[-stride - 1]);
+
+    // Whether the edge is horizontal or vertical.
+    float edge_horizontal = fabsf(-2.0f * w + nw + sw) +
+                            2.0f * fabsf(-2.0f * m + n + s) +
+                            fabsf(-2.0f * e + ne + se);
+    float edge_vertical = fabsf(-2.0f * n + nw + ne) +
+                          2.0f * fabsf(-2.0f * m + w + e) +
+                          fabsf(-2.0f * s + sw + se);
+    bool is_horizontal = edge_horizontal >= edge_vertical;
+    ptrdiff_t across = is_horizontal ? stride : 1;
+    ptrdiff_t along = is_horizontal ? 1 : stride;
+
+    // The edge is on the side with the steepest gradient.
+    float luma1 = is_horizontal ? s : w;
+    float luma2 = is_horizontal ? n : e;
+    float gradient1 = luma1 - m;
+    float gradient2 = luma2 - m;
+    float local_average;
+    if (fabsf(gradient1) >= fabsf(gradient2)) {
+        across = -across;
+        local_average = 0.5f * (luma1 + m);
+    } else {
+        local_average = 0.5f * (luma2 + m);
+    }
+    float gradient_scaled =
+        0.25f * float_max(fabsf(gradient1), fabsf(gradient2));
+
+    // Search along the edge in both directions until the luma halfway across
+    // the edge differs enough from the local average.
+    int32_t distance1 = 0;
+    int32_t distance2 = 0;
+    float luma_end1 = 0.0f;
+    float luma_end2 = 0.0f;
+    bool is_done1 = false;
+    bool is_done2 = false;
+    for (int i = 0; i < FXAA_SEARCH_STEP_COUNT && !(is_done1 && is_done2);
+         i++) {
+        if (!is_done1) {
+            distance1 += fxaa_search_steps[i];
+            luma_end1 = fxaa_edge_luma(center - distance1 * along, across) -
+                        local_average;
+            is_done1 = fabsf(luma_end1) >= gradient_scaled;
+        }
+        if (!is_done2) {
+            distance2 += fxaa_search_steps[i];
+            luma_end2 = fxaa_edge_luma(center + distance2 * along, across) -
+                        local_average;
+            is_done2 = fabsf(luma_end2) >= gradient_scaled;
+        }
+    }
+
+    // Blend towards the pixel across the edge by how close the pixel is to the
+    // nearer end, if the luma changes in the expected way at that end.
+    bool is_nearer1 = distance1 < distance2;
+    float distance = (float)(is_nearer1 ? distance1 : distance2);
+    float edge_offset = 0.5f - distance / (float)(distance1 + distance2);
+    bool is_center_smaller = m < local_average;
+    if (((is_nearer1 ? luma_end1 : luma_end2) < 0.0f) == is_center_smaller) {
+        edge_offset = 0.0f;
+    }
+
+    // Blend more where the pixel differs from its neighborhood as a whole,
+    // which catches the aliasing of details smaller than a pixel.
+    float average = (2.0f * (n + s + e + w) + ne + nw + se + sw) / 12.0f;
+    float subpixel = float_clamp01(fabsf(average - m) / range);
+    subpixel = (-2.0f * subpixel + 3.0f) * subpixel * subpixel;
+    float subpixel_offset = subpixel * subpixel * FXAA_SUBPIXEL_QUALITY;
+
+    float offset = float_max(edge_offset, subpixel_offset);
+    return vector4_lerp(center[0], center[across], offset);
+}
+
+void post_process_fxaa(vector4 *output, const vector4 *input, size_t stride,
+                       uint32_t width, uint32_t height,
+                       const void *parameters) {
+    (void)parameters;
+    for (uint32_t row = 0; row < height; row++) {
+        for (uint32_t column = 0; column < width; column++) {
+            size_t index = row * stride + column;
+            output[index] = fxaa_pixel(input + index, (ptrdiff_t)stride);
+        }
+    }
+}
+
+void post_process_sharpen(vector4 *output, const vector4 *input, size_t stride,
+                          uint32_t width, uint32_t height,
+                          const void *parameters) {
+    const struct post_process_sharpen_parameters *sharpen = parameters;
+    float strength = sharpen->strength;
+    ptrdiff_t up = (ptrdiff_t)stride;
+    for (uint32_t row = 0; row < height; row++) {
+        for (uint32_t column = 0; column < width; column++) {
+            size_t index = row * stride + column;
+            const vector4 *center = input + index;
+            vector4 result = center[0];
+            for (int c = 0; c < 3; c++) {
+                float neighbors =
+                    center[up].elements[c] + center[-up].elements[c] +
+                    center[1].elements[c] + center[-1].elements[c];
+                float value = center[0].elements[c];
+                result.elements[c] = float_clamp01(
+                    value + strength * (value - 0.25f * neighbors));
+            }
+            output[index] = result;
+        }
+    }
+}
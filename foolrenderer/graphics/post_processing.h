@@ -0,0 +1,155 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_POST_PROCESSING_H_
+#define FOOLRENDERER_GRAPHICS_POST_PROCESSING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "graphics/texture.h"
+#include "math/vector.h"
+
+// A post-processing chain resolves a high dynamic range color buffer into a
+// displayable texture through a sequence of passes. Instead of running each
+// pass over the whole image, the chain runs all passes on one tile of the
+// image at a time: the tile, plus a border wide enough for the neighborhoods
+// read by the passes, is decoded into a float buffer that stays in the cache,
+// the passes run on the buffer one after another, and only the final tile is
+// written to the target. The source and the target are therefore each
+// streamed through memory once, however many passes there are.
+//
+// The tiles only read the source and write their own pixels of the target, so
+// they are independent of each other and may be processed in any order or in
+// parallel.
+
+// The number of passes a chain holds at most.
+#define MAX_POST_PROCESS_PASSES 8
+
+// The number of pixels read around each output pixel by the built-in passes.
+#define POST_PROCESS_TONE_MAPPING_RADIUS 0
+#define POST_PROCESS_FXAA_RADIUS 11
+#define POST_PROCESS_SHARPEN_RADIUS 1
+
+///
+/// \brief Pointer to a post-processing pass.
+///
+/// The pass writes the width x height rectangle of pixels starting at output,
+/// reading the pixels of input within its radius around each of them, see
+/// add_post_process_pass(). Both buffers store the pixels row by row starting
+/// from the bottom row, each row is stride pixels long, and input points to the
+/// pixel at the same position as output. The colors are in linear color space
+/// and the alpha component is in the A component.
+///
+/// Passes with a radius of 0 run in place, input and output are then the same
+/// buffer.
+///
+typedef void (*post_process_function)(vector4 *output, const vector4 *input,
+                                      size_t stride, uint32_t width,
+                                      uint32_t height, const void *parameters);
+
+struct post_process_chain;
+
+struct post_process_sharpen_parameters {
+    // How much the difference to the average of the four neighbors is added
+    // to each pixel, 0 does not sharpen.
+    float strength;
+};
+
+///
+/// \brief Creates an empty post-processing chain.
+///
+/// \return Returns a pointer to the chain on success, null pointer on failure.
+///
+struct post_process_chain *create_post_process_chain(void);
+
+///
+/// \brief Releases the memory of the chain.
+///
+/// If chain is a null pointer, the function does nothing.
+///
+/// \param chain Pointer to the chain to destroy.
+///
+void destroy_post_process_chain(struct post_process_chain *chain);
+
+///
+/// \brief Appends a pass to the chain.
+///
+/// The passes run in the order they are added. The parameters are passed to
+/// the pass as is and must stay valid while the chain is used.
+///
+/// Fails if chain or pass is a null pointer. Fails if the chain already holds
+/// MAX_POST_PROCESS_PASSES passes.
+///
+/// \param chain Pointer to the chain.
+/// \param pass The pass to append.
+/// \param radius The number of pixels the pass reads around each output pixel.
+/// \param parameters The parameters of the pass, may be a null pointer.
+/// \return Returns true on success, false on failure.
+///
+bool add_post_process_pass(struct post_process_chain *chain,
+                           post_process_function pass, uint32_t radius,
+                           const void *parameters);
+
+///
+/// \brief Runs the passes of the chain on a high dynamic range texture and
+///        writes the result into a displayable texture.
+///
+/// The formats are the same as resolve_texture(). The result of the last pass
+/// is clamped to [0,1], converted to sRGB if the target is sRGB encoded, then
+/// quantized to 8 bits. Pixels beyond the edges of the source are read as the
+/// nearest edge pixel.
+///
+/// Fails if chain, target or source is a null pointer. Fails if the format of
+/// either texture is not supported. Fails if the textures differ in size. Fails
+/// if the target is not in TEXTURE_LAYOUT_LINEAR. The source may be in
+/// TEXTURE_LAYOUT_LINEAR or TEXTURE_LAYOUT_TILED. Fails if memory allocation
+/// fails.
+///
+/// \param chain Pointer to the chain.
+/// \param target The texture to write to.
+/// \param source The high dynamic range texture to read from.
+/// \return Returns true on success, false on failure.
+///
+bool apply_post_process_chain(struct post_process_chain *chain,
+                              struct texture *target,
+                              const struct texture *source);
+
+///
+/// \brief Tone maps the colors with the operator and exposure set by
+///        set_tone_mapping().
+///
+/// Passing this pass alone to a chain gives the same result as
+/// resolve_texture(). The parameters are not used.
+///
+void post_process_tone_mapping(vector4 *output, const vector4 *input,
+                               size_t stride, uint32_t width, uint32_t height,
+                               const void *parameters);
+
+///
+/// \brief Smooths the aliased edges with fast approximate anti-aliasing.
+///
+/// Expects colors in [0,1], so it should run after tone mapping. Follows FXAA
+/// 3.11 of Timothy Lottes, refer to:
+/// https://developer.download.nvidia.com/assets/gamedev/files/sdk/11/FXAA_WhitePaper.pdf
+/// The search along an edge ends within POST_PROCESS_FXAA_RADIUS pixels.
+/// The parameters are not used.
+///
+void post_process_fxaa(vector4 *output, const vector4 *input, size_t stride,
+                       uint32_t width, uint32_t height,
+                       const void *parameters);
+
+///
+/// \brief Sharpens the colors with an unsharp mask of the four neighbors.
+///
+/// The parameters must point to a post_process_sharpen_parameters. The result
+/// is clamped to [0,1], so it should run after tone mapping.
+///
+void post_process_sharpen(vector4 *output, const vector4 *input, size_t stride,
+                          uint32_t width, uint32_t height,
+                          const void *parameters);
+
+#endif  // FOOLRENDERER_GRAPHICS_POST_PROCESSING_H_
@@ -10,8 +10,10 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "graphics/color.h"
+#include "graphics/reprojection_cache.h"
 #include "graphics/shader_context.h"
 #include "graphics/texture.h"
 #include "math/math_utility.h"
@@ -39,38 +41,114 @@ static struct {
 static vertex_shader vs = NULL;
 static fragment_shader fs = NULL;
 
+static int8_t previous_position_variable = -1;
+static struct reprojection_cache *reprojection_cache = NULL;
+static uint32_t object_id = 1;
+
+static uniform_prepare_function prepare = NULL;
+// The block prepared for the fragment shader, and the uniform it was prepared
+// from. Shared by all fragments of a draw, so it is aligned to a cache line.
+static _Alignas(64) uint8_t prepared_uniform[MAX_PREPARED_UNIFORM_SIZE];
+static const void *prepared_source = NULL;
+
 // Framebuffer data.
 static uint32_t framebuffer_width = 0;
 static uint32_t framebuffer_height = 0;
+// Whether the attachments are in TEXTURE_LAYOUT_TILED instead of the linear
+// layout.
+static bool is_tiled = false;
+// The pixels that pass the scissor test, within the framebuffer.
+static struct pixel_rectangle scissor = {0};
+// The attached textures, their deferred clears are written before a triangle
+// touches their tiles.
+static struct texture *attachments[3] = {NULL};
 static uint8_t *color_buffer = NULL;
-static bool is_srgb_encoding = false;
+static enum texture_format color_format = TEXTURE_FORMAT_RGBA8;
+static size_t color_pixel_size = 0;
 static float *depth_buffer = NULL;
+// The number of samples of each pixel. If it is TEXTURE_SAMPLE_COUNT, the
+// color buffer is split into planes of color_plane_size bytes followed by the
+// compression flags, see TEXTURE_FORMAT_RGBA16F_4X.
+static uint32_t sample_count = 1;
+static size_t color_plane_size = 0;
+static uint8_t *compression_flags = NULL;
+static uint16_t *motion_vector_buffer = NULL;
+
+// The positions of the samples relative to the pixel center, in the standard
+// 4x pattern of Direct3D, refer to:
+// https://learn.microsoft.com/en-us/windows/win32/api/d3d11/ne-d3d11-d3d11_standard_multisample_quality_levels
+static const vector2 sample_offsets[TEXTURE_SAMPLE_COUNT] = {
+    {{-0.125f, -0.375f}},
+    {{0.375f, -0.125f}},
+    {{-0.375f, 0.125f}},
+    {{0.125f, 0.375f}}};
+// The largest distance of a sample from the pixel center along either axis.
+#define MAX_SAMPLE_OFFSET 0.375f
 
 static void parse_framebuffer(struct framebuffer *framebuffer) {
     framebuffer_width = get_framebuffer_width(framebuffer);
     framebuffer_height = get_framebuffer_height(framebuffer);
+    scissor = get_scissor_rectangle(framebuffer);
+    sample_count = get_framebuffer_sample_count(framebuffer);
+    is_tiled = get_framebuffer_layout(framebuffer) == TEXTURE_LAYOUT_TILED;
 
     struct texture *color_attachment =
         get_framebuffer_attachment(framebuffer, COLOR_ATTACHMENT);
+    attachments[0] = color_attachment;
     if (color_attachment == NULL) {
         color_buffer = NULL;
-        is_srgb_encoding = false;
     } else {
-        color_buffer = get_texture_pixels(color_attachment);
-        if (get_texture_format(color_attachment) == TEXTURE_FORMAT_SRGB8_A8) {
-            is_srgb_encoding = true;
-        } else {
-            is_srgb_encoding = false;
+        color_buffer = get_texture_storage(color_attachment);
+        color_format = get_texture_format(color_attachment);
+        switch (color_format) {
+            case TEXTURE_FORMAT_RGBA16F:
+                color_pixel_size = 8;
+                break;
+            case TEXTURE_FORMAT_RGBA16F_4X:
+                // The samples are written in the format of a single sample.
+                color_format = TEXTURE_FORMAT_RGBA16F;
+                color_pixel_size = 8;
+                color_plane_size = (size_t)get_texture_width(color_attachment) *
+                                   get_texture_height(color_attachment) *
+                                   color_pixel_size;
+                compression_flags =
+                    color_buffer + color_plane_size * TEXTURE_SAMPLE_COUNT;
+                break;
+            default:
+                // TEXTURE_FORMAT_RGBA8, TEXTURE_FORMAT_SRGB8_A8 and
+                // TEXTURE_FORMAT_R11G11B10F.
+                color_pixel_size = 4;
+                break;
         }
     }
 
     struct texture *depth_attachment =
         get_framebuffer_attachment(framebuffer, DEPTH_ATTACHMENT);
+    attachments[1] = depth_attachment;
     if (depth_attachment == NULL) {
         depth_buffer = NULL;
     } else {
-        depth_buffer = get_texture_pixels(depth_attachment);
+        depth_buffer = get_texture_storage(depth_attachment);
+    }
+
+    struct texture *motion_vector_attachment =
+        get_framebuffer_attachment(framebuffer, MOTION_VECTOR_ATTACHMENT);
+    attachments[2] = motion_vector_attachment;
+    if (motion_vector_attachment == NULL) {
+        motion_vector_buffer = NULL;
+    } else {
+        motion_vector_buffer = get_texture_storage(motion_vector_attachment);
+    }
+}
+
+// Gets the index of the pixel at (x, y) in the attachments. The quads are
+// aligned to even coordinates, so each quad lies within a tile of the tiled
+// layout.
+static inline size_t get_pixel_index(uint32_t x, uint32_t y) {
+    if (!is_tiled) {
+        return (size_t)y * framebuffer_width + x;
     }
+    return get_tiled_texel_index(framebuffer_width, x, y);
 }
 
 // The vertex position should be in clippig space.
@@ -130,6 +208,19 @@ static inline float edge_function(const vector2 *a, const vector2 *b,
     return (c->x - a->x) * (b->y - a->y) - (c->y - a->y) * (b->x - a->x);
 }
 
+// Interpolate depth, for more details refer to the OpenGL specification section
+// 3.6.1 equation 3.10:
+// https://www.khronos.org/registry/OpenGL/specs/gl/glspec33.core.pdf
+// For the purpose of reducing computational overhead, the calculated depth
+// value is in the screen space, and the depth value in this space is not
+// linear. Although it is enough for depth testing.
+static inline float interpolate_depth(const struct vertex vertices[],
+                                      const float barycentric[]) {
+    return barycentric[0] * vertices[0].depth +
+           barycentric[1] * vertices[1].depth +
+           barycentric[2] * vertices[2].depth;
+}
+
 // Returns true if the fragment is hidden. If the fragment is not hidden, return
 // false. If depth_test is a null pointer, skip the depth test and always return
 // false.
@@ -139,16 +230,8 @@ static inline bool depth_test(uint32_t x, uint32_t y,
     if (depth_buffer == NULL) {
         return false;
     }
-    // Interpolate depth, for more details refer to the OpenGL specification
-    // section 3.6.1 equation 3.10:
-    // https://www.khronos.org/registry/OpenGL/specs/gl/glspec33.core.pdf
-    // For the purpose of reducing computational overhead, the calculated depth
-    // value is in the screen space, and the depth value in this space is not
-    // linear. Although it is enough for depth testing.
-    float new_depth = barycentric[0] * vertices[0].depth +
-                      barycentric[1] * vertices[1].depth +
-                      barycentric[2] * vertices[2].depth;
-    float *depth = depth_buffer + (y * framebuffer_width + x);
+    float new_depth = interpolate_depth(vertices, barycentric);
+    float *depth = depth_buffer + get_pixel_index(x, y);
     bool is_hidden = new_depth > *depth;
     if (!is_hidden) {
         *depth = new_depth;
@@ -217,21 +300,101 @@ static void set_fragment_shader_input(struct shader_context *result,
 }
 
 static void write_color(uint8_t *pixel, vector4 color) {
-    color.r = float_clamp01(color.r);
-    color.g = float_clamp01(color.g);
-    color.b = float_clamp01(color.b);
-    color.a = float_clamp01(color.a);
-    if (is_srgb_encoding) {
+    if (color_format == TEXTURE_FORMAT_RGBA16F) {
+        // High dynamic range color buffers store the color as is, clamping,
+        // gamma correction and quantization are left to resolve_texture().
+        uint16_t *half = (uint16_t *)pixel;
+        for (int i = 0; i < 4; i++) {
+            half[i] = float_to_half(color.elements[i]);
+        }
+        return;
+    }
+    if (color_format == TEXTURE_FORMAT_R11G11B10F) {
+        *(uint32_t *)pixel = pack_r11g11b10f(color.r, color.g, color.b);
+        return;
+    }
+    if (color_format == TEXTURE_FORMAT_SRGB8_A8) {
         // Perform gamma correction if the color buffer to be written is sRGB
-        // encoded.
-        color.r = convert_to_srgb_color(color.r);
-        color.g = convert_to_srgb_color(color.g);
-        color.b = convert_to_srgb_color(color.b);
-    }
-    pixel[0] = float_to_uint8(color.r);
-    pixel[1] = float_to_uint8(color.g);
-    pixel[2] = float_to_uint8(color.b);
-    pixel[3] = float_to_uint8(color.a);
+        // encoded. The conversion also clamps the color.
+        pixel[0] = linear_to_srgb8(color.r);
+        pixel[1] = linear_to_srgb8(color.g);
+        pixel[2] = linear_to_srgb8(color.b);
+    } else {
+        pixel[0] = float_to_uint8(float_clamp01(color.r));
+        pixel[1] = float_to_uint8(float_clamp01(color.g));
+        pixel[2] = float_to_uint8(float_clamp01(color.b));
+    }
+    pixel[3] = float_to_uint8(float_clamp01(color.a));
+}
+
+// Writes the color to the samples of the pixel in the mask of a multisampled
+// color buffer. A pixel whose samples are all written is compressed, a
+// compressed pixel is expanded to all planes before some of its samples are
+// overwritten.
+static void write_samples(size_t pixel_index, uint32_t mask, vector4 color) {
+    uint16_t pixel[4];
+    write_color((uint8_t *)pixel, color);
+    uint8_t *sample = color_buffer + pixel_index * color_pixel_size;
+    if (mask == (1u << TEXTURE_SAMPLE_COUNT) - 1) {
+        memcpy(sample, pixel, sizeof(pixel));
+        compression_flags[pixel_index] = 1;
+        return;
+    }
+    if (compression_flags[pixel_index]) {
+        for (uint32_t s = 1; s < TEXTURE_SAMPLE_COUNT; s++) {
+            memcpy(sample + s * color_plane_size, sample, sizeof(pixel));
+        }
+        compression_flags[pixel_index] = 0;
+    }
+    for (uint32_t s = 0; s < TEXTURE_SAMPLE_COUNT; s++) {
+        if (mask & (1u << s)) {
+            memcpy(sample + s * color_plane_size, pixel, sizeof(pixel));
+        }
+    }
+}
+
+// Gets the screen space position and the depth of a fragment in the previous
+// frame. Only the previous clip space position is interpolated, so the position
+// is known before the other variables of the quad are. The previous position
+// variable must be set.
+static vector3 interpolate_previous_position(const struct vertex vertices[],
+                                             const float barycentric[]) {
+    float bc_over_w[3];
+    for (int i = 0; i < 3; i++) {
+        bc_over_w[i] = barycentric[i] * vertices[i].inverse_w;
+    }
+    float inverse_denominator =
+        1.0f / (bc_over_w[0] + bc_over_w[1] + bc_over_w[2]);
+    const float *sources[3];
+    for (int i = 0; i < 3; i++) {
+        sources[i] = (const float *)(vertices[i].context.vector4_variables +
+                                     previous_position_variable);
+    }
+    vector4 position;
+    interpolate_variables(position.elements, sources, 4, inverse_denominator,
+                          bc_over_w);
+    float inverse_w = 1.0f / position.w;
+    return (vector3){
+        {(position.x * inverse_w + 1.0f) * 0.5f * viewport.width +
+             viewport.left,
+         (position.y * inverse_w + 1.0f) * 0.5f * viewport.height +
+             viewport.bottom,
+         (position.z * inverse_w + 1.0f) * 0.5f}};
+}
+
+// Writes the motion of the pixel at (x, y) since the previous frame, 0 if the
+// previous position is a null pointer.
+static void write_motion_vector(uint32_t x, uint32_t y,
+                                const vector3 *previous) {
+    vector2 motion = VECTOR2_ZERO;
+    if (previous != NULL) {
+        motion = (vector2){{(float)x - previous->x, (float)y - previous->y}};
+    }
+    uint16_t *pixel = motion_vector_buffer + get_pixel_index(x, y) * 4;
+    pixel[0] = float_to_half(motion.x);
+    pixel[1] = float_to_half(motion.y);
+    pixel[2] = 0;
+    pixel[3] = 0;
 }
 
 void set_viewport(int left, int bottom, uint32_t width, uint32_t height) {
@@ -245,6 +408,236 @@ void set_vertex_shader(vertex_shader shader) { vs = shader; }
 
 void set_fragment_shader(fragment_shader shader) { fs = shader; }
 
+void set_previous_position_variable(int8_t index) {
+    previous_position_variable = index;
+}
+
+void set_reprojection_cache(struct reprojection_cache *cache) {
+    reprojection_cache = cache;
+}
+
+void set_object_id(uint32_t id) { object_id = id; }
+
+void set_uniform_prepare(uniform_prepare_function function) {
+    prepare = function;
+    prepared_source = NULL;
+}
+
+void prepare_uniform(const void *uniform) {
+    if (prepare != NULL && uniform != NULL) {
+        prepare(prepared_uniform, uniform);
+        prepared_source = uniform;
+    }
+}
+
+// The scissor rectangle lies within the framebuffer, so this also tests that
+// the pixel is in the framebuffer.
+static inline bool is_in_scissor(uint32_t x, uint32_t y) {
+    return x >= scissor.left && x < scissor.right && y >= scissor.bottom &&
+           y < scissor.top;
+}
+
+// Rasterizes the 2x2 quad whose bottom-left pixel is (x, y). The index of a
+// pixel in the quad is (y_offset << 1) | x_offset.
+//
+// All four fragments of the quad are interpolated even if some of them are not
+// covered by the triangle. Like GPUs, the uncovered fragments serve as helpers
+// for computing derivatives; they are neither shaded nor written.
+static void draw_quad(uint32_t x, uint32_t y, const struct vertex vertices[],
+                      float inverse_area, const void *uniform) {
+    float barycentric[4][3];
+    bool is_visible[4];
+    bool has_visible_fragment = false;
+    for (int i = 0; i < 4; i++) {
+        uint32_t px = x + (i & 1);
+        uint32_t py = y + (i >> 1);
+        vector2 p = (vector2){{px, py}};
+        // The barycentric coordinates of p.
+        float *bc = barycentric[i];
+        // Note that this is not the final barycentric coordinates.
+        bc[0] = edge_function(&vertices[1].screen_space_position,
+                              &vertices[2].screen_space_position, &p);
+        bc[1] = edge_function(&vertices[2].screen_space_position,
+                              &vertices[0].screen_space_position, &p);
+        bc[2] = edge_function(&vertices[0].screen_space_position,
+                              &vertices[1].screen_space_position, &p);
+        // If any component of the barycentric coordinates is greater than 0,
+        // it means that the pixel is outside the triangle.
+        bool is_inside = bc[0] <= 0.0f && bc[1] <= 0.0f && bc[2] <= 0.0f &&
+                         is_in_scissor(px, py);
+        // Calculate the barycentric coordinates of point p.
+        bc[0] *= inverse_area;
+        bc[1] *= inverse_area;
+        bc[2] *= inverse_area;
+
+        is_visible[i] = is_inside && !depth_test(px, py, vertices, bc);
+        has_visible_fragment |= is_visible[i];
+    }
+    if (!has_visible_fragment) {
+        return;
+    }
+
+    // A visible fragment keeps the color of the same surface in the previous
+    // frame if the reprojection cache has it. The quad is only interpolated in
+    // full and shaded if some visible fragment is not cached.
+    bool has_previous_position =
+        previous_position_variable >= 0 &&
+        (reprojection_cache != NULL || motion_vector_buffer != NULL);
+    vector3 previous_positions[4];
+    struct cached_color colors[4];
+    bool is_cached[4] = {false, false, false, false};
+    bool is_shaded = false;
+    for (int i = 0; i < 4; i++) {
+        if (!is_visible[i]) {
+            continue;
+        }
+        if (has_previous_position) {
+            previous_positions[i] =
+                interpolate_previous_position(vertices, barycentric[i]);
+            if (reprojection_cache != NULL) {
+                is_cached[i] = fetch_reprojected_color(
+                    reprojection_cache, previous_positions[i], object_id,
+                    &colors[i]);
+            }
+        }
+        is_shaded |= !is_cached[i];
+    }
+    if (is_shaded) {
+        struct shader_context quad[4];
+        for (int i = 0; i < 4; i++) {
+            clear_shader_context(&quad[i]);
+            set_fragment_shader_input(&quad[i], vertices, barycentric[i]);
+            quad[i].quad = quad;
+            quad[i].quad_index = i;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (is_visible[i] && !is_cached[i]) {
+                colors[i].color = fs(&quad[i], uniform);
+                colors[i].offset = VECTOR2_ZERO;
+                colors[i].lifetime = 0;
+            }
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (!is_visible[i]) {
+            continue;
+        }
+        uint32_t px = x + (i & 1);
+        uint32_t py = y + (i >> 1);
+        if (reprojection_cache != NULL) {
+            store_shaded_color(reprojection_cache, px, py,
+                               interpolate_depth(vertices, barycentric[i]),
+                               object_id, &colors[i]);
+        }
+        if (color_buffer != NULL) {
+            uint8_t *pixel =
+                color_buffer + get_pixel_index(px, py) * color_pixel_size;
+            write_color(pixel, colors[i].color);
+        }
+        if (motion_vector_buffer != NULL) {
+            write_motion_vector(
+                px, py, has_previous_position ? &previous_positions[i] : NULL);
+        }
+    }
+}
+
+// Same as depth_test(), but tests one sample of a multisampled depth buffer.
+static inline bool sample_depth_test(uint32_t x, uint32_t y, uint32_t sample,
+                                     const struct vertex vertices[],
+                                     const float barycentric[]) {
+    if (depth_buffer == NULL) {
+        return false;
+    }
+    float new_depth = interpolate_depth(vertices, barycentric);
+    float *depth =
+        depth_buffer + get_pixel_index(x, y) * TEXTURE_SAMPLE_COUNT + sample;
+    bool is_hidden = new_depth > *depth;
+    if (!is_hidden) {
+        *depth = new_depth;
+    }
+    return is_hidden;
+}
+
+// Same as draw_quad(), but for multisampled framebuffers. Coverage and depth
+// are tested for each sample, the fragment shader still runs once for each
+// pixel with a visible sample, at the pixel center. The edge functions change
+// by edge_offsets[s] from the pixel center to sample s.
+static void draw_multisample_quad(uint32_t x, uint32_t y,
+                                  const struct vertex vertices[],
+                                  float inverse_area,
+                                  float edge_offsets[][3],
+                                  const void *uniform) {
+    float barycentric[4][3];
+    uint32_t masks[4];
+    bool has_visible_fragment = false;
+    for (int i = 0; i < 4; i++) {
+        uint32_t px = x + (i & 1);
+        uint32_t py = y + (i >> 1);
+        vector2 p = (vector2){{px, py}};
+        float *bc = barycentric[i];
+        bc[0] = edge_function(&vertices[1].screen_space_position,
+                              &vertices[2].screen_space_position, &p);
+        bc[1] = edge_function(&vertices[2].screen_space_position,
+                              &vertices[0].screen_space_position, &p);
+        bc[2] = edge_function(&vertices[0].screen_space_position,
+                              &vertices[1].screen_space_position, &p);
+        masks[i] = 0;
+        if (is_in_scissor(px, py)) {
+            for (uint32_t s = 0; s < TEXTURE_SAMPLE_COUNT; s++) {
+                float sample_bc[3];
+                for (int k = 0; k < 3; k++) {
+                    sample_bc[k] = bc[k] + edge_offsets[s][k];
+                }
+                if (sample_bc[0] > 0.0f || sample_bc[1] > 0.0f ||
+                    sample_bc[2] > 0.0f) {
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) {
+                    sample_bc[k] *= inverse_area;
+                }
+                if (!sample_depth_test(px, py, s, vertices, sample_bc)) {
+                    masks[i] |= 1u << s;
+                }
+            }
+        }
+        bc[0] *= inverse_area;
+        bc[1] *= inverse_area;
+        bc[2] *= inverse_area;
+        has_visible_fragment |= masks[i] != 0;
+    }
+    if (!has_visible_fragment) {
+        return;
+    }
+
+    struct shader_context quad[4];
+    for (int i = 0; i < 4; i++) {
+        clear_shader_context(&quad[i]);
+        set_fragment_shader_input(&quad[i], vertices, barycentric[i]);
+        quad[i].quad = quad;
+        quad[i].quad_index = i;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (masks[i] == 0) {
+            continue;
+        }
+        vector4 fragment_color = fs(&quad[i], uniform);
+        uint32_t px = x + (i & 1);
+        uint32_t py = y + (i >> 1);
+        if (color_buffer != NULL) {
+            write_samples(get_pixel_index(px, py), masks[i], fragment_color);
+        }
+        if (motion_vector_buffer != NULL) {
+            if (previous_position_variable >= 0) {
+                vector3 previous =
+                    interpolate_previous_position(vertices, barycentric[i]);
+                write_motion_vector(px, py, &previous);
+            } else {
+                write_motion_vector(px, py, NULL);
+            }
+        }
+    }
+}
+
 // Using edge functions to raster triangles, refer to:
 // https://www.scratchapixel.com/lessons/3d-basic-rendering/rasterization-practical-implementation/rasterization-stage
 void draw_triangle(struct framebuffer *framebuffer, const void *uniform,
@@ -252,7 +645,17 @@ void draw_triangle(struct framebuffer *framebuffer, const void *uniform,
     if (vs == NULL || fs == NULL || framebuffer == NULL) {
         return;
     }
+    const void *fragment_uniform = uniform;
+    if (prepare != NULL) {
+        if (prepared_source != uniform) {
+            prepare_uniform(uniform);
+        }
+        fragment_uniform = prepared_uniform;
+    }
     parse_framebuffer(framebuffer);
+    if (scissor.right <= scissor.left || scissor.top <= scissor.bottom) {
+        return;
+    }
     struct vertex vertices[3];
     // The bounding box of the triangle.
     struct bounding_box bound = {{{FLT_MAX, FLT_MAX}}, {{FLT_MIN, FLT_MIN}}};
@@ -281,48 +684,59 @@ void draw_triangle(struct framebuffer *framebuffer, const void *uniform,
     }
     float inverse_area = 1 / area;
 
-    // Traverse find the pixels covered by the triangle. If found, compute the
-    // barycentric coordinates of the point in the triangle.
-    // No need to traverses pixels outside the screen.
-    uint32_t x_min = int32_clamp(floorf(bound.min.x), 0, framebuffer_width - 1);
-    uint32_t y_min =
-        int32_clamp(floorf(bound.min.y), 0, framebuffer_height - 1);
-    uint32_t x_max = int32_clamp(floorf(bound.max.x), 0, framebuffer_width - 1);
-    uint32_t y_max =
-        int32_clamp(floorf(bound.max.y), 0, framebuffer_height - 1);
-
-    for (uint32_t y = y_min; y <= y_max; y++) {
-        for (uint32_t x = x_min; x <= x_max; x++) {
-            vector2 p = (vector2){{x, y}};
-            // The barycentric coordinates of p.
-            float bc[3];
-            // Note that this is not the final barycentric coordinates.
-            bc[0] = edge_function(&vertices[1].screen_space_position,
-                                  &vertices[2].screen_space_position, &p);
-            bc[1] = edge_function(&vertices[2].screen_space_position,
-                                  &vertices[0].screen_space_position, &p);
-            bc[2] = edge_function(&vertices[0].screen_space_position,
-                                  &vertices[1].screen_space_position, &p);
-            if (bc[0] > 0.0f || bc[1] > 0.0f || bc[2] > 0.0f) {
-                // If any component of the barycentric coordinates is greater
-                // than 0, it means that the pixel is outside the triangle.
-                continue;
+    // The edge functions are linear, so they change by the same amounts from
+    // every pixel center to its samples.
+    float edge_offsets[TEXTURE_SAMPLE_COUNT][3];
+    // The samples of a pixel may be covered even if its center is outside the
+    // bounding box.
+    float margin = 0.0f;
+    if (sample_count > 1) {
+        for (int k = 0; k < 3; k++) {
+            const vector2 *a = &vertices[(k + 1) % 3].screen_space_position;
+            const vector2 *b = &vertices[(k + 2) % 3].screen_space_position;
+            for (uint32_t s = 0; s < TEXTURE_SAMPLE_COUNT; s++) {
+                edge_offsets[s][k] = sample_offsets[s].x * (b->y - a->y) -
+                                     sample_offsets[s].y * (b->x - a->x);
             }
-            // Calculate the barycentric coordinates of point p.
-            bc[0] *= inverse_area;
-            bc[1] *= inverse_area;
-            bc[2] *= inverse_area;
+        }
+        margin = MAX_SAMPLE_OFFSET;
+    }
 
-            if (depth_test(x, y, vertices, bc)) {
-                continue;
-            }
-            struct shader_context input;
-            clear_shader_context(&input);
-            set_fragment_shader_input(&input, vertices, bc);
-            vector4 fragment_color = fs(&input, uniform);
-            if (color_buffer != NULL) {
-                uint8_t *pixel = color_buffer + (y * framebuffer_width + x) * 4;
-                write_color(pixel, fragment_color);
+    // Traverse the pixels in the bounding box in 2x2 quads, so that the
+    // fragment shader can compute derivatives. Quads are aligned to even
+    // coordinates, so a quad is shaded the same whether the scissor rectangle
+    // cuts it or not. No need to traverses pixels outside the scissor
+    // rectangle, which lies within the screen.
+    if (bound.max.x + margin < (float)scissor.left ||
+        bound.min.x - margin >= (float)scissor.right ||
+        bound.max.y + margin < (float)scissor.bottom ||
+        bound.min.y - margin >= (float)scissor.top) {
+        return;
+    }
+    uint32_t x_min = int32_clamp(floorf(bound.min.x - margin), scissor.left,
+                                 scissor.right - 1);
+    uint32_t y_min = int32_clamp(floorf(bound.min.y - margin), scissor.bottom,
+                                 scissor.top - 1);
+    uint32_t x_max = int32_clamp(floorf(bound.max.x + margin), scissor.left,
+                                 scissor.right - 1);
+    uint32_t y_max = int32_clamp(floorf(bound.max.y + margin), scissor.bottom,
+                                 scissor.top - 1);
+    x_min &= ~1u;
+    y_min &= ~1u;
+    // The quads only touch pixels inside the clamped bounding box, or next to
+    // it in the same tile of the deferred clear.
+    for (int i = 0; i < 3; i++) {
+        flush_texture_clear(attachments[i], x_min, y_min, x_max - x_min + 1,
+                            y_max - y_min + 1);
+    }
+
+    for (uint32_t y = y_min; y <= y_max; y += 2) {
+        for (uint32_t x = x_min; x <= x_max; x += 2) {
+            if (sample_count > 1) {
+                draw_multisample_quad(x, y, vertices, inverse_area,
+                                      edge_offsets, fragment_uniform);
+            } else {
+                draw_quad(x, y, vertices, inverse_area, fragment_uniform);
             }
         }
     }
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include "graphics/framebuffer.h"
+#include "graphics/reprojection_cache.h"
 #include "graphics/shader_context.h"
 #include "graphics/texture.h"
 #include "math/vector.h"
@@ -47,11 +48,29 @@ typedef vector4 (*vertex_shader)(struct shader_context *output,
 /// The input stores the values assigned by the vertex shader, which are
 /// interpolated before being received by the fragment shader.
 ///
+/// Fragments are shaded in 2x2 quads, the screen space derivatives of the input
+/// can be obtained through shader_context_ddx_*() and shader_context_ddy_*()
+/// functions.
+///
 /// The fragment shader returns the color value.
 ///
 typedef vector4 (*fragment_shader)(struct shader_context *input,
                                    const void *uniform);
 
+// The size of the block that a uniform prepare function writes to, in bytes.
+#define MAX_PREPARED_UNIFORM_SIZE 1024
+
+///
+/// \brief Pointer to uniform prepare function.
+///
+/// A prepare function turns the uniform passed to draw_triangle() into a block
+/// of constants for the fragment shader, e.g. precomputes values that would
+/// otherwise be derived from the uniform for every fragment. The block is owned
+/// by the rasterizer, is MAX_PREPARED_UNIFORM_SIZE bytes large and aligned to a
+/// cache line.
+///
+typedef void (*uniform_prepare_function)(void *prepared, const void *uniform);
+
 ///
 /// \brief Set the viewport parameters.
 ///
@@ -69,6 +88,73 @@ void set_vertex_shader(vertex_shader shader);
 
 void set_fragment_shader(fragment_shader shader);
 
+///
+/// \brief Sets the function preparing the uniform of the fragment shader.
+///
+/// If prepare is not a null pointer, the fragment shader receives the block
+/// prepared by it instead of the uniform passed to draw_triangle(). The vertex
+/// shader always receives the uniform passed to draw_triangle().
+///
+/// The block is prepared when draw_triangle() is called with a uniform other
+/// than the one it was last prepared from, so drawing many triangles with the
+/// same uniform prepares it once. If the uniform is modified between draws,
+/// call prepare_uniform() to prepare the block again.
+///
+/// \param prepare The prepare function, null pointer to pass the uniform to the
+///                fragment shader as is.
+///
+void set_uniform_prepare(uniform_prepare_function prepare);
+
+///
+/// \brief Prepares the block of constants of the fragment shader from the
+///        uniform with the function set by set_uniform_prepare().
+///
+/// Does nothing if no prepare function is set or uniform is a null pointer.
+///
+/// \param uniform The uniform that will be passed to draw_triangle().
+///
+void prepare_uniform(const void *uniform);
+
+///
+/// \brief Sets the variable of the vertex shader output holding the clip space
+///        position of the vertex in the previous frame.
+///
+/// If the framebuffer has a motion vector buffer, the previous position is
+/// interpolated for each shaded pixel and mapped to screen space with the
+/// current viewport, and the motion from there to the pixel is written to the
+/// buffer. The previous position should be jittered like the current one, so
+/// that the motion only comes from the camera and the geometry.
+///
+/// \param index The index of the vector4 variable, -1 if the vertex shader
+///              does not output the previous position, the motion is then 0.
+///
+void set_previous_position_variable(int8_t index);
+
+///
+/// \brief Sets the reprojection cache the colors of the fragments are reused
+///        from and stored to.
+///
+/// With a cache, a fragment whose color is found by fetch_reprojected_color()
+/// is not shaded, and the color of every fragment written to the framebuffer
+/// is stored with store_shaded_color(). The previous position of a fragment is
+/// interpolated from the variable set by set_previous_position_variable(),
+/// without it the colors are only stored. The cache is not used with
+/// multisampled framebuffers.
+///
+/// \param cache Pointer to the cache, null pointer to shade every fragment.
+///
+void set_reprojection_cache(struct reprojection_cache *cache);
+
+///
+/// \brief Sets the ID of the object drawn, see set_reprojection_cache().
+///
+/// The cached colors are only reused by fragments of the same object. The ID
+/// is 1 by default.
+///
+/// \param id The ID of the object, from 1 to 2^24 - 1.
+///
+void set_object_id(uint32_t id);
+
 ///
 /// \brief Render triangle.
 ///
@@ -82,9 +168,10 @@ void set_fragment_shader(fragment_shader shader);
 ///
 /// Always assumes the shader's output is in linear RGB color space. So if the
 /// color buffer attached to the framebuffer is sRGB encoded, convert the output
-/// from linear RGB to sRGB. If there is no color buffer attached, the fragment
-/// color result is discarded. If the framebuffer is not attached with a depth
-/// buffer, the depth test is not performed.
+/// from linear RGB to sRGB. If the color buffer is a floating point format, the
+/// output is stored without clamping or conversion. If there is no color buffer
+/// attached, the fragment color result is discarded. If the framebuffer is not
+/// attached with a depth buffer, the depth test is not performed.
 ///
 /// \param framebuffer Buffer for saving rendering results.
 /// \param uniform Contains constants that can be accessed in the vertex shader
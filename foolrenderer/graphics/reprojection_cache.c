@@ -0,0 +1,156 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/reprojection_cache.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphics/color.h"
+#include "math/vector.h"
+
+// A color is reused while the position it was shaded at is within half a pixel
+// of the fragment. The offset is stored in 1/64 pixels.
+#define MAX_OFFSET 0.5f
+#define OFFSET_SCALE 64.0f
+
+struct cache_entry {
+    uint16_t color[4];
+    float depth;
+    // 0 if no fragment was stored at the pixel.
+    uint32_t object_id : 24;
+    // The number of frames the color may still be used, it is reused if more
+    // than 1.
+    uint32_t lifetime : 8;
+    // The position the color was shaded at, relative to the pixel center.
+    int8_t offset[2];
+};
+
+struct reprojection_cache {
+    uint32_t width;
+    uint32_t height;
+    float depth_tolerance;
+    uint32_t refresh_period;
+    // The entries of the last frame are read and the entries of the current
+    // frame are written, they swap at each frame.
+    struct cache_entry *previous;
+    struct cache_entry *current;
+};
+
+struct reprojection_cache *create_reprojection_cache(uint32_t width,
+                                                     uint32_t height,
+                                                     float depth_tolerance,
+                                                     uint32_t refresh_period) {
+    if (width == 0 || height == 0 || refresh_period == 0 ||
+        refresh_period > UINT8_MAX) {
+        return NULL;
+    }
+    struct reprojection_cache *cache =
+        malloc(sizeof(struct reprojection_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    size_t pixel_count = (size_t)width * height;
+    cache->width = width;
+    cache->height = height;
+    cache->depth_tolerance = depth_tolerance;
+    cache->refresh_period = refresh_period;
+    cache->previous = calloc(pixel_count, sizeof(struct cache_entry));
+    cache->current = calloc(pixel_count, sizeof(struct cache_entry));
+    if (cache->previous == NULL || cache->current == NULL) {
+        destroy_reprojection_cache(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void destroy_reprojection_cache(struct reprojection_cache *cache) {
+    if (cache != NULL) {
+        free(cache->previous);
+        free(cache->current);
+        free(cache);
+    }
+}
+
+void advance_reprojection_cache(struct reprojection_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    struct cache_entry *entries = cache->previous;
+    cache->previous = cache->current;
+    cache->current = entries;
+    // Only the object IDs tell whether an entry is stored.
+    size_t pixel_count = (size_t)cache->width * cache->height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        entries[i].object_id = 0;
+    }
+}
+
+void invalidate_reprojection_cache(struct reprojection_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    size_t pixel_count = (size_t)cache->width * cache->height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        cache->previous[i].object_id = 0;
+    }
+}
+
+bool fetch_reprojected_color(const struct reprojection_cache *cache,
+                             vector3 previous_position, uint32_t object_id,
+                             struct cached_color *color) {
+    // The pixel centers are at integer coordinates.
+    float previous_x = floorf(previous_position.x + 0.5f);
+    float previous_y = floorf(previous_position.y + 0.5f);
+    if (!(previous_x >= 0.0f && previous_x < (float)cache->width &&
+          previous_y >= 0.0f && previous_y < (float)cache->height)) {
+        return false;
+    }
+    const struct cache_entry *entry =
+        cache->previous +
+        ((size_t)previous_y * cache->width + (size_t)previous_x);
+    if (entry->object_id != object_id || entry->lifetime <= 1 ||
+        fabsf(entry->depth - previous_position.z) > cache->depth_tolerance) {
+        return false;
+    }
+    vector2 offset = {{previous_x - previous_position.x +
+                           (float)entry->offset[0] / OFFSET_SCALE,
+                       previous_y - previous_position.y +
+                           (float)entry->offset[1] / OFFSET_SCALE}};
+    if (fabsf(offset.x) > MAX_OFFSET || fabsf(offset.y) > MAX_OFFSET) {
+        return false;
+    }
+    color->color = (vector4){
+        {half_to_float(entry->color[0]), half_to_float(entry->color[1]),
+         half_to_float(entry->color[2]), half_to_float(entry->color[3])}};
+    color->offset = offset;
+    color->lifetime = entry->lifetime - 1;
+    return true;
+}
+
+void store_shaded_color(struct reprojection_cache *cache, uint32_t x,
+                        uint32_t y, float depth, uint32_t object_id,
+                        const struct cached_color *color) {
+    if (x >= cache->width || y >= cache->height) {
+        return;
+    }
+    struct cache_entry *entry = cache->current + ((size_t)y * cache->width + x);
+    for (int c = 0; c < 4; c++) {
+        entry->color[c] = float_to_half(color->color.elements[c]);
+    }
+    entry->depth = depth;
+    entry->object_id = object_id;
+    // The lifetimes of the colors just shaded are staggered along diagonal
+    // stripes, from 1 to the refresh period.
+    entry->lifetime = color->lifetime != 0
+                          ? color->lifetime
+                          : 1 + (x + y) % cache->refresh_period;
+    entry->offset[0] = (int8_t)lroundf(color->offset.x * OFFSET_SCALE);
+    entry->offset[1] = (int8_t)lroundf(color->offset.y * OFFSET_SCALE);
+}
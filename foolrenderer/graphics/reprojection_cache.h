@@ -0,0 +1,139 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_REPROJECTION_CACHE_H_
+#define FOOLRENDERER_GRAPHICS_REPROJECTION_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "math/vector.h"
+
+// A reprojection cache keeps the shaded color, the depth and the object ID of
+// every pixel of the last frame. When a fragment of the current frame is
+// projected into the last frame and lands on a pixel of the same object at the
+// same depth, it is the same surface seen again, and its color is reused
+// instead of running the fragment shader. Only the fragments of surfaces that
+// were occluded or outside the last frame are shaded. For the technique, refer
+// to:
+// https://gfx.cs.princeton.edu/pubs/Nehab_2007_ARS/NehEtAl07.pdf
+//
+// The reused colors ignore the changes of the view dependent shading and drift
+// by the rounding of the reprojection, so every color is only reused for a
+// limited number of frames before being shaded again. The lifetimes of the
+// colors are staggered, so that about the same number of them expire in each
+// frame. Changes of the lights or the materials require
+// invalidate_reprojection_cache().
+
+///
+/// \brief The shaded colors of the last frame and of the current frame.
+///
+struct reprojection_cache;
+
+///
+/// \brief Creates a cache for frames of the given size.
+///
+/// Fails if width, height or refresh_period is 0, or if refresh_period is
+/// greater than 255. Fails if memory allocation fails.
+///
+/// \param width The width of the frames.
+/// \param height The height of the frames.
+/// \param depth_tolerance The largest difference of the depths, in [0,1] like
+///                        the depth buffer, at which a cached color is reused.
+/// \param refresh_period The number of frames after which a color is shaded
+///                       again, even if it could be reused.
+/// \return Returns a pointer to the cache on success, null pointer on failure.
+///
+struct reprojection_cache *create_reprojection_cache(uint32_t width,
+                                                     uint32_t height,
+                                                     float depth_tolerance,
+                                                     uint32_t refresh_period);
+
+///
+/// \brief Releases the memory of the cache.
+///
+/// If cache is a null pointer, the function does nothing.
+///
+/// \param cache Pointer to the cache to destroy.
+///
+void destroy_reprojection_cache(struct reprojection_cache *cache);
+
+///
+/// \brief Starts a new frame.
+///
+/// The colors stored during the current frame become the colors of the last
+/// frame, and the current frame starts empty. Must be called before drawing
+/// each frame. If cache is a null pointer, the function does nothing.
+///
+/// \param cache Pointer to the cache.
+///
+void advance_reprojection_cache(struct reprojection_cache *cache);
+
+///
+/// \brief Discards the colors of the last frame, so that every fragment of the
+///        current frame is shaded.
+///
+/// If cache is a null pointer, the function does nothing.
+///
+/// \param cache Pointer to the cache.
+///
+void invalidate_reprojection_cache(struct reprojection_cache *cache);
+
+///
+/// \brief A color of the reprojection cache.
+///
+struct cached_color {
+    vector4 color;
+    // The position the color was shaded at, relative to the fragment, in
+    // pixels.
+    vector2 offset;
+    // The number of frames the color may still be used, 0 if it was just
+    // shaded.
+    uint32_t lifetime;
+};
+
+///
+/// \brief Looks up the color of a fragment in the last frame.
+///
+/// The fragment was at the previous position in the last frame, the x and y of
+/// which are in pixels and the z of which is the depth. The color is found if
+/// the nearest pixel to the previous position has the same object ID and a
+/// depth within the tolerance, and the color has not reached the end of its
+/// lifetime. The nearest pixel is up to half a pixel off, and this error adds
+/// up each time the color is reused, so the offset from the fragment to where
+/// the color was shaded is kept, and the color is not found if the offset
+/// exceeds half a pixel.
+///
+/// \param cache Pointer to the cache.
+/// \param previous_position The position of the fragment in the last frame.
+/// \param object_id The ID of the object drawn, from 1 to 2^24 - 1.
+/// \param color Receives the color if it is found, to be passed to
+///              store_shaded_color().
+/// \return Returns true if the color is found, false otherwise.
+///
+bool fetch_reprojected_color(const struct reprojection_cache *cache,
+                             vector3 previous_position, uint32_t object_id,
+                             struct cached_color *color);
+
+///
+/// \brief Stores the color of a fragment in the current frame.
+///
+/// Fragments drawn later at the same pixel replace it, like in the color
+/// buffer. Pixels outside the frame are ignored. A color just shaded has an
+/// offset and a lifetime of 0, the cache gives it a lifetime of up to the
+/// refresh period.
+///
+/// \param cache Pointer to the cache.
+/// \param x The x coordinate of the fragment.
+/// \param y The y coordinate of the fragment.
+/// \param depth The depth of the fragment.
+/// \param object_id The ID of the object drawn, from 1 to 2^24 - 1.
+/// \param color The color of the fragment.
+///
+void store_shaded_color(struct reprojection_cache *cache, uint32_t x,
+                        uint32_t y, float depth, uint32_t object_id,
+                        const struct cached_color *color);
+
+#endif  // FOOLRENDERER_GRAPHICS_REPROJECTION_CACHE_H_
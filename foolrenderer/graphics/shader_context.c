@@ -28,6 +28,22 @@
         return variables + index;                                 \
     } while (0)
 
+// The quad index of a fragment is (y_offset << 1) | x_offset, so the neighbor
+// in the x direction differs in bit 0 and the neighbor in the y direction
+// differs in bit 1.
+#define RETURN_DERIVATIVE(type, zero, max_variables, direction_bit)         \
+    do {                                                                    \
+        if (context->quad == NULL || index >= max_variables) {              \
+            return zero;                                                    \
+        }                                                                   \
+        const struct shader_context *low =                                  \
+            context->quad + (context->quad_index & ~(direction_bit));       \
+        const struct shader_context *high =                                 \
+            context->quad + (context->quad_index | (direction_bit));        \
+        return type##_subtract(high->type##_variables[index],               \
+                               low->type##_variables[index]);               \
+    } while (0)
+
 void clear_shader_context(struct shader_context *context) {
     for (int8_t i = 0; i < MAX_FLOAT_VARIABLES; i++) {
         context->float_allocations[i] = false;
@@ -45,6 +61,8 @@ void clear_shader_context(struct shader_context *context) {
     context->vector2_variable_count = 0;
     context->vector3_variable_count = 0;
     context->vector4_variable_count = 0;
+    context->quad = NULL;
+    context->quad_index = 0;
 }
 
 float *shader_context_float(struct shader_context *context, int8_t index) {
@@ -62,3 +80,13 @@ vector3 *shader_context_vector3(struct shader_context *context, int8_t index) {
 vector4 *shader_context_vector4(struct shader_context *context, int8_t index) {
     RETURN_VARIABLE(vector4, MAX_VECTOR4_VARIABLES);
 }
+
+vector2 shader_context_ddx_vector2(const struct shader_context *context,
+                                   int8_t index) {
+    RETURN_DERIVATIVE(vector2, VECTOR2_ZERO, MAX_VECTOR2_VARIABLES, 1);
+}
+
+vector2 shader_context_ddy_vector2(const struct shader_context *context,
+                                   int8_t index) {
+    RETURN_DERIVATIVE(vector2, VECTOR2_ZERO, MAX_VECTOR2_VARIABLES, 2);
+}
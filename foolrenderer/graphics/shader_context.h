@@ -24,6 +24,10 @@
 /// fragment shader is executed. The interpolation result can be used in the
 /// fragment shader.
 ///
+/// The rasterizer shades fragments in 2x2 blocks called quads. The contexts of
+/// the fragments in a quad are interpolated together, which allows the fragment
+/// shader to compute screen space derivatives of the variables.
+///
 /// IMPORTANT: Do not directly access the members of the structure in the
 /// shader. Instead, use shader_context_*() functions.
 ///
@@ -48,6 +52,12 @@ struct shader_context {
     int8_t vector2_variable_count;
     int8_t vector3_variable_count;
     int8_t vector4_variable_count;
+    // The contexts of the quad the fragment belongs to, ordered as bottom-left,
+    // bottom-right, top-left, top-right. The null pointer if the context does
+    // not belong to a quad, e.g. the output of vertex shaders.
+    const struct shader_context *quad;
+    // The index of this context in the quad.
+    int8_t quad_index;
 };
 
 ///
@@ -116,4 +126,35 @@ vector3 *shader_context_vector3(struct shader_context *context, int8_t index);
 ///
 vector4 *shader_context_vector4(struct shader_context *context, int8_t index);
 
+///
+/// \brief Gets the partial derivative of the vector2 variable with the
+///        specified index with respect to screen space x.
+///
+/// The derivative is the difference of the variable between the two
+/// horizontally adjacent fragments in the quad. Can only be used in the
+/// fragment shader.
+///
+/// \param context The shader context object.
+/// \param index The variable index, range from 0 to MAX_VECTOR2_VARIABLES-1.
+/// \return Returns the derivative. Returns zero vector if the context does not
+///         belong to a quad or index is out of range.
+///
+vector2 shader_context_ddx_vector2(const struct shader_context *context,
+                                   int8_t index);
+
+///
+/// \brief Gets the partial derivative of the vector2 variable with the
+///        specified index with respect to screen space y.
+///
+/// The derivative is the difference of the variable between the two vertically
+/// adjacent fragments in the quad. Can only be used in the fragment shader.
+///
+/// \param context The shader context object.
+/// \param index The variable index, range from 0 to MAX_VECTOR2_VARIABLES-1.
+/// \return Returns the derivative. Returns zero vector if the context does not
+///         belong to a quad or index is out of range.
+///
+vector2 shader_context_ddy_vector2(const struct shader_context *context,
+                                   int8_t index);
+
 #endif  // FOOLRENDERER_GRAPHICS_SHADER_CONTEXT_H_
@@ -0,0 +1,194 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/temporal_anti_aliasing.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphics/color.h"
+#include "graphics/texture.h"
+#include "math/math_utility.h"
+#include "math/vector.h"
+
+static bool is_supported(const struct texture *texture, uint32_t width,
+                         uint32_t height) {
+    return get_texture_format(texture) == TEXTURE_FORMAT_RGBA16F &&
+           get_texture_width(texture) == width &&
+           get_texture_height(texture) == height;
+}
+
+// Finds the pixel at (x, y) of a texture read in place, in its own layout. The
+// pixels of the tiles a deferred clear has not written yet are read from the
+// clear, see get_texture_clear_texel().
+static inline const uint16_t *locate_pixel(const struct texture *texture,
+                                           const uint16_t *pixels, uint32_t x,
+                                           uint32_t y) {
+    const uint16_t *clear_texel = get_texture_clear_texel(texture, x, y);
+    if (clear_texel != NULL) {
+        return clear_texel;
+    }
+    uint32_t width = get_texture_width(texture);
+    size_t index = get_texture_layout(texture) == TEXTURE_LAYOUT_TILED
+                       ? get_tiled_texel_index(width, x, y)
+                       : (size_t)y * width + x;
+    return pixels + index * 4;
+}
+
+static inline vector4 load_pixel(const struct texture *texture,
+                                 const uint16_t *pixels, uint32_t x,
+                                 uint32_t y) {
+    const uint16_t *pixel = locate_pixel(texture, pixels, x, y);
+    return (vector4){{half_to_float(pixel[0]), half_to_float(pixel[1]),
+                      half_to_float(pixel[2]), half_to_float(pixel[3])}};
+}
+
+// Reads the history at (x, y) with bilinear filtering, the pixel centers are at
+// integer coordinates. Pixels beyond the edges are read as the nearest edge
+// pixel.
+static vector4 sample_history(const struct texture *texture,
+                              const uint16_t *pixels, float x, float y) {
+    uint32_t width = get_texture_width(texture);
+    uint32_t height = get_texture_height(texture);
+    float floor_x = floorf(x);
+    float floor_y = floorf(y);
+    float tx = x - floor_x;
+    float ty = y - floor_y;
+    int32_t x0 = (int32_t)floor_x;
+    int32_t y0 = (int32_t)floor_y;
+    uint32_t x1 = (uint32_t)int32_clamp(x0 + 1, 0, (int32_t)width - 1);
+    uint32_t y1 = (uint32_t)int32_clamp(y0 + 1, 0, (int32_t)height - 1);
+    x0 = int32_clamp(x0, 0, (int32_t)width - 1);
+    y0 = int32_clamp(y0, 0, (int32_t)height - 1);
+    vector4 bottom = vector4_lerp(
+        load_pixel(texture, pixels, (uint32_t)x0, (uint32_t)y0),
+        load_pixel(texture, pixels, x1, (uint32_t)y0), tx);
+    vector4 top = vector4_lerp(load_pixel(texture, pixels, (uint32_t)x0, y1),
+                               load_pixel(texture, pixels, x1, y1), tx);
+    return vector4_lerp(bottom, top, ty);
+}
+
+static void decode_row(vector4 *row, const struct texture *texture,
+                       const uint16_t *pixels, uint32_t y) {
+    uint32_t width = get_texture_width(texture);
+    for (uint32_t x = 0; x < width; x++) {
+        row[x] = load_pixel(texture, pixels, x, y);
+    }
+}
+
+static inline void store_pixel(uint16_t *pixels, uint32_t width, uint32_t x,
+                               uint32_t y, vector4 color) {
+    uint16_t *pixel = pixels + ((size_t)y * width + x) * 4;
+    for (int c = 0; c < 4; c++) {
+        pixel[c] = float_to_half(color.elements[c]);
+    }
+}
+
+bool apply_temporal_anti_aliasing(struct texture *target,
+                                  const struct texture *current,
+                                  const struct texture *history,
+                                  const struct texture *motion_vectors,
+                                  float current_weight) {
+    if (target == NULL || current == NULL || target == current ||
+        target == history) {
+        return false;
+    }
+    uint32_t width = get_texture_width(current);
+    uint32_t height = get_texture_height(current);
+    if (!is_supported(target, width, height) ||
+        get_texture_layout(target) != TEXTURE_LAYOUT_LINEAR ||
+        !is_supported(current, width, height) ||
+        (history != NULL && !is_supported(history, width, height)) ||
+        (motion_vectors != NULL &&
+         !is_supported(motion_vectors, width, height))) {
+        return false;
+    }
+    // The target is linear, so get_texture_pixels() returns its storage. The
+    // other textures are only read, in place and in their own layouts.
+    uint16_t *output = get_texture_pixels(target);
+    const uint16_t *input = get_texture_storage_const(current);
+    if (history == NULL) {
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                memcpy(output + ((size_t)y * width + x) * 4,
+                       locate_pixel(current, input, x, y),
+                       4 * sizeof(uint16_t));
+            }
+        }
+        return true;
+    }
+    const uint16_t *previous = get_texture_storage_const(history);
+    const uint16_t *motion = motion_vectors == NULL
+                                 ? NULL
+                                 : get_texture_storage_const(motion_vectors);
+    // The neighborhood of a pixel reads 9 pixels of the current frame, so the
+    // rows around the pixel are decoded once into the buffer, which holds
+    // the rows y - 1, y and y + 1 at the indices (y - 1) % 3, y % 3 and
+    // (y + 1) % 3. Each pixel only reads the inputs, so bands of rows may be
+    // processed in parallel, each with its own buffer.
+    vector4 *rows = malloc(sizeof(vector4) * width * 3);
+    if (rows == NULL) {
+        return false;
+    }
+    decode_row(rows, current, input, 0);
+    for (uint32_t y = 0; y < height; y++) {
+        if (y + 1 < height) {
+            decode_row(rows + (size_t)((y + 1) % 3) * width, current, input,
+                       y + 1);
+        }
+        const vector4 *row = rows + (size_t)(y % 3) * width;
+        const vector4 *row_below =
+            y == 0 ? row : rows + (size_t)((y + 2) % 3) * width;
+        const vector4 *row_above =
+            y + 1 == height ? row : rows + (size_t)((y + 1) % 3) * width;
+        for (uint32_t x = 0; x < width; x++) {
+            vector4 color = row[x];
+            float previous_x = (float)x;
+            float previous_y = (float)y;
+            if (motion != NULL) {
+                const uint16_t *vector =
+                    locate_pixel(motion_vectors, motion, x, y);
+                previous_x -= half_to_float(vector[0]);
+                previous_y -= half_to_float(vector[1]);
+            }
+            if (previous_x < -0.5f || previous_x > (float)width - 0.5f ||
+                previous_y < -0.5f || previous_y > (float)height - 0.5f) {
+                store_pixel(output, width, x, y, color);
+                continue;
+            }
+            vector4 minimum = color;
+            vector4 maximum = color;
+            uint32_t x_min = x == 0 ? 0 : x - 1;
+            uint32_t x_max = x == width - 1 ? x : x + 1;
+            const vector4 *neighborhood[3] = {row_below, row, row_above};
+            for (int r = 0; r < 3; r++) {
+                for (uint32_t nx = x_min; nx <= x_max; nx++) {
+                    vector4 neighbor = neighborhood[r][nx];
+                    for (int c = 0; c < 4; c++) {
+                        minimum.elements[c] = float_min(minimum.elements[c],
+                                                        neighbor.elements[c]);
+                        maximum.elements[c] = float_max(maximum.elements[c],
+                                                        neighbor.elements[c]);
+                    }
+                }
+            }
+            vector4 accumulated =
+                sample_history(history, previous, previous_x, previous_y);
+            for (int c = 0; c < 4; c++) {
+                accumulated.elements[c] =
+                    float_clamp(accumulated.elements[c], minimum.elements[c],
+                                maximum.elements[c]);
+            }
+            store_pixel(output, width, x, y,
+                        vector4_lerp(accumulated, color, current_weight));
+        }
+    }
+    free(rows);
+    return true;
+}
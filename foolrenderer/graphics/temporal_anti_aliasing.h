@@ -0,0 +1,58 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_TEMPORAL_ANTI_ALIASING_H_
+#define FOOLRENDERER_GRAPHICS_TEMPORAL_ANTI_ALIASING_H_
+
+#include <stdbool.h>
+
+#include "graphics/texture.h"
+
+// Temporal anti-aliasing spreads the samples of a pixel over frames instead of
+// taking them all in one frame. Each frame is rendered with the projection
+// offset by a different subpixel jitter, and blended into a history of the
+// previous frames. The history is reprojected with the motion vectors of the
+// frame, and clamped to the colors around each pixel in the frame, which
+// rejects the history of surfaces that were occluded or have changed. For the
+// technique, refer to:
+// https://de45xmedrsdbp.cloudfront.net/Resources/files/TemporalAA_small-59732822.pdf
+
+///
+/// \brief Blends the current frame into the history of the previous frames.
+///
+/// For each pixel, the history is read at the position of the pixel in the
+/// previous frame, which is the pixel minus its motion vector, with bilinear
+/// filtering. The history is clamped to the minimum and maximum of the current
+/// colors in the 3x3 neighborhood of the pixel, then blended with the current
+/// color by current_weight. Pixels whose previous position is outside the image
+/// get the current color.
+///
+/// All the textures must be TEXTURE_FORMAT_RGBA16F and of the same size. The
+/// target must be in TEXTURE_LAYOUT_LINEAR, the other textures may also be in
+/// TEXTURE_LAYOUT_TILED. The motion vectors are in the R and G components of
+/// motion_vectors, in pixels, as written by the rasterizer to a
+/// MOTION_VECTOR_ATTACHMENT.
+///
+/// Fails if target or current is a null pointer. Fails if the format, the
+/// layout or the size of any texture is not supported. Fails if target is the
+/// same texture as current or history. Fails if memory allocation fails.
+///
+/// \param target The texture to write the new history to.
+/// \param current The frame rendered with the jitter of this frame.
+/// \param history The history of the previous frames, may be a null pointer,
+///                then the current frame is copied to the target.
+/// \param motion_vectors The motion vectors of the current frame, may be a null
+///                       pointer, then there is no motion.
+/// \param current_weight The weight of the current frame in the blend, in
+///                       (0,1]. Smaller weights accumulate more frames.
+/// \return Returns true on success, false on failure.
+///
+bool apply_temporal_anti_aliasing(struct texture *target,
+                                  const struct texture *current,
+                                  const struct texture *history,
+                                  const struct texture *motion_vectors,
+                                  float current_weight);
+
+#endif  // FOOLRENDERER_GRAPHICS_TEMPORAL_ANTI_ALIASING_H_
@@ -5,22 +5,125 @@
 
 #include "graphics/texture.h"
 
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "graphics/block_compression.h"
 #include "graphics/color.h"
 #include "math/math_utility.h"
 #include "math/vector.h"
 
-struct texture {
-    enum texture_format format;
+extern size_t get_tiled_texel_index(uint32_t width, uint32_t x, uint32_t y);
+
+// The size of a texture is at most 2^32-1, so it can have up to 32 levels.
+#define MAX_TEXTURE_LEVELS 32
+// The width and height of a tile in TEXTURE_LAYOUT_TILED, in texels.
+#define TILE_SIZE TEXTURE_TILE_SIZE
+// The width and height of a page of a virtual texture, in texels.
+#define PAGE_SIZE 64
+// The width and height of a tile of a deferred clear, in texels.
+#define CLEAR_TILE_SIZE TEXTURE_CLEAR_TILE_SIZE
+
+struct texture_level {
     uint32_t width, height;
     void *pixels;
 };
 
+// A slot of the page cache of a virtual texture.
+struct page_slot {
+    // The index of the page held by the slot, UINT32_MAX if the slot is empty.
+    uint32_t page_index;
+    // The value of the clock when the page was last used.
+    uint64_t last_used;
+};
+
+struct texture_pages {
+    struct texture_page_source source;
+    size_t page_size;
+    uint32_t page_count;
+    // The index of the first page of each level, and the number of pages in a
+    // row of each level.
+    uint32_t first_pages[MAX_TEXTURE_LEVELS];
+    uint32_t pages_per_row[MAX_TEXTURE_LEVELS];
+    // The slot holding each page, or -1 if the page is not in memory.
+    int32_t *page_slots;
+    // Whether each page has been sampled since the feedback was cleared.
+    bool *touched_pages;
+    uint32_t slot_count;
+    struct page_slot *slots;
+    // The pixels of all slots, each slot takes page_size bytes.
+    uint8_t *cache;
+    // Incremented on every page access, used to find the least recently used
+    // page.
+    uint64_t clock;
+};
+
+// The min/max pyramid of a depth texture. Level i covers 2^i x 2^i texels of
+// the base level, the last row and column of a level may cover fewer texels.
+// The levels are rounded up in size so that every base texel is covered.
+struct depth_bounds {
+    // False if the depth texture has been modified since the pyramid was
+    // generated.
+    bool is_valid;
+    uint32_t level_count;
+    uint32_t widths[MAX_TEXTURE_LEVELS];
+    uint32_t heights[MAX_TEXTURE_LEVELS];
+    // The minimum and maximum depth of each texel of each level. Level 0 is
+    // not stored, all other levels are in a single block of memory pointed to
+    // by level 1.
+    float (*bounds[MAX_TEXTURE_LEVELS])[2];
+};
+
+// The deferred clear of the base level, see clear_texture(). The base level is
+// divided into tiles of CLEAR_TILE_SIZE x CLEAR_TILE_SIZE texels, the last row
+// and column of tiles may cover fewer texels.
+struct pending_clear {
+    // One sample in the format of the texture, the pending tiles are cleared
+    // to it.
+    uint8_t value[8];
+    // The value expanded to a texel in storage, every sample set to the value
+    // and the padding bytes to 0xFF. Read in place of the stale texels of the
+    // pending tiles. For TEXTURE_FORMAT_RGBA16F_4X, only the sample of plane 0.
+    uint8_t texel[8 * TEXTURE_SAMPLE_COUNT + 1];
+    uint32_t tiles_per_row, tiles_per_column;
+    // The number of pending tiles, the flags are not looked up if it is 0.
+    uint32_t pending_count;
+    // Whether each tile is yet to be written with the value, row by row
+    // starting from the bottom row.
+    bool is_pending[];
+};
+
+struct texture {
+    enum texture_format format;
+    enum texture_filter filter;
+    enum texture_layout layout;
+    // The size of a texel in storage, may be larger than the pixel size of
+    // the format because of padding.
+    size_t texel_size;
+    // Linear copy of the base level returned by get_texture_pixels() when the
+    // layout is not linear.
+    void *readback_pixels;
+    uint32_t level_count;
+    // The level 0 is the base level, its pixels are allocated separately. The
+    // pixels of all other levels are in a single block of memory pointed to by
+    // level 1. The pixels of all levels of a virtual texture are null pointers.
+    struct texture_level levels[MAX_TEXTURE_LEVELS];
+    // Releases the pixels of the base level when they are replaced or when the
+    // texture is destroyed, null pointer if the texture does not own them.
+    texture_buffer_free_function free_base_pixels;
+    void *free_base_user_data;
+    // The pages of a virtual texture, null pointer for ordinary textures.
+    struct texture_pages *pages;
+    // Built by generate_texture_depth_bounds(), null pointer until then.
+    struct depth_bounds *depth_bounds;
+    // Allocated by clear_texture(), null pointer until then.
+    struct pending_clear *pending_clear;
+};
+
 static size_t get_pixel_size(enum texture_format format) {
     size_t pixel_size;
     switch (format) {
@@ -33,11 +136,22 @@ static size_t get_pixel_size(enum texture_format format) {
             break;
         case TEXTURE_FORMAT_RGBA8:
         case TEXTURE_FORMAT_SRGB8_A8:
+        case TEXTURE_FORMAT_R11G11B10F:
             pixel_size = 4;
             break;
         case TEXTURE_FORMAT_DEPTH_FLOAT:
             pixel_size = sizeof(float);
             break;
+        case TEXTURE_FORMAT_RGBA16F:
+            pixel_size = 8;
+            break;
+        case TEXTURE_FORMAT_RGBA16F_4X:
+            // The samples and the compression flag.
+            pixel_size = 8 * TEXTURE_SAMPLE_COUNT + 1;
+            break;
+        case TEXTURE_FORMAT_DEPTH_FLOAT_4X:
+            pixel_size = sizeof(float) * TEXTURE_SAMPLE_COUNT;
+            break;
         default:
             pixel_size = 0;
             break;
@@ -45,120 +159,2209 @@ static size_t get_pixel_size(enum texture_format format) {
     return pixel_size;
 }
 
+// Gets the number of bytes of a 4x4 block for block compressed formats. Returns
+// 0 for other formats.
+static size_t get_block_size(enum texture_format format) {
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+        case TEXTURE_FORMAT_BC1_SRGB:
+            return BC1_BLOCK_SIZE;
+        case TEXTURE_FORMAT_BC4:
+            return BC4_BLOCK_SIZE;
+        case TEXTURE_FORMAT_BC5:
+            return BC4_BLOCK_SIZE * 2;
+        default:
+            return 0;
+    }
+}
+
+static inline bool is_multisample_format(enum texture_format format) {
+    return format == TEXTURE_FORMAT_RGBA16F_4X ||
+           format == TEXTURE_FORMAT_DEPTH_FLOAT_4X;
+}
+
 static inline bool is_srgb_encoding(enum texture_format format) {
-    if (format == TEXTURE_FORMAT_SRGB8 || format == TEXTURE_FORMAT_SRGB8_A8) {
+    if (format == TEXTURE_FORMAT_SRGB8 || format == TEXTURE_FORMAT_SRGB8_A8 ||
+        format == TEXTURE_FORMAT_BC1_SRGB) {
         return true;
     }
     return false;
 }
 
-struct texture *create_texture(enum texture_format internal_format,
-                               uint32_t width, uint32_t height) {
+static inline uint8_t round_float_to_uint8(float value) {
+    return value * 0xFF + 0.5f;
+}
+
+static inline size_t get_texel_size(enum texture_format format,
+                                    enum texture_layout layout) {
+    size_t pixel_size = get_pixel_size(format);
+    // Pad 3 bytes texels to 4 bytes, so that a tile fits exactly into a 64
+    // bytes cache line and texels are aligned.
+    if (layout == TEXTURE_LAYOUT_TILED && pixel_size == 3) {
+        return 4;
+    }
+    return pixel_size;
+}
+
+// Gets the index of the texel at (x, y) in the storage of the level.
+static inline size_t get_texel_index(enum texture_layout layout,
+                                     const struct texture_level *level,
+                                     uint32_t x, uint32_t y) {
+    if (layout == TEXTURE_LAYOUT_LINEAR) {
+        return (size_t)x + (size_t)y * level->width;
+    }
+    return get_tiled_texel_index(level->width, x, y);
+}
+
+// Gets the number of bytes required to store the level. Tiled levels are padded
+// to a whole number of tiles.
+static inline size_t get_level_storage_size(enum texture_layout layout,
+                                            size_t texel_size, uint32_t width,
+                                            uint32_t height) {
+    if (layout == TEXTURE_LAYOUT_TILED) {
+        width = (width + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+        height = (height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+    }
+    return (size_t)width * height * texel_size;
+}
+
+// Gets the number of bytes required to store a level of the texture, using the
+// current format and layout of the texture. A block of a block compressed
+// format takes the place of a tile.
+static inline size_t get_texture_level_size(const struct texture *texture,
+                                            uint32_t width, uint32_t height) {
+    size_t block_size = get_block_size(texture->format);
+    if (block_size != 0) {
+        size_t blocks_per_row = (width + TILE_SIZE - 1) / TILE_SIZE;
+        size_t blocks_per_column = (height + TILE_SIZE - 1) / TILE_SIZE;
+        return blocks_per_row * blocks_per_column * block_size;
+    }
+    return get_level_storage_size(texture->layout, texture->texel_size, width,
+                                  height);
+}
+
+// Copies the texels of a level between two layouts. Only the pixel_size bytes
+// of each texel are copied, padding bytes of the target are set to 0xFF.
+static void copy_level(uint8_t *target, enum texture_layout target_layout,
+                       size_t target_texel_size, const uint8_t *source,
+                       enum texture_layout source_layout,
+                       size_t source_texel_size, size_t pixel_size,
+                       const struct texture_level *level) {
+    if (target_texel_size == pixel_size && source_texel_size == pixel_size) {
+        // Without padding, the texels of a row of a tile are next to each
+        // other in both layouts, so they are copied together.
+        for (uint32_t y = 0; y < level->height; y++) {
+            for (uint32_t x = 0; x < level->width; x += TILE_SIZE) {
+                size_t count = uint32_min(TILE_SIZE, level->width - x);
+                memcpy(target + get_texel_index(target_layout, level, x, y) *
+                                    pixel_size,
+                       source + get_texel_index(source_layout, level, x, y) *
+                                    pixel_size,
+                       count * pixel_size);
+            }
+        }
+        return;
+    }
+    for (uint32_t y = 0; y < level->height; y++) {
+        for (uint32_t x = 0; x < level->width; x++) {
+            uint8_t *target_texel =
+                target +
+                get_texel_index(target_layout, level, x, y) * target_texel_size;
+            const uint8_t *source_texel =
+                source +
+                get_texel_index(source_layout, level, x, y) * source_texel_size;
+            memcpy(target_texel, source_texel, pixel_size);
+            for (size_t i = pixel_size; i < target_texel_size; i++) {
+                target_texel[i] = 0xFF;
+            }
+        }
+    }
+}
+
+// Updates the texels from (min_x, min_y) to (max_x, max_y) inclusive of the
+// next level of the mipmap chain, by averaging each 2x2 block of texels of the
+// source level. If the size of the source level is odd, the last row or column
+// is reused.
+static void downsample_level_region(const struct texture *texture,
+                                    struct texture_level *target,
+                                    const struct texture_level *source,
+                                    uint32_t min_x, uint32_t min_y,
+                                    uint32_t max_x, uint32_t max_y) {
+    enum texture_layout layout = texture->layout;
+    size_t texel_size = texture->texel_size;
+    size_t pixel_size = get_pixel_size(texture->format);
+    bool is_srgb = is_srgb_encoding(texture->format);
+    const uint8_t *source_pixels = source->pixels;
+    uint8_t *target_pixels = target->pixels;
+    for (uint32_t y = min_y; y <= max_y; y++) {
+        uint32_t y0 = y * 2;
+        uint32_t y1 = uint32_min(y0 + 1, source->height - 1);
+        for (uint32_t x = min_x; x <= max_x; x++) {
+            uint32_t x0 = x * 2;
+            uint32_t x1 = uint32_min(x0 + 1, source->width - 1);
+            const uint8_t *block[4] = {
+                source_pixels +
+                    get_texel_index(layout, source, x0, y0) * texel_size,
+                source_pixels +
+                    get_texel_index(layout, source, x1, y0) * texel_size,
+                source_pixels +
+                    get_texel_index(layout, source, x0, y1) * texel_size,
+                source_pixels +
+                    get_texel_index(layout, source, x1, y1) * texel_size};
+            uint8_t *pixel =
+                target_pixels + get_texel_index(layout, target, x, y) *
+                                    texel_size;
+            for (size_t i = 0; i < pixel_size; i++) {
+                // The alpha component is always linear.
+                bool is_linear = !is_srgb || i == 3;
+                float sum = 0.0f;
+                for (int b = 0; b < 4; b++) {
+                    uint8_t value = block[b][i];
+                    sum += is_linear ? uint8_to_float(value)
+                                     : srgb8_to_linear(value);
+                }
+                float average = sum * 0.25f;
+                if (!is_linear) {
+                    average = convert_to_srgb_color(average);
+                }
+                pixel[i] = round_float_to_uint8(average);
+            }
+            for (size_t i = pixel_size; i < texel_size; i++) {
+                pixel[i] = 0xFF;
+            }
+        }
+    }
+}
+
+// Creates the next level of the mipmap chain from the source level.
+static inline void downsample_level(const struct texture *texture,
+                                    struct texture_level *target,
+                                    const struct texture_level *source) {
+    downsample_level_region(texture, target, source, 0, 0, target->width - 1,
+                            target->height - 1);
+}
+
+static inline uint32_t get_page_count_in_line(uint32_t texel_count) {
+    return (texel_count + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+// Gets the number of bytes of a page, pages are always stored in the tiled
+// layout.
+static size_t get_page_size(enum texture_format format) {
+    size_t block_size = get_block_size(format);
+    if (block_size != 0) {
+        return (PAGE_SIZE / TILE_SIZE) * (PAGE_SIZE / TILE_SIZE) * block_size;
+    }
+    return get_level_storage_size(TEXTURE_LAYOUT_TILED,
+                                  get_texel_size(format, TEXTURE_LAYOUT_TILED),
+                                  PAGE_SIZE, PAGE_SIZE);
+}
+
+static void destroy_pages(struct texture_pages *pages) {
+    if (pages->source.release != NULL) {
+        pages->source.release(pages->source.user_data);
+    }
+    free(pages->page_slots);
+    free(pages->touched_pages);
+    free(pages->slots);
+    free(pages->cache);
+    free(pages);
+}
+
+// Loads the page into the least recently used slot of the cache. Returns the
+// index of the slot, or -1 if the page cannot be loaded.
+static int32_t load_page(struct texture_pages *pages, uint32_t page_index) {
+    uint32_t slot_index = 0;
+    for (uint32_t i = 1; i < pages->slot_count; i++) {
+        if (pages->slots[i].last_used < pages->slots[slot_index].last_used) {
+            slot_index = i;
+        }
+    }
+    struct page_slot *slot = &pages->slots[slot_index];
+    if (slot->page_index != UINT32_MAX) {
+        // Evict the page.
+        pages->page_slots[slot->page_index] = -1;
+    }
+    uint8_t *pixels = pages->cache + slot_index * pages->page_size;
+    if (!pages->source.load_page(pages->source.user_data, page_index, pixels,
+                                 pages->page_size)) {
+        slot->page_index = UINT32_MAX;
+        slot->last_used = 0;
+        return -1;
+    }
+    slot->page_index = page_index;
+    pages->page_slots[page_index] = (int32_t)slot_index;
+    return (int32_t)slot_index;
+}
+
+// Gets the pixels of a page of a virtual texture, loads the page if it is not
+// in memory. Returns a null pointer if the page cannot be loaded.
+static uint8_t *get_page_pixels(struct texture_pages *pages, uint32_t level,
+                                uint32_t page_x, uint32_t page_y) {
+    uint32_t page_index = pages->first_pages[level] +
+                          page_y * pages->pages_per_row[level] + page_x;
+    pages->touched_pages[page_index] = true;
+    int32_t slot_index = pages->page_slots[page_index];
+    if (slot_index < 0) {
+        slot_index = load_page(pages, page_index);
+        if (slot_index < 0) {
+            return NULL;
+        }
+    }
+    pages->slots[slot_index].last_used = ++pages->clock;
+    return pages->cache + slot_index * pages->page_size;
+}
+
+static void free_mipmaps(struct texture *texture) {
+    if (texture->level_count > 1) {
+        free(texture->levels[1].pixels);
+    }
+    texture->level_count = 1;
+}
+
+static struct depth_bounds *allocate_depth_bounds(struct texture *texture);
+
+// Marks the depth bounds as out of date, called whenever the base level may
+// have been modified.
+static inline void invalidate_depth_bounds(struct texture *texture) {
+    if (texture->depth_bounds != NULL) {
+        texture->depth_bounds->is_valid = false;
+    }
+}
+
+static void free_depth_bounds(struct texture *texture) {
+    if (texture->depth_bounds != NULL) {
+        free(texture->depth_bounds->bounds[1]);
+        free(texture->depth_bounds);
+        texture->depth_bounds = NULL;
+    }
+}
+
+// Gets the number of bytes of a sample, which is the pixel size for formats
+// with a single sample.
+static inline size_t get_sample_size(enum texture_format format) {
+    switch (format) {
+        case TEXTURE_FORMAT_RGBA16F_4X:
+            return 8;
+        case TEXTURE_FORMAT_DEPTH_FLOAT_4X:
+            return sizeof(float);
+        default:
+            return get_pixel_size(format);
+    }
+}
+
+// Writes the sample value to every sample of the texels from (left, bottom)
+// inclusive to (right, top) exclusive of the base level.
+static void fill_base_level(struct texture *texture, uint32_t left,
+                            uint32_t bottom, uint32_t right, uint32_t top,
+                            const uint8_t *value) {
+    const struct texture_level *base = &texture->levels[0];
+    uint8_t *pixels = base->pixels;
+    size_t sample_size = get_sample_size(texture->format);
+    if (texture->format == TEXTURE_FORMAT_RGBA16F_4X) {
+        // Only plane 0 is written, the pixels are marked compressed.
+        // Multisampled textures are always in the linear layout.
+        size_t plane_size = (size_t)base->width * base->height * sample_size;
+        uint8_t *is_compressed = pixels + plane_size * TEXTURE_SAMPLE_COUNT;
+        for (uint32_t y = bottom; y < top; y++) {
+            size_t first = (size_t)y * base->width + left;
+            for (size_t i = first; i < first + (right - left); i++) {
+                memcpy(pixels + i * sample_size, value, sample_size);
+            }
+            memset(is_compressed + first, 1, right - left);
+        }
+        return;
+    }
+    size_t pixel_size = get_pixel_size(texture->format);
+    size_t texel_size = texture->texel_size;
+    for (uint32_t y = bottom; y < top; y++) {
+        for (uint32_t x = left; x < right; x++) {
+            uint8_t *texel =
+                pixels +
+                get_texel_index(texture->layout, base, x, y) * texel_size;
+            for (size_t offset = 0; offset < pixel_size;
+                 offset += sample_size) {
+                memcpy(texel + offset, value, sample_size);
+            }
+            for (size_t i = pixel_size; i < texel_size; i++) {
+                texel[i] = 0xFF;
+            }
+        }
+    }
+}
+
+// Writes the clear value into the pending tiles overlapping the texels from
+// (left, bottom) inclusive to (right, top) exclusive, which must not be empty.
+static void write_pending_tiles(struct texture *texture, uint32_t left,
+                                uint32_t bottom, uint32_t right,
+                                uint32_t top) {
+    struct pending_clear *clear = texture->pending_clear;
+    if (clear == NULL || clear->pending_count == 0) {
+        return;
+    }
+    const struct texture_level *base = &texture->levels[0];
+    uint32_t last_column = (right - 1) / CLEAR_TILE_SIZE;
+    uint32_t last_row = (top - 1) / CLEAR_TILE_SIZE;
+    for (uint32_t ty = bottom / CLEAR_TILE_SIZE; ty <= last_row; ty++) {
+        for (uint32_t tx = left / CLEAR_TILE_SIZE; tx <= last_column; tx++) {
+            bool *is_pending =
+                &clear->is_pending[(size_t)ty * clear->tiles_per_row + tx];
+            if (!*is_pending) {
+                continue;
+            }
+            *is_pending = false;
+            clear->pending_count--;
+            fill_base_level(
+                texture, tx * CLEAR_TILE_SIZE, ty * CLEAR_TILE_SIZE,
+                uint32_min((tx + 1) * CLEAR_TILE_SIZE, base->width),
+                uint32_min((ty + 1) * CLEAR_TILE_SIZE, base->height),
+                clear->value);
+        }
+    }
+}
+
+// Writes all pending tiles, called before the base level is accessed.
+static inline void write_pending_clear(struct texture *texture) {
+    if (texture->pending_clear != NULL) {
+        const struct texture_level *base = &texture->levels[0];
+        write_pending_tiles(texture, 0, 0, base->width, base->height);
+    }
+}
+
+// Drops the pending tiles without writing them, called when the whole base
+// level is about to be overwritten.
+static inline void discard_pending_clear(struct texture *texture) {
+    struct pending_clear *clear = texture->pending_clear;
+    if (clear != NULL && clear->pending_count != 0) {
+        memset(clear->is_pending, 0,
+               (size_t)clear->tiles_per_row * clear->tiles_per_column);
+        clear->pending_count = 0;
+    }
+}
+
+// Expands the clear value to the texel read in place of the pending tiles,
+// called whenever the value changes.
+static void update_clear_texel(struct texture *texture) {
+    struct pending_clear *clear = texture->pending_clear;
+    size_t sample_size = get_sample_size(texture->format);
+    if (texture->format == TEXTURE_FORMAT_RGBA16F_4X) {
+        memcpy(clear->texel, clear->value, sample_size);
+        return;
+    }
+    size_t pixel_size = get_pixel_size(texture->format);
+    for (size_t offset = 0; offset < pixel_size; offset += sample_size) {
+        memcpy(clear->texel + offset, clear->value, sample_size);
+    }
+    for (size_t i = pixel_size; i < texture->texel_size; i++) {
+        clear->texel[i] = 0xFF;
+    }
+}
+
+// Gets the texel a pending clear leaves at (x, y) of the base level, or a null
+// pointer if the tile of the texel is not pending and the storage is current.
+static inline const uint8_t *get_pending_texel(const struct texture *texture,
+                                               uint32_t x, uint32_t y) {
+    const struct pending_clear *clear = texture->pending_clear;
+    if (clear == NULL || clear->pending_count == 0) {
+        return NULL;
+    }
+    size_t tile = (size_t)(y / CLEAR_TILE_SIZE) * clear->tiles_per_row +
+                  x / CLEAR_TILE_SIZE;
+    return clear->is_pending[tile] ? clear->texel : NULL;
+}
+
+// Gets the texel at (x, y) of a level of an ordinary texture. The texels of the
+// pending tiles of the base level are read from the clear, without writing it.
+static inline const uint8_t *get_level_texel(const struct texture *texture,
+                                             const struct texture_level *level,
+                                             uint32_t x, uint32_t y) {
+    if (level == texture->levels) {
+        const uint8_t *texel = get_pending_texel(texture, x, y);
+        if (texel != NULL) {
+            return texel;
+        }
+    }
+    return (const uint8_t *)level->pixels +
+           get_texel_index(texture->layout, level, x, y) * texture->texel_size;
+}
+
+// Gives the target the pending tiles of the source, whose texels are not
+// copied. The textures have the same format and size.
+static bool copy_pending_clear(struct texture *target,
+                               const struct texture *source) {
+    const struct pending_clear *source_clear = source->pending_clear;
+    if (source_clear == NULL || source_clear->pending_count == 0) {
+        discard_pending_clear(target);
+        return true;
+    }
+    size_t size = sizeof(struct pending_clear) +
+                  (size_t)source_clear->tiles_per_row *
+                      source_clear->tiles_per_column;
+    if (target->pending_clear == NULL) {
+        target->pending_clear = malloc(size);
+        if (target->pending_clear == NULL) {
+            return false;
+        }
+    }
+    memcpy(target->pending_clear, source_clear, size);
+    // The layouts, and so the padding of the texels, may differ.
+    update_clear_texel(target);
+    return true;
+}
+
+// The function releasing base levels allocated by the texture itself.
+static void free_allocated_pixels(void *pixels, void *user_data) {
+    (void)user_data;
+    free(pixels);
+}
+
+// Releases the given pixels of the base level of the texture, if the texture
+// owns them.
+static void free_base_pixels(const struct texture *texture, void *pixels) {
+    if (texture->free_base_pixels != NULL) {
+        texture->free_base_pixels(pixels, texture->free_base_user_data);
+    }
+}
+
+// Allocates a texture with a single level whose pixels are not allocated yet.
+static struct texture *allocate_texture(enum texture_format format,
+                                        uint32_t width, uint32_t height) {
     if (width == 0 || height == 0) {
         return NULL;
     }
-    size_t pixel_size = get_pixel_size(internal_format);
-    if (pixel_size == 0) {
+    size_t pixel_size = get_pixel_size(format);
+    bool is_compressed = get_block_size(format) != 0;
+    if (pixel_size == 0 && !is_compressed) {
         return NULL;
     }
     struct texture *texture = malloc(sizeof(struct texture));
     if (texture == NULL) {
         return NULL;
     }
-    size_t pixel_count = (size_t)width * height;
-    texture->pixels = malloc(pixel_count * pixel_size);
-    if (texture->pixels == NULL) {
+    texture->format = format;
+    texture->filter = TEXTURE_FILTER_NEAREST;
+    texture->layout =
+        is_compressed ? TEXTURE_LAYOUT_TILED : TEXTURE_LAYOUT_LINEAR;
+    texture->texel_size = pixel_size;
+    texture->readback_pixels = NULL;
+    texture->level_count = 1;
+    texture->pages = NULL;
+    texture->depth_bounds = NULL;
+    texture->pending_clear = NULL;
+
+    struct texture_level *base = &texture->levels[0];
+    base->width = width;
+    base->height = height;
+    base->pixels = NULL;
+    texture->free_base_pixels = NULL;
+    texture->free_base_user_data = NULL;
+    return texture;
+}
+
+struct texture *create_texture(enum texture_format internal_format,
+                               uint32_t width, uint32_t height) {
+    struct texture *texture = allocate_texture(internal_format, width, height);
+    if (texture == NULL) {
+        return NULL;
+    }
+    struct texture_level *base = &texture->levels[0];
+    base->pixels = malloc(get_texture_level_size(texture, width, height));
+    if (base->pixels == NULL) {
         free(texture);
         return NULL;
     }
+    texture->free_base_pixels = free_allocated_pixels;
+    return texture;
+}
 
-    texture->format = internal_format;
-    texture->width = width;
-    texture->height = height;
+struct texture *create_texture_from_buffer(
+    enum texture_format internal_format, uint32_t width, uint32_t height,
+    void *pixels, texture_buffer_free_function free_buffer, void *user_data) {
+    if (pixels == NULL) {
+        return NULL;
+    }
+    struct texture *texture = allocate_texture(internal_format, width, height);
+    if (texture == NULL) {
+        return NULL;
+    }
+    texture->levels[0].pixels = pixels;
+    texture->free_base_pixels = free_buffer;
+    texture->free_base_user_data = user_data;
     return texture;
 }
 
 void destroy_texture(struct texture *texture) {
     if (texture != NULL) {
-        free(texture->pixels);
+        free_mipmaps(texture);
+        free_base_pixels(texture, texture->levels[0].pixels);
+        free(texture->readback_pixels);
+        free_depth_bounds(texture);
+        free(texture->pending_clear);
+        if (texture->pages != NULL) {
+            destroy_pages(texture->pages);
+        }
         free(texture);
     }
 }
 
 bool set_texture_pixels(struct texture *texture, const void *pixels) {
-    if (texture == NULL || pixels == NULL) {
+    if (texture == NULL || pixels == NULL || texture->pages != NULL) {
         return false;
     }
+    invalidate_depth_bounds(texture);
+    discard_pending_clear(texture);
+    const struct texture_level *base = &texture->levels[0];
+    if (get_block_size(texture->format) != 0) {
+        free_mipmaps(texture);
+        memcpy(base->pixels, pixels,
+               get_texture_level_size(texture, base->width, base->height));
+        return true;
+    }
     size_t pixel_size = get_pixel_size(texture->format);
-    if (pixel_size == 0) {
+    if (texture->layout == TEXTURE_LAYOUT_LINEAR) {
+        size_t pixel_count = (size_t)base->width * base->height;
+        memcpy(base->pixels, pixels, pixel_size * pixel_count);
+    } else {
+        copy_level(base->pixels, texture->layout, texture->texel_size, pixels,
+                   TEXTURE_LAYOUT_LINEAR, pixel_size, pixel_size, base);
+    }
+    if (texture->level_count > 1) {
+        generate_texture_mipmaps(texture);
+    }
+    return true;
+}
+
+bool copy_texture(struct texture *target, const struct texture *source) {
+    if (target == NULL || source == NULL || target->pages != NULL ||
+        source->pages != NULL || target->format != source->format ||
+        get_block_size(target->format) != 0) {
+        return false;
+    }
+    const struct texture_level *base = &target->levels[0];
+    if (base->width != source->levels[0].width ||
+        base->height != source->levels[0].height) {
+        return false;
+    }
+    // The pending tiles of the source stay pending in the copy.
+    if (!copy_pending_clear(target, source)) {
         return false;
     }
-    size_t pixel_count = (size_t)texture->width * texture->height;
-    memcpy(texture->pixels, pixels, pixel_size * pixel_count);
+    // The depth bounds of the source stay valid for the copy.
+    const struct depth_bounds *source_bounds = source->depth_bounds;
+    if (source_bounds != NULL && source_bounds->is_valid) {
+        struct depth_bounds *target_bounds = allocate_depth_bounds(target);
+        if (target_bounds == NULL) {
+            return false;
+        }
+        size_t bounds_count = 0;
+        for (uint32_t i = 1; i < source_bounds->level_count; i++) {
+            bounds_count +=
+                (size_t)source_bounds->widths[i] * source_bounds->heights[i];
+        }
+        if (bounds_count > 0) {
+            memcpy(target_bounds->bounds[1], source_bounds->bounds[1],
+                   bounds_count * sizeof(float[2]));
+        }
+        target_bounds->is_valid = true;
+    } else {
+        invalidate_depth_bounds(target);
+    }
+    if (target->layout == source->layout) {
+        memcpy(base->pixels, source->levels[0].pixels,
+               get_texture_level_size(target, base->width, base->height));
+    } else {
+        copy_level(base->pixels, target->layout, target->texel_size,
+                   source->levels[0].pixels, source->layout,
+                   source->texel_size, get_pixel_size(target->format), base);
+    }
+    if (target->level_count > 1) {
+        generate_texture_mipmaps(target);
+    }
     return true;
 }
 
-void *get_texture_pixels(struct texture *texture) {
-    if (texture == NULL) {
-        return NULL;
+bool set_texture_subimage(struct texture *texture, uint32_t x, uint32_t y,
+                          uint32_t width, uint32_t height,
+                          const void *pixels) {
+    if (texture == NULL || pixels == NULL || texture->pages != NULL ||
+        get_block_size(texture->format) != 0 ||
+        is_multisample_format(texture->format)) {
+        return false;
+    }
+    const struct texture_level *base = &texture->levels[0];
+    if (width == 0 || height == 0 || x >= base->width ||
+        y >= base->height || width > base->width - x ||
+        height > base->height - y) {
+        return false;
+    }
+    invalidate_depth_bounds(texture);
+    // The mipmap chain is updated from the texels around the rectangle as well.
+    write_pending_clear(texture);
+    size_t pixel_size = get_pixel_size(texture->format);
+    size_t texel_size = texture->texel_size;
+    const uint8_t *source = pixels;
+    uint8_t *target = base->pixels;
+    for (uint32_t row = 0; row < height; row++) {
+        const uint8_t *source_row = source + (size_t)row * width * pixel_size;
+        if (texture->layout == TEXTURE_LAYOUT_LINEAR) {
+            size_t index = get_texel_index(texture->layout, base, x, y + row);
+            memcpy(target + index * texel_size, source_row,
+                   (size_t)width * pixel_size);
+            continue;
+        }
+        for (uint32_t column = 0; column < width; column++) {
+            size_t index =
+                get_texel_index(texture->layout, base, x + column, y + row);
+            uint8_t *texel = target + index * texel_size;
+            memcpy(texel, source_row + (size_t)column * pixel_size,
+                   pixel_size);
+            for (size_t i = pixel_size; i < texel_size; i++) {
+                texel[i] = 0xFF;
+            }
+        }
     }
-    return texture->pixels;
+    // Only the texels of the mipmap chain covering the updated region change.
+    uint32_t min_x = x;
+    uint32_t min_y = y;
+    uint32_t max_x = x + width - 1;
+    uint32_t max_y = y + height - 1;
+    for (uint32_t i = 1; i < texture->level_count; i++) {
+        struct texture_level *level = &texture->levels[i];
+        // The last texel of an odd sized level is covered by the last texel of
+        // the next level.
+        min_x = uint32_min(min_x / 2, level->width - 1);
+        min_y = uint32_min(min_y / 2, level->height - 1);
+        max_x = uint32_min(max_x / 2, level->width - 1);
+        max_y = uint32_min(max_y / 2, level->height - 1);
+        downsample_level_region(texture, level, &texture->levels[i - 1], min_x,
+                                min_y, max_x, max_y);
+    }
+    return true;
 }
 
-enum texture_format get_texture_format(const struct texture *texture) {
-    return texture->format;
+bool generate_texture_mipmaps(struct texture *texture) {
+    if (texture == NULL || texture->pages != NULL ||
+        texture->format == TEXTURE_FORMAT_DEPTH_FLOAT ||
+        texture->format == TEXTURE_FORMAT_RGBA16F ||
+        texture->format == TEXTURE_FORMAT_R11G11B10F ||
+        is_multisample_format(texture->format)) {
+        return false;
+    }
+    if (get_pixel_size(texture->format) == 0) {
+        return false;
+    }
+    write_pending_clear(texture);
+    free_mipmaps(texture);
+    // Compute the size of each level and the total memory the chain requires.
+    uint32_t level_count = 1;
+    size_t chain_size = 0;
+    uint32_t width = texture->levels[0].width;
+    uint32_t height = texture->levels[0].height;
+    while (width > 1 || height > 1) {
+        width = uint32_max(width / 2, 1);
+        height = uint32_max(height / 2, 1);
+        texture->levels[level_count].width = width;
+        texture->levels[level_count].height = height;
+        chain_size += get_texture_level_size(texture, width, height);
+        level_count++;
+    }
+    if (level_count == 1) {
+        return true;
+    }
+    uint8_t *chain = malloc(chain_size);
+    if (chain == NULL) {
+        return false;
+    }
+    for (uint32_t i = 1; i < level_count; i++) {
+        struct texture_level *level = &texture->levels[i];
+        level->pixels = chain;
+        chain += get_texture_level_size(texture, level->width, level->height);
+        downsample_level(texture, level, &texture->levels[i - 1]);
+    }
+    texture->level_count = level_count;
+    return true;
 }
 
-uint32_t get_texture_width(const struct texture *texture) {
-    return texture->width;
+// Allocates the depth bounds of the texture, or returns the existing ones. The
+// size of a texture never changes, so the pyramid can be reused.
+static struct depth_bounds *allocate_depth_bounds(struct texture *texture) {
+    if (texture->depth_bounds != NULL) {
+        return texture->depth_bounds;
+    }
+    struct depth_bounds *depth_bounds = malloc(sizeof(struct depth_bounds));
+    if (depth_bounds == NULL) {
+        return NULL;
+    }
+    uint32_t level_count = 1;
+    size_t bounds_count = 0;
+    uint32_t width = texture->levels[0].width;
+    uint32_t height = texture->levels[0].height;
+    depth_bounds->widths[0] = width;
+    depth_bounds->heights[0] = height;
+    depth_bounds->bounds[0] = NULL;
+    while (width > 1 || height > 1) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        depth_bounds->widths[level_count] = width;
+        depth_bounds->heights[level_count] = height;
+        bounds_count += (size_t)width * height;
+        level_count++;
+    }
+    float(*bounds)[2] = NULL;
+    if (level_count > 1) {
+        bounds = malloc(bounds_count * sizeof(float[2]));
+        if (bounds == NULL) {
+            free(depth_bounds);
+            return NULL;
+        }
+    }
+    for (uint32_t i = 1; i < level_count; i++) {
+        depth_bounds->bounds[i] = bounds;
+        bounds += (size_t)depth_bounds->widths[i] * depth_bounds->heights[i];
+    }
+    depth_bounds->level_count = level_count;
+    depth_bounds->is_valid = false;
+    texture->depth_bounds = depth_bounds;
+    return depth_bounds;
 }
 
-uint32_t get_texture_height(const struct texture *texture) {
-    return texture->height;
+bool generate_texture_depth_bounds(struct texture *texture) {
+    if (texture == NULL || texture->format != TEXTURE_FORMAT_DEPTH_FLOAT) {
+        return false;
+    }
+    struct depth_bounds *depth_bounds = allocate_depth_bounds(texture);
+    if (depth_bounds == NULL) {
+        return false;
+    }
+    // Level 1 reads the base level, every other level reads the previous one.
+    // The texels beyond the last row or column of an odd sized level are
+    // skipped. The pending tiles of a deferred clear are read, not written.
+    const struct texture_level *base = &texture->levels[0];
+    for (uint32_t i = 1; i < depth_bounds->level_count; i++) {
+        uint32_t source_width = depth_bounds->widths[i - 1];
+        uint32_t source_height = depth_bounds->heights[i - 1];
+        float(*target)[2] = depth_bounds->bounds[i];
+        float(*source)[2] = depth_bounds->bounds[i - 1];
+        for (uint32_t y = 0; y < depth_bounds->heights[i]; y++) {
+            for (uint32_t x = 0; x < depth_bounds->widths[i]; x++) {
+                float min_depth = INFINITY;
+                float max_depth = -INFINITY;
+                uint32_t x1 = uint32_min(x * 2 + 1, source_width - 1);
+                uint32_t y1 = uint32_min(y * 2 + 1, source_height - 1);
+                for (uint32_t sy = y * 2; sy <= y1; sy++) {
+                    for (uint32_t sx = x * 2; sx <= x1; sx++) {
+                        if (i == 1) {
+                            float depth;
+                            memcpy(&depth,
+                                   get_level_texel(texture, base, sx, sy),
+                                   sizeof(float));
+                            min_depth = float_min(min_depth, depth);
+                            max_depth = float_max(max_depth, depth);
+                        } else {
+                            const float *texel =
+                                source[(size_t)sy * source_width + sx];
+                            min_depth = float_min(min_depth, texel[0]);
+                            max_depth = float_max(max_depth, texel[1]);
+                        }
+                    }
+                }
+                float *texel = target[(size_t)y * depth_bounds->widths[i] + x];
+                texel[0] = min_depth;
+                texel[1] = max_depth;
+            }
+        }
+    }
+    depth_bounds->is_valid = true;
+    return true;
 }
 
-vector4 texture_sample(const struct texture *texture, vector2 texcoord) {
-    float u = float_clamp01(texcoord.u);
-    float v = float_clamp01(texcoord.v);
-    uint32_t u_index = (uint32_t)(u * texture->width);
-    uint32_t v_index = (uint32_t)(v * texture->height);
-    // Prevent array access out of bounds.
-    u_index = u_index >= texture->width ? texture->width - 1 : u_index;
-    v_index = v_index >= texture->height ? texture->height - 1 : v_index;
-    size_t pixel_offset = (size_t)u_index + v_index * texture->width;
+void *get_texture_pixels(struct texture *texture) {
+    if (texture == NULL || texture->pages != NULL) {
+        return NULL;
+    }
+    // The caller may write to the returned pixels.
+    invalidate_depth_bounds(texture);
+    write_pending_clear(texture);
+    const struct texture_level *base = &texture->levels[0];
+    if (texture->layout == TEXTURE_LAYOUT_LINEAR ||
+        get_block_size(texture->format) != 0) {
+        return base->pixels;
+    }
+    size_t pixel_size = get_pixel_size(texture->format);
+    if (texture->readback_pixels == NULL) {
+        texture->readback_pixels = malloc(get_level_storage_size(
+            TEXTURE_LAYOUT_LINEAR, pixel_size, base->width, base->height));
+        if (texture->readback_pixels == NULL) {
+            return NULL;
+        }
+    }
+    copy_level(texture->readback_pixels, TEXTURE_LAYOUT_LINEAR, pixel_size,
+               base->pixels, texture->layout, texture->texel_size, pixel_size,
+               base);
+    return texture->readback_pixels;
+}
 
-    vector4 pixel = VECTOR4_ONE;
-    enum texture_format format = texture->format;
-    if (format == TEXTURE_FORMAT_DEPTH_FLOAT) {
-        const float *target = (float *)texture->pixels + pixel_offset;
-        pixel.r = *target;
-        pixel.g = *target;
-        pixel.b = *target;
-    } else if (format == TEXTURE_FORMAT_R8) {
-        const uint8_t *target = (uint8_t *)texture->pixels + pixel_offset;
-        pixel.r = uint8_to_float(target[0]);
-        pixel.g = pixel.r;
-        pixel.b = pixel.r;
-    } else {
-        size_t pixel_size = get_pixel_size(format);
-        if (pixel_size == 0) {
-            pixel = VECTOR4_ZERO;
-        } else {
-            // format == TEXTURE_FORMAT_RGB8 ||
-            // format == TEXTURE_FORMAT_SRGB8 ||
-            // format == TEXTURE_FORMAT_RGBA8 ||
-            // format == TEXTURE_FORMAT_SRGB8_A8)
-            const uint8_t *target =
-                (uint8_t *)texture->pixels + pixel_offset * pixel_size;
-            for (size_t i = 0; i < pixel_size; i++) {
-                pixel.elements[i] = uint8_to_float(target[i]);
+bool clear_texture(struct texture *texture, uint32_t x, uint32_t y,
+                   uint32_t width, uint32_t height, const void *value) {
+    if (texture == NULL || value == NULL || texture->pages != NULL ||
+        get_block_size(texture->format) != 0) {
+        return false;
+    }
+    const struct texture_level *base = &texture->levels[0];
+    if (width == 0 || height == 0 || x >= base->width ||
+        y >= base->height || width > base->width - x ||
+        height > base->height - y) {
+        return false;
+    }
+    struct pending_clear *clear = texture->pending_clear;
+    if (clear == NULL) {
+        uint32_t tiles_per_row =
+            (base->width + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE;
+        uint32_t tiles_per_column =
+            (base->height + CLEAR_TILE_SIZE - 1) / CLEAR_TILE_SIZE;
+        size_t tile_count = (size_t)tiles_per_row * tiles_per_column;
+        clear = malloc(sizeof(struct pending_clear) + tile_count);
+        if (clear == NULL) {
+            return false;
+        }
+        memset(clear->value, 0, sizeof(clear->value));
+        clear->tiles_per_row = tiles_per_row;
+        clear->tiles_per_column = tiles_per_column;
+        clear->pending_count = 0;
+        memset(clear->is_pending, 0, tile_count);
+        texture->pending_clear = clear;
+        update_clear_texel(texture);
+    }
+    invalidate_depth_bounds(texture);
+    size_t sample_size = get_sample_size(texture->format);
+    if (memcmp(clear->value, value, sample_size) != 0) {
+        // There is a single clear value, the tiles still pending with the
+        // previous one are written first.
+        write_pending_clear(texture);
+        memcpy(clear->value, value, sample_size);
+        update_clear_texel(texture);
+    }
+    // The tiles entirely inside the rectangle are only marked pending. The
+    // texels of the rectangle in other tiles are written now, unless the tile
+    // is already pending with the same value.
+    uint32_t right = x + width;
+    uint32_t top = y + height;
+    for (uint32_t ty = y / CLEAR_TILE_SIZE; ty <= (top - 1) / CLEAR_TILE_SIZE;
+         ty++) {
+        uint32_t tile_bottom = ty * CLEAR_TILE_SIZE;
+        uint32_t tile_top =
+            uint32_min(tile_bottom + CLEAR_TILE_SIZE, base->height);
+        for (uint32_t tx = x / CLEAR_TILE_SIZE;
+             tx <= (right - 1) / CLEAR_TILE_SIZE; tx++) {
+            bool *is_pending =
+                &clear->is_pending[(size_t)ty * clear->tiles_per_row + tx];
+            if (*is_pending) {
+                continue;
             }
-            if (is_srgb_encoding(format)) {
-                pixel.r = convert_to_linear_color(pixel.r);
-                pixel.g = convert_to_linear_color(pixel.g);
-                pixel.b = convert_to_linear_color(pixel.b);
+            uint32_t tile_left = tx * CLEAR_TILE_SIZE;
+            uint32_t tile_right =
+                uint32_min(tile_left + CLEAR_TILE_SIZE, base->width);
+            uint32_t left = uint32_max(tile_left, x);
+            uint32_t bottom = uint32_max(tile_bottom, y);
+            uint32_t clipped_right = uint32_min(tile_right, right);
+            uint32_t clipped_top = uint32_min(tile_top, top);
+            if (left == tile_left && bottom == tile_bottom &&
+                clipped_right == tile_right && clipped_top == tile_top) {
+                *is_pending = true;
+                clear->pending_count++;
+            } else {
+                fill_base_level(texture, left, bottom, clipped_right,
+                                clipped_top, clear->value);
             }
         }
     }
-    return pixel;
+    return true;
+}
+
+void flush_texture_clear(struct texture *texture, uint32_t x, uint32_t y,
+                         uint32_t width, uint32_t height) {
+    if (texture == NULL || texture->pending_clear == NULL) {
+        return;
+    }
+    const struct texture_level *base = &texture->levels[0];
+    if (width == 0 || height == 0 || x >= base->width || y >= base->height) {
+        return;
+    }
+    uint32_t right = width < base->width - x ? x + width : base->width;
+    uint32_t top = height < base->height - y ? y + height : base->height;
+    write_pending_tiles(texture, x, y, right, top);
+}
+
+void *get_texture_storage(struct texture *texture) {
+    if (texture == NULL || texture->pages != NULL) {
+        return NULL;
+    }
+    // The caller may write to the returned pixels.
+    invalidate_depth_bounds(texture);
+    return texture->levels[0].pixels;
+}
+
+const void *get_texture_storage_const(const struct texture *texture) {
+    if (texture == NULL || texture->pages != NULL) {
+        return NULL;
+    }
+    return texture->levels[0].pixels;
+}
+
+const void *get_texture_clear_texel(const struct texture *texture, uint32_t x,
+                                    uint32_t y) {
+    if (texture == NULL || x >= texture->levels[0].width ||
+        y >= texture->levels[0].height) {
+        return NULL;
+    }
+    return get_pending_texel(texture, x, y);
+}
+
+bool set_texture_layout(struct texture *texture, enum texture_layout layout) {
+    if (texture == NULL ||
+        (layout != TEXTURE_LAYOUT_LINEAR && layout != TEXTURE_LAYOUT_TILED)) {
+        return false;
+    }
+    if (texture->layout == layout) {
+        return true;
+    }
+    if (get_block_size(texture->format) != 0 || texture->pages != NULL) {
+        // Block compressed textures can only be stored in blocks, virtual
+        // textures can only be stored in pages.
+        return false;
+    }
+    if (is_multisample_format(texture->format)) {
+        // The samples are written by the rasterizer in place, which only
+        // handles the linear layout.
+        return false;
+    }
+    write_pending_clear(texture);
+    size_t pixel_size = get_pixel_size(texture->format);
+    size_t texel_size = get_texel_size(texture->format, layout);
+    // Allocate all new storage first, so that the texture is left unchanged
+    // if any allocation fails.
+    const struct texture_level *base = &texture->levels[0];
+    uint8_t *base_pixels = malloc(get_level_storage_size(
+        layout, texel_size, base->width, base->height));
+    if (base_pixels == NULL) {
+        return false;
+    }
+    uint8_t *chain = NULL;
+    if (texture->level_count > 1) {
+        size_t chain_size = 0;
+        for (uint32_t i = 1; i < texture->level_count; i++) {
+            const struct texture_level *level = &texture->levels[i];
+            chain_size += get_level_storage_size(layout, texel_size,
+                                                 level->width, level->height);
+        }
+        chain = malloc(chain_size);
+        if (chain == NULL) {
+            free(base_pixels);
+            return false;
+        }
+    }
+
+    void *old_base_pixels = base->pixels;
+    void *old_chain = texture->level_count > 1 ? texture->levels[1].pixels
+                                               : NULL;
+    for (uint32_t i = 0; i < texture->level_count; i++) {
+        struct texture_level *level = &texture->levels[i];
+        uint8_t *pixels = i == 0 ? base_pixels : chain;
+        copy_level(pixels, layout, texel_size, level->pixels, texture->layout,
+                   texture->texel_size, pixel_size, level);
+        if (i > 0) {
+            chain += get_level_storage_size(layout, texel_size, level->width,
+                                            level->height);
+        }
+        level->pixels = pixels;
+    }
+    free_base_pixels(texture, old_base_pixels);
+    texture->free_base_pixels = free_allocated_pixels;
+    texture->free_base_user_data = NULL;
+    free(old_chain);
+    texture->layout = layout;
+    texture->texel_size = texel_size;
+    free(texture->readback_pixels);
+    texture->readback_pixels = NULL;
+    if (texture->pending_clear != NULL) {
+        // The padding of the texels may have changed.
+        update_clear_texel(texture);
+    }
+    return true;
+}
+
+// Compresses a level of the source texture into the storage of the target
+// level, block by block. Texels of partial blocks at the right and top edges
+// are duplicated from the last column and row.
+static void compress_level(struct texture_level *target,
+                           enum texture_format format,
+                           const struct texture *source,
+                           const struct texture_level *source_level) {
+    size_t block_size = get_block_size(format);
+    uint32_t blocks_per_row = (target->width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t blocks_per_column = (target->height + TILE_SIZE - 1) / TILE_SIZE;
+    uint8_t *block = target->pixels;
+    for (uint32_t block_y = 0; block_y < blocks_per_column; block_y++) {
+        for (uint32_t block_x = 0; block_x < blocks_per_row; block_x++) {
+            // The R, G, B components of the 16 texels of the block.
+            uint8_t texels[16][3];
+            for (int i = 0; i < 16; i++) {
+                uint32_t x = uint32_min(block_x * TILE_SIZE + i % TILE_SIZE,
+                                        source_level->width - 1);
+                uint32_t y = uint32_min(block_y * TILE_SIZE + i / TILE_SIZE,
+                                        source_level->height - 1);
+                const uint8_t *texel =
+                    get_level_texel(source, source_level, x, y);
+                size_t component_count = get_pixel_size(source->format);
+                for (size_t c = 0; c < 3; c++) {
+                    texels[i][c] = c < component_count ? texel[c] : 0;
+                }
+            }
+
+            if (format == TEXTURE_FORMAT_BC1 ||
+                format == TEXTURE_FORMAT_BC1_SRGB) {
+                encode_bc1_block(block, (const uint8_t(*)[3])texels);
+            } else {
+                // BC4 encodes the R component, BC5 encodes the R and G
+                // components in two consecutive BC4 blocks.
+                int block_count = format == TEXTURE_FORMAT_BC5 ? 2 : 1;
+                for (int b = 0; b < block_count; b++) {
+                    uint8_t values[16];
+                    for (int i = 0; i < 16; i++) {
+                        values[i] = texels[i][b];
+                    }
+                    encode_bc4_block(block + b * BC4_BLOCK_SIZE, values);
+                }
+            }
+            block += block_size;
+        }
+    }
+}
+
+struct texture *compress_texture(const struct texture *source,
+                                 enum texture_format format) {
+    if (source == NULL || source->pages != NULL) {
+        return NULL;
+    }
+    enum texture_format source_format = source->format;
+    bool is_valid_source;
+    switch (format) {
+        case TEXTURE_FORMAT_BC1:
+        case TEXTURE_FORMAT_BC5:
+            is_valid_source = source_format == TEXTURE_FORMAT_RGB8 ||
+                              source_format == TEXTURE_FORMAT_RGBA8;
+            break;
+        case TEXTURE_FORMAT_BC1_SRGB:
+            is_valid_source = source_format == TEXTURE_FORMAT_SRGB8 ||
+                              source_format == TEXTURE_FORMAT_SRGB8_A8;
+            break;
+        case TEXTURE_FORMAT_BC4:
+            is_valid_source = source_format == TEXTURE_FORMAT_R8;
+            break;
+        default:
+            is_valid_source = false;
+            break;
+    }
+    if (!is_valid_source) {
+        return NULL;
+    }
+
+    const struct texture_level *source_base = &source->levels[0];
+    struct texture *texture =
+        create_texture(format, source_base->width, source_base->height);
+    if (texture == NULL) {
+        return NULL;
+    }
+    texture->filter = source->filter;
+    if (source->level_count > 1) {
+        size_t chain_size = 0;
+        for (uint32_t i = 1; i < source->level_count; i++) {
+            const struct texture_level *level = &source->levels[i];
+            chain_size +=
+                get_texture_level_size(texture, level->width, level->height);
+        }
+        uint8_t *chain = malloc(chain_size);
+        if (chain == NULL) {
+            destroy_texture(texture);
+            return NULL;
+        }
+        for (uint32_t i = 1; i < source->level_count; i++) {
+            struct texture_level *level = &texture->levels[i];
+            level->width = source->levels[i].width;
+            level->height = source->levels[i].height;
+            level->pixels = chain;
+            chain += get_texture_level_size(texture, level->width,
+                                            level->height);
+        }
+        texture->level_count = source->level_count;
+    }
+    for (uint32_t i = 0; i < texture->level_count; i++) {
+        compress_level(&texture->levels[i], format, source, &source->levels[i]);
+    }
+    return texture;
+}
+
+struct texture *create_virtual_texture(
+    enum texture_format format, uint32_t width, uint32_t height,
+    uint32_t level_count, uint32_t cache_page_count,
+    const struct texture_page_source *source) {
+    if (width == 0 || height == 0 || level_count == 0 ||
+        cache_page_count == 0 || source == NULL || source->load_page == NULL) {
+        return NULL;
+    }
+    if ((get_pixel_size(format) == 0 && get_block_size(format) == 0) ||
+        format == TEXTURE_FORMAT_DEPTH_FLOAT || is_multisample_format(format)) {
+        return NULL;
+    }
+    struct texture *texture = malloc(sizeof(struct texture));
+    if (texture == NULL) {
+        return NULL;
+    }
+    texture->format = format;
+    texture->filter = TEXTURE_FILTER_NEAREST;
+    texture->layout = TEXTURE_LAYOUT_TILED;
+    texture->texel_size = get_texel_size(format, TEXTURE_LAYOUT_TILED);
+    texture->readback_pixels = NULL;
+    texture->level_count = level_count;
+    texture->pages = NULL;
+    texture->depth_bounds = NULL;
+    texture->pending_clear = NULL;
+    texture->free_base_pixels = NULL;
+    texture->free_base_user_data = NULL;
+
+    struct texture_pages *pages = calloc(1, sizeof(struct texture_pages));
+    if (pages == NULL) {
+        free(texture);
+        return NULL;
+    }
+    pages->source = *source;
+    pages->page_size = get_page_size(format);
+    for (uint32_t i = 0; i < level_count; i++) {
+        if (i > 0) {
+            if (width == 1 && height == 1) {
+                // More levels than a complete mipmap chain.
+                pages->source.release = NULL;
+                destroy_pages(pages);
+                free(texture);
+                return NULL;
+            }
+            width = uint32_max(width / 2, 1);
+            height = uint32_max(height / 2, 1);
+        }
+        struct texture_level *level = &texture->levels[i];
+        level->width = width;
+        level->height = height;
+        level->pixels = NULL;
+        pages->first_pages[i] = pages->page_count;
+        pages->pages_per_row[i] = get_page_count_in_line(width);
+        pages->page_count +=
+            pages->pages_per_row[i] * get_page_count_in_line(height);
+    }
+    pages->slot_count = uint32_min(cache_page_count, pages->page_count);
+    pages->page_slots = malloc(pages->page_count * sizeof(int32_t));
+    pages->touched_pages = calloc(pages->page_count, sizeof(bool));
+    pages->slots = malloc(pages->slot_count * sizeof(struct page_slot));
+    pages->cache = malloc(pages->slot_count * pages->page_size);
+    if (pages->page_slots == NULL || pages->touched_pages == NULL ||
+        pages->slots == NULL || pages->cache == NULL) {
+        pages->source.release = NULL;
+        destroy_pages(pages);
+        free(texture);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < pages->page_count; i++) {
+        pages->page_slots[i] = -1;
+    }
+    for (uint32_t i = 0; i < pages->slot_count; i++) {
+        pages->slots[i].page_index = UINT32_MAX;
+        pages->slots[i].last_used = 0;
+    }
+    texture->pages = pages;
+    return texture;
+}
+
+uint32_t get_texture_page_count(const struct texture *texture) {
+    if (texture->pages != NULL) {
+        return texture->pages->page_count;
+    }
+    uint32_t page_count = 0;
+    for (uint32_t i = 0; i < texture->level_count; i++) {
+        const struct texture_level *level = &texture->levels[i];
+        page_count += get_page_count_in_line(level->width) *
+                      get_page_count_in_line(level->height);
+    }
+    return page_count;
+}
+
+size_t get_texture_page_size(const struct texture *texture) {
+    return get_page_size(texture->format);
+}
+
+bool get_texture_page(const struct texture *texture, uint32_t page_index,
+                      void *pixels) {
+    if (texture == NULL || pixels == NULL || texture->pages != NULL) {
+        return false;
+    }
+    // Find the level that the page belongs to.
+    const struct texture_level *level = NULL;
+    uint32_t pages_per_row = 0;
+    for (uint32_t i = 0; i < texture->level_count; i++) {
+        const struct texture_level *current = &texture->levels[i];
+        pages_per_row = get_page_count_in_line(current->width);
+        uint32_t level_page_count =
+            pages_per_row * get_page_count_in_line(current->height);
+        if (page_index < level_page_count) {
+            level = current;
+            break;
+        }
+        page_index -= level_page_count;
+    }
+    if (level == NULL) {
+        return false;
+    }
+    uint32_t page_x = page_index % pages_per_row * PAGE_SIZE;
+    uint32_t page_y = page_index / pages_per_row * PAGE_SIZE;
+
+    uint8_t *target = pixels;
+    const uint8_t *source = level->pixels;
+    size_t block_size = get_block_size(texture->format);
+    if (block_size != 0) {
+        // Copy the blocks, blocks out of the level are filled with 0.
+        uint32_t blocks_per_row = (level->width + TILE_SIZE - 1) / TILE_SIZE;
+        uint32_t blocks_per_column =
+            (level->height + TILE_SIZE - 1) / TILE_SIZE;
+        for (uint32_t y = 0; y < PAGE_SIZE / TILE_SIZE; y++) {
+            for (uint32_t x = 0; x < PAGE_SIZE / TILE_SIZE; x++) {
+                uint32_t block_x = page_x / TILE_SIZE + x;
+                uint32_t block_y = page_y / TILE_SIZE + y;
+                if (block_x < blocks_per_row && block_y < blocks_per_column) {
+                    memcpy(target,
+                           source + ((size_t)block_y * blocks_per_row +
+                                     block_x) * block_size,
+                           block_size);
+                } else {
+                    memset(target, 0, block_size);
+                }
+                target += block_size;
+            }
+        }
+        return true;
+    }
+    // Copy the texels, texels out of the level duplicate the last column and
+    // row of the level.
+    const struct texture_level page = {PAGE_SIZE, PAGE_SIZE, pixels};
+    size_t pixel_size = get_pixel_size(texture->format);
+    size_t texel_size = get_texel_size(texture->format, TEXTURE_LAYOUT_TILED);
+    for (uint32_t y = 0; y < PAGE_SIZE; y++) {
+        for (uint32_t x = 0; x < PAGE_SIZE; x++) {
+            uint32_t source_x = uint32_min(page_x + x, level->width - 1);
+            uint32_t source_y = uint32_min(page_y + y, level->height - 1);
+            uint8_t *target_texel =
+                target +
+                get_texel_index(TEXTURE_LAYOUT_TILED, &page, x, y) * texel_size;
+            const uint8_t *source_texel =
+                get_level_texel(texture, level, source_x, source_y);
+            memcpy(target_texel, source_texel, pixel_size);
+            for (size_t i = pixel_size; i < texel_size; i++) {
+                target_texel[i] = 0xFF;
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t get_texture_page_feedback(const struct texture *texture,
+                                   uint32_t *page_indices, uint32_t max_count) {
+    if (texture == NULL || texture->pages == NULL) {
+        return 0;
+    }
+    const struct texture_pages *pages = texture->pages;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < pages->page_count; i++) {
+        if (pages->touched_pages[i]) {
+            if (count < max_count) {
+                page_indices[count] = i;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+void clear_texture_page_feedback(struct texture *texture) {
+    if (texture == NULL || texture->pages == NULL) {
+        return;
+    }
+    struct texture_pages *pages = texture->pages;
+    memset(pages->touched_pages, 0, pages->page_count * sizeof(bool));
+}
+
+enum texture_layout get_texture_layout(const struct texture *texture) {
+    return texture->layout;
+}
+
+enum texture_format get_texture_format(const struct texture *texture) {
+    return texture->format;
+}
+
+uint32_t get_texture_width(const struct texture *texture) {
+    return texture->levels[0].width;
+}
+
+uint32_t get_texture_height(const struct texture *texture) {
+    return texture->levels[0].height;
+}
+
+uint32_t get_texture_level_count(const struct texture *texture) {
+    return texture->level_count;
+}
+
+void set_texture_filter(struct texture *texture, enum texture_filter filter) {
+    if (texture != NULL) {
+        texture->filter = filter;
+    }
+}
+
+enum texture_filter get_texture_filter(const struct texture *texture) {
+    return texture->filter;
+}
+
+// Finds where the texel at (x, y) of the level is stored. Returns the pixels of
+// the level and writes the index of the texel in them. For virtual textures,
+// returns the pixels of the page containing the texel instead, and loads the
+// page if necessary. Returns a null pointer if the page cannot be loaded.
+static inline const uint8_t *locate_texel(const struct texture *texture,
+                                          const struct texture_level *level,
+                                          uint32_t x, uint32_t y,
+                                          size_t *index) {
+    if (texture->pages != NULL) {
+        const struct texture_level page = {PAGE_SIZE, PAGE_SIZE, NULL};
+        uint32_t level_index = (uint32_t)(level - texture->levels);
+        *index = get_texel_index(TEXTURE_LAYOUT_TILED, &page, x % PAGE_SIZE,
+                                 y % PAGE_SIZE);
+        return get_page_pixels(texture->pages, level_index, x / PAGE_SIZE,
+                               y / PAGE_SIZE);
+    }
+    // The pending tiles of a deferred clear are read from the clear.
+    if (level == texture->levels) {
+        const uint8_t *texel = get_pending_texel(texture, x, y);
+        if (texel != NULL) {
+            *index = 0;
+            return texel;
+        }
+    }
+    *index = get_texel_index(texture->layout, level, x, y);
+    return level->pixels;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Texel decoders, one for each format. A decoder converts the texel at the
+// index of the pixels to a linear floating point color.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef vector4 (*texel_decoder)(const uint8_t *pixels, size_t index,
+                                 size_t texel_size);
+
+static vector4 decode_r8(const uint8_t *pixels, size_t index,
+                         size_t texel_size) {
+    const uint8_t *texel = pixels + index * texel_size;
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = uint8_to_float(texel[0]);
+    pixel.g = pixel.r;
+    pixel.b = pixel.r;
+    return pixel;
+}
+
+static vector4 decode_rgb8(const uint8_t *pixels, size_t index,
+                           size_t texel_size) {
+    const uint8_t *texel = pixels + index * texel_size;
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = uint8_to_float(texel[0]);
+    pixel.g = uint8_to_float(texel[1]);
+    pixel.b = uint8_to_float(texel[2]);
+    return pixel;
+}
+
+static vector4 decode_srgb8(const uint8_t *pixels, size_t index,
+                            size_t texel_size) {
+    const uint8_t *texel = pixels + index * texel_size;
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = srgb8_to_linear(texel[0]);
+    pixel.g = srgb8_to_linear(texel[1]);
+    pixel.b = srgb8_to_linear(texel[2]);
+    return pixel;
+}
+
+static vector4 decode_rgba8(const uint8_t *pixels, size_t index,
+                            size_t texel_size) {
+    vector4 pixel = decode_rgb8(pixels, index, texel_size);
+    pixel.a = uint8_to_float(pixels[index * texel_size + 3]);
+    return pixel;
+}
+
+static vector4 decode_srgb8_a8(const uint8_t *pixels, size_t index,
+                               size_t texel_size) {
+    vector4 pixel = decode_srgb8(pixels, index, texel_size);
+    // The alpha component is always linear.
+    pixel.a = uint8_to_float(pixels[index * texel_size + 3]);
+    return pixel;
+}
+
+static vector4 decode_depth_float(const uint8_t *pixels, size_t index,
+                                  size_t texel_size) {
+    (void)texel_size;
+    float depth = ((const float *)pixels)[index];
+    return (vector4){{depth, depth, depth, 1.0f}};
+}
+
+static vector4 decode_rgba16f(const uint8_t *pixels, size_t index,
+                              size_t texel_size) {
+    const uint16_t *texel = (const uint16_t *)(pixels + index * texel_size);
+    vector4 pixel;
+    for (int i = 0; i < 4; i++) {
+        pixel.elements[i] = half_to_float(texel[i]);
+    }
+    return pixel;
+}
+
+static vector4 decode_r11g11b10f(const uint8_t *pixels, size_t index,
+                                 size_t texel_size) {
+    (void)texel_size;
+    vector4 pixel = VECTOR4_ONE;
+    unpack_r11g11b10f(pixel.elements, ((const uint32_t *)pixels)[index]);
+    return pixel;
+}
+
+// Block compressed formats are always tiled, and a block takes the place of a
+// tile. So the index of the block is the index of the texel divided by the
+// number of texels in a tile, and the remainder is the index of the texel in
+// the block.
+#define BLOCK_INDEX(index) ((index) / (TILE_SIZE * TILE_SIZE))
+#define INDEX_IN_BLOCK(index) ((int)((index) % (TILE_SIZE * TILE_SIZE)))
+
+static vector4 decode_bc1(const uint8_t *pixels, size_t index,
+                          size_t texel_size) {
+    (void)texel_size;
+    const uint8_t *block = pixels + BLOCK_INDEX(index) * BC1_BLOCK_SIZE;
+    uint8_t rgb[3];
+    decode_bc1_texel(rgb, block, INDEX_IN_BLOCK(index));
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = uint8_to_float(rgb[0]);
+    pixel.g = uint8_to_float(rgb[1]);
+    pixel.b = uint8_to_float(rgb[2]);
+    return pixel;
+}
+
+static vector4 decode_bc1_srgb(const uint8_t *pixels, size_t index,
+                               size_t texel_size) {
+    (void)texel_size;
+    const uint8_t *block = pixels + BLOCK_INDEX(index) * BC1_BLOCK_SIZE;
+    uint8_t rgb[3];
+    decode_bc1_texel(rgb, block, INDEX_IN_BLOCK(index));
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = srgb8_to_linear(rgb[0]);
+    pixel.g = srgb8_to_linear(rgb[1]);
+    pixel.b = srgb8_to_linear(rgb[2]);
+    return pixel;
+}
+
+static vector4 decode_bc4(const uint8_t *pixels, size_t index,
+                          size_t texel_size) {
+    (void)texel_size;
+    const uint8_t *block = pixels + BLOCK_INDEX(index) * BC4_BLOCK_SIZE;
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = uint8_to_float(decode_bc4_texel(block, INDEX_IN_BLOCK(index)));
+    pixel.g = pixel.r;
+    pixel.b = pixel.r;
+    return pixel;
+}
+
+static vector4 decode_bc5(const uint8_t *pixels, size_t index,
+                          size_t texel_size) {
+    (void)texel_size;
+    const uint8_t *block = pixels + BLOCK_INDEX(index) * BC4_BLOCK_SIZE * 2;
+    int index_in_block = INDEX_IN_BLOCK(index);
+    vector4 pixel = VECTOR4_ONE;
+    pixel.r = uint8_to_float(decode_bc4_texel(block, index_in_block));
+    pixel.g = uint8_to_float(
+        decode_bc4_texel(block + BC4_BLOCK_SIZE, index_in_block));
+    // Reconstruct z from x and y of the unit vector.
+    float x = pixel.r * 2.0f - 1.0f;
+    float y = pixel.g * 2.0f - 1.0f;
+    float z = sqrtf(float_max(1.0f - x * x - y * y, 0.0f));
+    pixel.b = z * 0.5f + 0.5f;
+    return pixel;
+}
+
+static texel_decoder get_texel_decoder(enum texture_format format) {
+    switch (format) {
+        case TEXTURE_FORMAT_R8:
+            return decode_r8;
+        case TEXTURE_FORMAT_RGB8:
+            return decode_rgb8;
+        case TEXTURE_FORMAT_SRGB8:
+            return decode_srgb8;
+        case TEXTURE_FORMAT_RGBA8:
+            return decode_rgba8;
+        case TEXTURE_FORMAT_SRGB8_A8:
+            return decode_srgb8_a8;
+        case TEXTURE_FORMAT_DEPTH_FLOAT:
+            return decode_depth_float;
+        case TEXTURE_FORMAT_RGBA16F:
+            return decode_rgba16f;
+        case TEXTURE_FORMAT_R11G11B10F:
+            return decode_r11g11b10f;
+        case TEXTURE_FORMAT_BC1:
+            return decode_bc1;
+        case TEXTURE_FORMAT_BC1_SRGB:
+            return decode_bc1_srgb;
+        case TEXTURE_FORMAT_BC4:
+            return decode_bc4;
+        case TEXTURE_FORMAT_BC5:
+            return decode_bc5;
+        default:
+            return NULL;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filtering. The functions below take the decoder as a parameter. When they
+// are called with a constant decoder, the compiler inlines the decoder and
+// produces a sampling function specialized for the format.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads the texel at (x, y) of the level, and converts the value to a linear
+// floating point color.
+static inline vector4 fetch_texel(texel_decoder decode,
+                                  const struct texture *texture,
+                                  const struct texture_level *level,
+                                  uint32_t x, uint32_t y) {
+    size_t index;
+    const uint8_t *pixels = locate_texel(texture, level, x, y, &index);
+    if (pixels == NULL) {
+        return VECTOR4_ZERO;
+    }
+    return decode(pixels, index, texture->texel_size);
+}
+
+static inline vector4 sample_nearest(texel_decoder decode,
+                                     const struct texture *texture,
+                                     const struct texture_level *level,
+                                     float u, float v) {
+    uint32_t u_index = (uint32_t)(u * level->width);
+    uint32_t v_index = (uint32_t)(v * level->height);
+    // Prevent array access out of bounds.
+    u_index = u_index >= level->width ? level->width - 1 : u_index;
+    v_index = v_index >= level->height ? level->height - 1 : v_index;
+    return fetch_texel(decode, texture, level, u_index, v_index);
+}
+
+// Gets the index of a texel on a row or column of the given size. The index is
+// at most one texel out of range.
+static inline uint32_t wrap_texel_index(int32_t index, uint32_t size,
+                                        enum texture_wrap wrap) {
+    if (wrap == TEXTURE_WRAP_REPEAT) {
+        if (index < 0) {
+            return size - 1;
+        }
+        return (uint32_t)index >= size ? 0 : (uint32_t)index;
+    }
+    return (uint32_t)int32_clamp(index, 0, (int32_t)size - 1);
+}
+
+static inline vector4 sample_bilinear(texel_decoder decode,
+                                      const struct texture *texture,
+                                      const struct texture_level *level,
+                                      enum texture_wrap wrap, float u,
+                                      float v) {
+    // Texel centers are at half-integer coordinates, so shift the coordinate
+    // by half a texel to find the four texels around it.
+    float x = u * level->width - 0.5f;
+    float y = v * level->height - 0.5f;
+    float x_floor = floorf(x);
+    float y_floor = floorf(y);
+    float s = x - x_floor;
+    float t = y - y_floor;
+    uint32_t x0 = wrap_texel_index((int32_t)x_floor, level->width, wrap);
+    uint32_t x1 = wrap_texel_index((int32_t)x_floor + 1, level->width, wrap);
+    uint32_t y0 = wrap_texel_index((int32_t)y_floor, level->height, wrap);
+    uint32_t y1 = wrap_texel_index((int32_t)y_floor + 1, level->height, wrap);
+
+    vector4 bottom =
+        vector4_lerp(fetch_texel(decode, texture, level, x0, y0),
+                     fetch_texel(decode, texture, level, x1, y0), s);
+    vector4 top = vector4_lerp(fetch_texel(decode, texture, level, x0, y1),
+                               fetch_texel(decode, texture, level, x1, y1), s);
+    return vector4_lerp(bottom, top, t);
+}
+
+static inline vector4 sample_level(texel_decoder decode,
+                                   const struct texture *texture,
+                                   enum texture_filter filter,
+                                   enum texture_wrap wrap,
+                                   uint32_t level_index, float u, float v) {
+    const struct texture_level *level = &texture->levels[level_index];
+    if (filter == TEXTURE_FILTER_NEAREST) {
+        return sample_nearest(decode, texture, level, u, v);
+    }
+    return sample_bilinear(decode, texture, level, wrap, u, v);
+}
+
+static inline float wrap_texcoord(float value, enum texture_wrap wrap) {
+    if (wrap == TEXTURE_WRAP_REPEAT) {
+        return value - floorf(value);
+    }
+    return float_clamp01(value);
+}
+
+static inline vector4 sample(texel_decoder decode,
+                             const struct texture *texture,
+                             enum texture_filter filter, enum texture_wrap wrap,
+                             vector2 texcoord, float lod) {
+    float u = wrap_texcoord(texcoord.u, wrap);
+    float v = wrap_texcoord(texcoord.v, wrap);
+    float max_lod = (float)(texture->level_count - 1);
+    lod = float_clamp(lod, 0.0f, max_lod);
+    if (filter == TEXTURE_FILTER_TRILINEAR) {
+        uint32_t level_index = (uint32_t)lod;
+        float t = lod - (float)level_index;
+        vector4 pixel =
+            sample_level(decode, texture, filter, wrap, level_index, u, v);
+        if (t > 0.0f) {
+            vector4 next = sample_level(decode, texture, filter, wrap,
+                                        level_index + 1, u, v);
+            pixel = vector4_lerp(pixel, next, t);
+        }
+        return pixel;
+    }
+    return sample_level(decode, texture, filter, wrap, (uint32_t)(lod + 0.5f),
+                        u, v);
+}
+
+// Computes the level of detail from the derivatives of the texture coordinate,
+// the size is the size of the base level.
+static inline float compute_lod(float width, float height, vector2 ddx,
+                                vector2 ddy) {
+    // Scale the derivatives to texel units of the base level.
+    vector2 dx = (vector2){{ddx.u * width, ddx.v * height}};
+    vector2 dy = (vector2){{ddy.u * width, ddy.v * height}};
+    float rho_squared = float_max(vector2_dot(dx, dx), vector2_dot(dy, dy));
+    // log2(sqrt(x)) = 0.5 * log2(x). If the derivative is 0, the result is
+    // negative infinity and will be clamped to the base level.
+    return 0.5f * log2f(rho_squared);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Batched sampling. The texture coordinates are processed in batches stored as
+// separate arrays of components. The address computation and the blending are
+// simple loops over a batch that the compiler can vectorize, only the texel
+// fetches, which are gathers from unrelated addresses, are done one by one.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define SAMPLE_BATCH_SIZE 8
+
+// Samples count (at most SAMPLE_BATCH_SIZE) texels, the i-th one from the
+// level level_indices[i] at (u[i], v[i]). The result is written to
+// result[component][i].
+static inline void sample_level_batch(
+    texel_decoder decode, const struct texture *texture,
+    enum texture_filter filter, enum texture_wrap wrap, uint32_t count,
+    const uint32_t *level_indices, const float *u, const float *v,
+    float result[4][SAMPLE_BATCH_SIZE]) {
+    const struct texture_level *levels[SAMPLE_BATCH_SIZE];
+    float widths[SAMPLE_BATCH_SIZE];
+    float heights[SAMPLE_BATCH_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        levels[i] = &texture->levels[level_indices[i]];
+        widths[i] = (float)levels[i]->width;
+        heights[i] = (float)levels[i]->height;
+    }
+
+    if (filter == TEXTURE_FILTER_NEAREST) {
+        uint32_t x[SAMPLE_BATCH_SIZE];
+        uint32_t y[SAMPLE_BATCH_SIZE];
+        for (uint32_t i = 0; i < count; i++) {
+            x[i] = uint32_min((uint32_t)(u[i] * widths[i]),
+                              levels[i]->width - 1);
+            y[i] = uint32_min((uint32_t)(v[i] * heights[i]),
+                              levels[i]->height - 1);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            vector4 texel = fetch_texel(decode, texture, levels[i], x[i], y[i]);
+            for (int c = 0; c < 4; c++) {
+                result[c][i] = texel.elements[c];
+            }
+        }
+        return;
+    }
+
+    // Bilinear filtering, see sample_bilinear().
+    float s[SAMPLE_BATCH_SIZE];
+    float t[SAMPLE_BATCH_SIZE];
+    int32_t x_floor[SAMPLE_BATCH_SIZE];
+    int32_t y_floor[SAMPLE_BATCH_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        float x = u[i] * widths[i] - 0.5f;
+        float y = v[i] * heights[i] - 0.5f;
+        float x0 = floorf(x);
+        float y0 = floorf(y);
+        s[i] = x - x0;
+        t[i] = y - y0;
+        x_floor[i] = (int32_t)x0;
+        y_floor[i] = (int32_t)y0;
+    }
+    // The four texels around each coordinate, in the order of bottom-left,
+    // bottom-right, top-left and top-right.
+    float texels[4][4][SAMPLE_BATCH_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        const struct texture_level *level = levels[i];
+        uint32_t x0 = wrap_texel_index(x_floor[i], level->width, wrap);
+        uint32_t x1 = wrap_texel_index(x_floor[i] + 1, level->width, wrap);
+        uint32_t y0 = wrap_texel_index(y_floor[i], level->height, wrap);
+        uint32_t y1 = wrap_texel_index(y_floor[i] + 1, level->height, wrap);
+        vector4 taps[4] = {fetch_texel(decode, texture, level, x0, y0),
+                           fetch_texel(decode, texture, level, x1, y0),
+                           fetch_texel(decode, texture, level, x0, y1),
+                           fetch_texel(decode, texture, level, x1, y1)};
+        for (int tap = 0; tap < 4; tap++) {
+            for (int c = 0; c < 4; c++) {
+                texels[tap][c][i] = taps[tap].elements[c];
+            }
+        }
+    }
+    for (int c = 0; c < 4; c++) {
+        for (uint32_t i = 0; i < count; i++) {
+            float bottom = float_lerp(texels[0][c][i], texels[1][c][i], s[i]);
+            float top = float_lerp(texels[2][c][i], texels[3][c][i], s[i]);
+            result[c][i] = float_lerp(bottom, top, t[i]);
+        }
+    }
+}
+
+// Batched version of sample(), lod may be a null pointer.
+static inline void sample_batch(texel_decoder decode,
+                                const struct texture *texture,
+                                enum texture_filter filter,
+                                enum texture_wrap wrap, size_t count,
+                                const float *u, const float *v,
+                                const float *lod, float *const result[4]) {
+    float max_lod = (float)(texture->level_count - 1);
+    for (size_t first = 0; first < count; first += SAMPLE_BATCH_SIZE) {
+        uint32_t batch_count =
+            (uint32_t)(count - first < SAMPLE_BATCH_SIZE ? count - first
+                                                          : SAMPLE_BATCH_SIZE);
+        float batch_u[SAMPLE_BATCH_SIZE];
+        float batch_v[SAMPLE_BATCH_SIZE];
+        float batch_lod[SAMPLE_BATCH_SIZE];
+        for (uint32_t i = 0; i < batch_count; i++) {
+            batch_u[i] = wrap_texcoord(u[first + i], wrap);
+            batch_v[i] = wrap_texcoord(v[first + i], wrap);
+            float value = lod == NULL ? 0.0f : lod[first + i];
+            batch_lod[i] = float_clamp(value, 0.0f, max_lod);
+        }
+
+        uint32_t level_indices[SAMPLE_BATCH_SIZE];
+        float batch_result[4][SAMPLE_BATCH_SIZE];
+        if (filter != TEXTURE_FILTER_TRILINEAR) {
+            for (uint32_t i = 0; i < batch_count; i++) {
+                level_indices[i] = (uint32_t)(batch_lod[i] + 0.5f);
+            }
+            sample_level_batch(decode, texture, filter, wrap, batch_count,
+                               level_indices, batch_u, batch_v, batch_result);
+        } else {
+            float weights[SAMPLE_BATCH_SIZE];
+            bool has_next_level = false;
+            for (uint32_t i = 0; i < batch_count; i++) {
+                level_indices[i] = (uint32_t)batch_lod[i];
+                weights[i] = batch_lod[i] - (float)level_indices[i];
+                has_next_level |= weights[i] > 0.0f;
+            }
+            sample_level_batch(decode, texture, filter, wrap, batch_count,
+                               level_indices, batch_u, batch_v, batch_result);
+            if (has_next_level) {
+                // The coordinates whose weight is 0 are blended with the same
+                // level, which leaves them unchanged.
+                float next_result[4][SAMPLE_BATCH_SIZE];
+                for (uint32_t i = 0; i < batch_count; i++) {
+                    level_indices[i] += weights[i] > 0.0f ? 1 : 0;
+                }
+                sample_level_batch(decode, texture, filter, wrap, batch_count,
+                                   level_indices, batch_u, batch_v,
+                                   next_result);
+                for (int c = 0; c < 4; c++) {
+                    for (uint32_t i = 0; i < batch_count; i++) {
+                        batch_result[c][i] =
+                            float_lerp(batch_result[c][i], next_result[c][i],
+                                       weights[i]);
+                    }
+                }
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            if (result[c] == NULL) {
+                continue;
+            }
+            for (uint32_t i = 0; i < batch_count; i++) {
+                result[c][first + i] = batch_result[c][i];
+            }
+        }
+    }
+}
+
+vector4 texture_sample(const struct texture *texture, vector2 texcoord) {
+    return texture_sample_lod(texture, texcoord, 0.0f);
+}
+
+vector4 texture_sample_lod(const struct texture *texture, vector2 texcoord,
+                           float lod) {
+    texel_decoder decode = get_texel_decoder(texture->format);
+    if (decode == NULL) {
+        return VECTOR4_ZERO;
+    }
+    return sample(decode, texture, texture->filter, TEXTURE_WRAP_CLAMP,
+                  texcoord, lod);
+}
+
+vector4 texture_sample_grad(const struct texture *texture, vector2 texcoord,
+                            vector2 ddx, vector2 ddy) {
+    float width = (float)texture->levels[0].width;
+    float height = (float)texture->levels[0].height;
+    float lod = compute_lod(width, height, ddx, ddy);
+    return texture_sample_lod(texture, texcoord, lod);
+}
+
+bool is_texture_constant(const struct texture *texture, vector4 *value) {
+    if (texture == NULL || texture->pages != NULL) {
+        return false;
+    }
+    texel_decoder decode = get_texel_decoder(texture->format);
+    if (decode == NULL) {
+        return false;
+    }
+    // Compares the decoded texels, so that the value is what sampling returns
+    // and texels that differ only in padding bits are equal.
+    const struct texture_level *base = &texture->levels[0];
+    vector4 first = fetch_texel(decode, texture, base, 0, 0);
+    for (uint32_t y = 0; y < base->height; y++) {
+        for (uint32_t x = 0; x < base->width; x++) {
+            vector4 texel = fetch_texel(decode, texture, base, x, y);
+            for (int c = 0; c < 4; c++) {
+                if (texel.elements[c] != first.elements[c]) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (value != NULL) {
+        *value = first;
+    }
+    return true;
+}
+
+void texture_sample_n(const struct texture *texture, size_t count,
+                      const float *u, const float *v, const float *lod,
+                      float *r, float *g, float *b, float *a) {
+    texel_decoder decode = get_texel_decoder(texture->format);
+    float *const result[4] = {r, g, b, a};
+    if (decode == NULL) {
+        for (int c = 0; c < 4; c++) {
+            if (result[c] != NULL) {
+                memset(result[c], 0, count * sizeof(float));
+            }
+        }
+        return;
+    }
+    sample_batch(decode, texture, texture->filter, TEXTURE_WRAP_CLAMP, count,
+                 u, v, lod, result);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Samplers.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Defines the sampling functions of a format for each filter, such as
+// sampler_r8_nearest(), sampler_r8_bilinear() and sampler_r8_trilinear().
+#define DEFINE_SAMPLERS(name)                                                 \
+    static vector4 sampler_##name##_nearest(const struct sampler *sampler,   \
+                                            vector2 texcoord, float lod) {   \
+        return sample(decode_##name, sampler->texture,                        \
+                      TEXTURE_FILTER_NEAREST, sampler->wrap, texcoord, lod);  \
+    }                                                                         \
+    static vector4 sampler_##name##_bilinear(const struct sampler *sampler,  \
+                                             vector2 texcoord, float lod) {  \
+        return sample(decode_##name, sampler->texture,                        \
+                      TEXTURE_FILTER_BILINEAR, sampler->wrap, texcoord, lod); \
+    }                                                                         \
+    static vector4 sampler_##name##_trilinear(const struct sampler *sampler, \
+                                              vector2 texcoord, float lod) { \
+        return sample(decode_##name, sampler->texture,                        \
+                      TEXTURE_FILTER_TRILINEAR, sampler->wrap, texcoord,      \
+                      lod);                                                   \
+    }                                                                         \
+    static void sampler_##name##_n(                                           \
+        const struct sampler *sampler, size_t count, const float *u,          \
+        const float *v, const float *lod, float *const result[4]) {           \
+        sample_batch(decode_##name, sampler->texture, sampler->filter,        \
+                     sampler->wrap, count, u, v, lod, result);                \
+    }
+
+DEFINE_SAMPLERS(r8)
+DEFINE_SAMPLERS(rgb8)
+DEFINE_SAMPLERS(srgb8)
+DEFINE_SAMPLERS(rgba8)
+DEFINE_SAMPLERS(srgb8_a8)
+DEFINE_SAMPLERS(depth_float)
+DEFINE_SAMPLERS(rgba16f)
+DEFINE_SAMPLERS(r11g11b10f)
+DEFINE_SAMPLERS(bc1)
+DEFINE_SAMPLERS(bc1_srgb)
+DEFINE_SAMPLERS(bc4)
+DEFINE_SAMPLERS(bc5)
+
+#define SAMPLERS(name)                                   \
+    {                                                    \
+        sampler_##name##_nearest, sampler_##name##_bilinear, \
+            sampler_##name##_trilinear                   \
+    }
+
+// The sampling functions indexed by format and filter.
+static const sampler_function samplers[][3] = {
+    [TEXTURE_FORMAT_R8] = SAMPLERS(r8),
+    [TEXTURE_FORMAT_RGB8] = SAMPLERS(rgb8),
+    [TEXTURE_FORMAT_SRGB8] = SAMPLERS(srgb8),
+    [TEXTURE_FORMAT_RGBA8] = SAMPLERS(rgba8),
+    [TEXTURE_FORMAT_SRGB8_A8] = SAMPLERS(srgb8_a8),
+    [TEXTURE_FORMAT_DEPTH_FLOAT] = SAMPLERS(depth_float),
+    [TEXTURE_FORMAT_RGBA16F] = SAMPLERS(rgba16f),
+    [TEXTURE_FORMAT_R11G11B10F] = SAMPLERS(r11g11b10f),
+    [TEXTURE_FORMAT_BC1] = SAMPLERS(bc1),
+    [TEXTURE_FORMAT_BC1_SRGB] = SAMPLERS(bc1_srgb),
+    [TEXTURE_FORMAT_BC4] = SAMPLERS(bc4),
+    [TEXTURE_FORMAT_BC5] = SAMPLERS(bc5)};
+
+// The batched sampling functions indexed by format.
+static const sampler_batch_function batch_samplers[] = {
+    [TEXTURE_FORMAT_R8] = sampler_r8_n,
+    [TEXTURE_FORMAT_RGB8] = sampler_rgb8_n,
+    [TEXTURE_FORMAT_SRGB8] = sampler_srgb8_n,
+    [TEXTURE_FORMAT_RGBA8] = sampler_rgba8_n,
+    [TEXTURE_FORMAT_SRGB8_A8] = sampler_srgb8_a8_n,
+    [TEXTURE_FORMAT_DEPTH_FLOAT] = sampler_depth_float_n,
+    [TEXTURE_FORMAT_RGBA16F] = sampler_rgba16f_n,
+    [TEXTURE_FORMAT_R11G11B10F] = sampler_r11g11b10f_n,
+    [TEXTURE_FORMAT_BC1] = sampler_bc1_n,
+    [TEXTURE_FORMAT_BC1_SRGB] = sampler_bc1_srgb_n,
+    [TEXTURE_FORMAT_BC4] = sampler_bc4_n,
+    [TEXTURE_FORMAT_BC5] = sampler_bc5_n};
+
+// Gets the index of a texel on a row or column of the given size. Unlike
+// wrap_texel_index(), the index may be any number of texels out of range.
+static inline uint32_t wrap_kernel_texel_index(int32_t index, uint32_t size,
+                                               enum texture_wrap wrap) {
+    if (wrap == TEXTURE_WRAP_REPEAT) {
+        int32_t remainder = index % (int32_t)size;
+        return (uint32_t)(remainder < 0 ? remainder + (int32_t)size
+                                        : remainder);
+    }
+    return (uint32_t)int32_clamp(index, 0, (int32_t)size - 1);
+}
+
+static inline float compare_depth(const struct texture *texture, uint32_t x,
+                                  uint32_t y, float reference) {
+    float depth =
+        fetch_texel(decode_depth_float, texture, &texture->levels[0], x, y).r;
+    return reference <= depth ? 1.0f : 0.0f;
+}
+
+static float sampler_depth_float_compare_nearest(const struct sampler *sampler,
+                                                 vector2 texcoord,
+                                                 float reference) {
+    const struct texture *texture = sampler->texture;
+    float u = wrap_texcoord(texcoord.u, sampler->wrap);
+    float v = wrap_texcoord(texcoord.v, sampler->wrap);
+    float depth =
+        sample_nearest(decode_depth_float, texture, &texture->levels[0], u, v)
+            .r;
+    return reference <= depth ? 1.0f : 0.0f;
+}
+
+// Percentage closer filtering over the 2x2 texels around the texture
+// coordinate. The results of the four comparisons are bilinearly interpolated,
+// like the comparison samplers of GPUs do.
+static float sampler_depth_float_compare_bilinear(const struct sampler *sampler,
+                                                  vector2 texcoord,
+                                                  float reference) {
+    return sampler_sample_compare_pcf(sampler, texcoord, reference, 0);
+}
+
+// Tests the depth bounds of the texels from (min_x, min_y) to (max_x, max_y) of
+// the base level against the reference. Returns 1 if all texels pass the
+// comparison, 0 if all texels fail, or a negative number if the texels must be
+// compared one by one.
+static float compare_depth_bounds(const struct depth_bounds *depth_bounds,
+                                  int32_t min_x, int32_t min_y, int32_t max_x,
+                                  int32_t max_y, float reference) {
+    if (depth_bounds == NULL || !depth_bounds->is_valid || min_x < 0 ||
+        min_y < 0 || (uint32_t)max_x >= depth_bounds->widths[0] ||
+        (uint32_t)max_y >= depth_bounds->heights[0]) {
+        return -1.0f;
+    }
+    // Find the first level in which the region is covered by at most 2x2
+    // texels.
+    uint32_t level = 1;
+    while ((max_x >> level) - (min_x >> level) > 1 ||
+           (max_y >> level) - (min_y >> level) > 1) {
+        level++;
+    }
+    if (level >= depth_bounds->level_count) {
+        level = depth_bounds->level_count - 1;
+    }
+    uint32_t width = depth_bounds->widths[level];
+    float min_depth = INFINITY;
+    float max_depth = -INFINITY;
+    for (int32_t y = min_y >> level; y <= max_y >> level; y++) {
+        for (int32_t x = min_x >> level; x <= max_x >> level; x++) {
+            const float *bounds =
+                depth_bounds->bounds[level][(size_t)y * width + (size_t)x];
+            min_depth = float_min(min_depth, bounds[0]);
+            max_depth = float_max(max_depth, bounds[1]);
+        }
+    }
+    if (reference <= min_depth) {
+        return 1.0f;
+    }
+    if (reference > max_depth) {
+        return 0.0f;
+    }
+    return -1.0f;
+}
+
+bool bind_sampler(struct sampler *sampler, const struct texture *texture,
+                  enum texture_filter filter, enum texture_wrap wrap) {
+    if (sampler == NULL || texture == NULL) {
+        return false;
+    }
+    if (filter != TEXTURE_FILTER_NEAREST && filter != TEXTURE_FILTER_BILINEAR &&
+        filter != TEXTURE_FILTER_TRILINEAR) {
+        return false;
+    }
+    if (wrap != TEXTURE_WRAP_CLAMP && wrap != TEXTURE_WRAP_REPEAT) {
+        return false;
+    }
+    size_t format_count = sizeof(samplers) / sizeof(samplers[0]);
+    if ((size_t)texture->format >= format_count) {
+        return false;
+    }
+    sampler->texture = texture;
+    sampler->filter = filter;
+    sampler->wrap = wrap;
+    sampler->width = (float)texture->levels[0].width;
+    sampler->height = (float)texture->levels[0].height;
+    sampler->sample = samplers[texture->format][filter];
+    sampler->sample_n = batch_samplers[texture->format];
+    if (texture->format == TEXTURE_FORMAT_DEPTH_FLOAT) {
+        sampler->compare = filter == TEXTURE_FILTER_NEAREST
+                               ? sampler_depth_float_compare_nearest
+                               : sampler_depth_float_compare_bilinear;
+    } else {
+        sampler->compare = NULL;
+    }
+    return true;
+}
+
+void unbind_sampler(struct sampler *sampler) {
+    if (sampler != NULL) {
+        sampler->texture = NULL;
+        sampler->sample = NULL;
+        sampler->sample_n = NULL;
+        sampler->compare = NULL;
+    }
+}
+
+vector4 sampler_sample(const struct sampler *sampler, vector2 texcoord) {
+    return sampler->sample(sampler, texcoord, 0.0f);
+}
+
+vector4 sampler_sample_lod(const struct sampler *sampler, vector2 texcoord,
+                           float lod) {
+    return sampler->sample(sampler, texcoord, lod);
+}
+
+vector4 sampler_sample_grad(const struct sampler *sampler, vector2 texcoord,
+                            vector2 ddx, vector2 ddy) {
+    float lod = compute_lod(sampler->width, sampler->height, ddx, ddy);
+    return sampler->sample(sampler, texcoord, lod);
+}
+
+void sampler_sample_n(const struct sampler *sampler, size_t count,
+                      const float *u, const float *v, const float *lod,
+                      float *r, float *g, float *b, float *a) {
+    float *const result[4] = {r, g, b, a};
+    sampler->sample_n(sampler, count, u, v, lod, result);
+}
+
+float sampler_sample_compare(const struct sampler *sampler, vector2 texcoord,
+                             float reference) {
+    return sampler->compare(sampler, texcoord, reference);
+}
+
+float sampler_sample_compare_pcf(const struct sampler *sampler,
+                                 vector2 texcoord, float reference,
+                                 uint32_t radius) {
+    const struct texture *texture = sampler->texture;
+    const struct texture_level *base = &texture->levels[0];
+    float u = wrap_texcoord(texcoord.u, sampler->wrap);
+    float v = wrap_texcoord(texcoord.v, sampler->wrap);
+    // The 2x2 bilinear footprints of the (2r+1)x(2r+1) taps overlap, together
+    // they cover (2r+2)x(2r+2) texels. Each texel is weighted by the sum of
+    // its bilinear weights in all taps that cover it: the inner texels are
+    // covered by taps with weights adding up to one, only the texels on the
+    // border have fractional weights. The weights are separable.
+    float x = u * base->width - 0.5f;
+    float y = v * base->height - 0.5f;
+    float x_floor = floorf(x);
+    float y_floor = floorf(y);
+    float s = x - x_floor;
+    float t = y - y_floor;
+    int32_t size = (int32_t)radius * 2 + 2;
+    int32_t min_x = (int32_t)x_floor - (int32_t)radius;
+    int32_t min_y = (int32_t)y_floor - (int32_t)radius;
+
+    // Fully lit or fully shadowed regions skip the kernel. A 2x2 kernel costs
+    // about as much as the test.
+    if (radius > 0) {
+        float bounds_result = compare_depth_bounds(
+            texture->depth_bounds, min_x, min_y, min_x + size - 1,
+            min_y + size - 1, reference);
+        if (bounds_result >= 0.0f) {
+            return bounds_result;
+        }
+    }
+
+    float sum = 0.0f;
+    for (int32_t j = 0; j < size; j++) {
+        uint32_t texel_y =
+            wrap_kernel_texel_index(min_y + j, base->height, sampler->wrap);
+        float row_sum = 0.0f;
+        for (int32_t i = 0; i < size; i++) {
+            uint32_t texel_x =
+                wrap_kernel_texel_index(min_x + i, base->width, sampler->wrap);
+            float weight =
+                (i < size - 1 ? 1.0f - s : 0.0f) + (i > 0 ? s : 0.0f);
+            row_sum += weight * compare_depth(texture, texel_x, texel_y,
+                                              reference);
+        }
+        float weight = (j < size - 1 ? 1.0f - t : 0.0f) + (j > 0 ? t : 0.0f);
+        sum += weight * row_sum;
+    }
+    float tap_count = (float)((size - 1) * (size - 1));
+    return sum / tap_count;
 }
@@ -7,10 +7,20 @@
 #define FOOLRENDERER_GRAPHICS_TEXTURE_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "math/vector.h"
 
+// The number of samples of a pixel in the multisampled formats.
+#define TEXTURE_SAMPLE_COUNT 4
+// The width and height of a tile in TEXTURE_LAYOUT_TILED, in texels.
+#define TEXTURE_TILE_SIZE 4
+// The width and height of a tile of a deferred clear, see clear_texture(). A
+// multiple of TEXTURE_TILE_SIZE, so that the tiles of TEXTURE_LAYOUT_TILED are
+// cleared whole.
+#define TEXTURE_CLEAR_TILE_SIZE 32
+
 enum texture_format {
     ///
     /// The format has only an R component, the type is 8-bit unsigned integer.
@@ -42,20 +52,157 @@ enum texture_format {
     ///
     /// The format used to store depth information, the type is float.
     ///
-    TEXTURE_FORMAT_DEPTH_FLOAT
+    TEXTURE_FORMAT_DEPTH_FLOAT,
+    ///
+    /// The components included in this format are R, G, B, A, and each
+    /// component is a 16-bit half precision float. Used for high dynamic range
+    /// color buffers, the color values are linear and not limited to [0,1].
+    ///
+    TEXTURE_FORMAT_RGBA16F,
+    ///
+    /// The components included in this format are R, G, B, packed in 32 bits:
+    /// R and G are 11-bit unsigned floats, B is a 10-bit unsigned float. A
+    /// compact alternative to TEXTURE_FORMAT_RGBA16F for color buffers that do
+    /// not need alpha or negative values.
+    ///
+    TEXTURE_FORMAT_R11G11B10F,
+    ///
+    /// Block compressed format, each 4x4 block of texels is stored in 8 bytes.
+    /// The components included in this format are R, G, B. Refer to
+    /// graphics/block_compression.h for the encoding.
+    ///
+    TEXTURE_FORMAT_BC1,
+    ///
+    /// Same as TEXTURE_FORMAT_BC1, but the three components are considered to
+    /// be encoded in the sRGB color space.
+    ///
+    TEXTURE_FORMAT_BC1_SRGB,
+    ///
+    /// Block compressed format, each 4x4 block of texels is stored in 8 bytes.
+    /// The format has only an R component.
+    ///
+    TEXTURE_FORMAT_BC4,
+    ///
+    /// Block compressed format made of two BC4 blocks, each 4x4 block of texels
+    /// is stored in 16 bytes. The components included in this format are R and
+    /// G. This format is intended for normal maps: when sampled, the B
+    /// component is reconstructed assuming that the texel is a unit vector
+    /// whose components are mapped from [-1,1] to [0,1].
+    ///
+    TEXTURE_FORMAT_BC5,
+    ///
+    /// Multisampled color buffer format, each pixel has four samples in
+    /// TEXTURE_FORMAT_RGBA16F. The samples are stored in four planes, plane i
+    /// holding sample i of every pixel like a TEXTURE_FORMAT_RGBA16F texture.
+    /// The planes are followed by one byte per pixel, which is not 0 if the
+    /// pixel is compressed: all its samples are the color in plane 0, and the
+    /// other planes are out of date for it. A compressed pixel is written and
+    /// resolved by touching plane 0 only.
+    ///
+    /// Textures in this format cannot be sampled, use
+    /// resolve_multisample_texture() to average the samples.
+    ///
+    TEXTURE_FORMAT_RGBA16F_4X,
+    ///
+    /// Multisampled depth buffer format, each pixel has four samples in
+    /// TEXTURE_FORMAT_DEPTH_FLOAT, stored next to each other.
+    ///
+    /// Textures in this format cannot be sampled.
+    ///
+    TEXTURE_FORMAT_DEPTH_FLOAT_4X
+};
+
+enum texture_filter {
+    ///
+    /// Uses the value of the texel nearest to the texture coordinate, from the
+    /// mipmap level nearest to the level of detail.
+    ///
+    TEXTURE_FILTER_NEAREST,
+    ///
+    /// Uses the weighted average of the four texels nearest to the texture
+    /// coordinate, from the mipmap level nearest to the level of detail.
+    ///
+    TEXTURE_FILTER_BILINEAR,
+    ///
+    /// Performs bilinear filtering in the two mipmap levels nearest to the
+    /// level of detail, then linearly interpolates between the two results.
+    ///
+    TEXTURE_FILTER_TRILINEAR
+};
+
+enum texture_wrap {
+    ///
+    /// Texture coordinates are clamped to [0,1], and filtering reuses the
+    /// texels on the edges of the texture.
+    ///
+    TEXTURE_WRAP_CLAMP,
+    ///
+    /// Only the fractional part of texture coordinates is used, so the texture
+    /// repeats, and filtering wraps around to the opposite edges.
+    ///
+    TEXTURE_WRAP_REPEAT
+};
+
+enum texture_layout {
+    ///
+    /// Texels are stored row by row, starting from the bottom-left corner. This
+    /// is the layout of the pixel data passed to set_texture_pixels().
+    ///
+    TEXTURE_LAYOUT_LINEAR,
+    ///
+    /// Texels are grouped into 4x4 tiles, each tile is stored contiguously and
+    /// the tiles are stored row by row. Texels of RGB formats are padded to 4
+    /// bytes. Texels that are close in both directions are close in memory,
+    /// which makes sampling friendlier to the cache than the linear layout.
+    /// Within a tile, the texels are stored row by row, see
+    /// get_tiled_texel_index().
+    ///
+    TEXTURE_LAYOUT_TILED
 };
 
+///
+/// \brief Gets the index of the texel at (x, y) in a level stored in
+///        TEXTURE_LAYOUT_TILED.
+///
+/// The tiles of a row cover the width of the level rounded up to a multiple of
+/// TEXTURE_TILE_SIZE. The pixels of a row of a tile are next to each other.
+///
+/// \param width The width of the level.
+/// \param x The x coordinate of the texel.
+/// \param y The y coordinate of the texel.
+/// \return Returns the index of the texel, in texels.
+///
+inline size_t get_tiled_texel_index(uint32_t width, uint32_t x, uint32_t y) {
+    size_t tiles_per_row = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    size_t tile_index = (size_t)(y / TEXTURE_TILE_SIZE) * tiles_per_row +
+                        x / TEXTURE_TILE_SIZE;
+    return tile_index * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE +
+           (y % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + x % TEXTURE_TILE_SIZE;
+}
+
 ///
 /// \brief A texture is an object that saves image pixel data in a specific
 ///        format.
 ///
 /// The first pixel corresponds to the bottom-left corner of the texture image.
 ///
+/// Besides the base image (level 0), a texture may contain a mipmap chain. Each
+/// level is half the size of the previous one in each dimension, rounded down
+/// but at least 1, until the size of the last level is 1x1.
+///
+/// How the texels are arranged in memory is determined by the texture layout.
+/// The layout is internal to the texture: pixel data is always passed to and
+/// read from the texture in the linear layout.
+///
 struct texture;
 
 ///
 /// \brief Creates a texture.
 ///
+/// The layout of the created texture is TEXTURE_LAYOUT_LINEAR, except for block
+/// compressed formats whose layout is always TEXTURE_LAYOUT_TILED, each tile
+/// being a compressed block.
+///
 /// Returns a null pointer if the width or height value is equal to 0. Returns a
 /// null pointer if the internal_format parameter is an invalid value. Returns a
 /// null pointer if memory allocation fails.
@@ -69,7 +216,47 @@ struct texture *create_texture(enum texture_format internal_format,
                                uint32_t width, uint32_t height);
 
 ///
-/// \brief Destroys the texture created by create_texture().
+/// \brief Releases a buffer handed over to create_texture_from_buffer().
+///
+/// \param pixels The buffer to release.
+/// \param user_data The user_data passed to create_texture_from_buffer().
+///
+typedef void (*texture_buffer_free_function)(void *pixels, void *user_data);
+
+///
+/// \brief Creates a texture that uses the given buffer as its base level,
+///        without copying it.
+///
+/// The buffer holds the base level in the same arrangement as the pixel data
+/// passed to set_texture_pixels(). The layout of the created texture is the
+/// same as that of create_texture().
+///
+/// If free_buffer is not a null pointer, the texture takes ownership of the
+/// buffer and calls free_buffer with the buffer and user_data once it no
+/// longer needs it: when the texture is destroyed, or earlier if a layout
+/// change moves the base level to a new storage. Otherwise, the buffer stays
+/// owned by the caller and must outlive the texture.
+///
+/// Returns a null pointer in the same cases as create_texture(), or if pixels
+/// is a null pointer. On failure the ownership of the buffer is not taken. The
+/// behavior is undefined if the size of the buffer is smaller than the data
+/// size required by the texture.
+///
+/// \param internal_format The pixel format used internally by the texture.
+/// \param width The width of the texture.
+/// \param height The height of the texture.
+/// \param pixels The buffer holding the pixels of the base level.
+/// \param free_buffer The function releasing the buffer, may be a null pointer.
+/// \param user_data Passed to free_buffer.
+/// \return Returns a texture pointer on success, null pointer on failure.
+///
+struct texture *create_texture_from_buffer(
+    enum texture_format internal_format, uint32_t width, uint32_t height,
+    void *pixels, texture_buffer_free_function free_buffer, void *user_data);
+
+///
+/// \brief Destroys the texture created by create_texture() or other texture
+///        creation functions.
 ///
 /// If texture is a null pointer, the function does nothing.
 ///
@@ -82,9 +269,17 @@ void destroy_texture(struct texture *texture);
 ///
 /// The origin of the image should be in the bottom-left corner.
 ///
-/// If texture or pixels is a null pointer, the data write fails. The behavior
-/// is undefined if the size of the array pointed to by the pixels is smaller
-/// than the data size required by the texture.
+/// The pixel data is converted to the layout of the texture. If the texture
+/// contains a mipmap chain, the chain is regenerated from the new pixel data.
+///
+/// For block compressed formats, the pixel data is the compressed blocks of the
+/// base level, stored row by row starting from the bottom-left block. Blocks
+/// cannot be averaged, so the mipmap chain of the texture is discarded.
+///
+/// If texture or pixels is a null pointer, the data write fails. Fails if the
+/// texture is a virtual texture. The behavior is undefined if the size of the
+/// array pointed to by the pixels is smaller than the data size required by
+/// the texture.
 ///
 /// \param texture The texture pointer.
 /// \param pixels Pointer to the pixel data source.
@@ -92,16 +287,403 @@ void destroy_texture(struct texture *texture);
 ///
 bool set_texture_pixels(struct texture *texture, const void *pixels);
 
+///
+/// \brief Copies the pixel data of a rectangle into the base level of the
+///        texture.
+///
+/// The rectangle starts at (x, y), counted from the bottom-left corner of the
+/// texture. The pixel data is stored row by row starting from the bottom row,
+/// each row is width pixels long. Only the texels of the mipmap chain covered
+/// by the rectangle are updated, the rest of the texture is left unchanged.
+///
+/// If texture or pixels is a null pointer, the data write fails. Fails if the
+/// rectangle is empty or not entirely inside the texture. Fails if the texture
+/// is a virtual texture or has a block compressed or multisampled format.
+///
+/// \param texture The texture pointer.
+/// \param x The x coordinate of the bottom-left corner of the rectangle.
+/// \param y The y coordinate of the bottom-left corner of the rectangle.
+/// \param width The width of the rectangle.
+/// \param height The height of the rectangle.
+/// \param pixels Pointer to the pixel data source.
+/// \return Returns true on success, false on failure.
+///
+bool set_texture_subimage(struct texture *texture, uint32_t x, uint32_t y,
+                          uint32_t width, uint32_t height, const void *pixels);
+
+///
+/// \brief Copies the base level of a texture into another texture.
+///
+/// The pixels are converted to the layout of the target. If the target
+/// contains a mipmap chain, the chain is regenerated from the new pixel data.
+/// Up-to-date depth bounds of the source are copied as well, see
+/// generate_texture_depth_bounds(). The tiles whose clear the source defers
+/// stay deferred in the target, see clear_texture().
+///
+/// Fails if target or source is a null pointer. Fails if the textures differ in
+/// format or in the size of the base level. Fails if the format is block
+/// compressed. Fails if either texture is a virtual texture. Fails if memory
+/// allocation fails.
+///
+/// \param target The texture to copy to.
+/// \param source The texture to copy from.
+/// \return Returns true on success, false on failure.
+///
+bool copy_texture(struct texture *target, const struct texture *source);
+
+///
+/// \brief Generates the mipmap chain of the texture from its base level.
+///
+/// Each texel of a level is the average of the corresponding 2x2 texels of the
+/// previous level. For sRGB encoded formats, the color components are averaged
+/// in linear color space.
+///
+/// Fails if texture is a null pointer. Fails if the texture format is
+/// TEXTURE_FORMAT_DEPTH_FLOAT, because averaging depth values is meaningless.
+/// Fails if the texture format is TEXTURE_FORMAT_RGBA16F or
+/// TEXTURE_FORMAT_R11G11B10F or multisampled, these formats are meant for
+/// render targets.
+/// Fails if the texture format is block compressed, use compress_texture() on
+/// a texture with a mipmap chain instead. Fails if the texture is a virtual
+/// texture. Fails if memory allocation fails.
+///
+/// \param texture The texture pointer.
+/// \return Returns true on success, false on failure.
+///
+bool generate_texture_mipmaps(struct texture *texture);
+
+///
+/// \brief Generates the min/max depth pyramid of a depth texture.
+///
+/// Each texel of level i of the pyramid holds the minimum and maximum depth of
+/// the corresponding 2^i x 2^i texels of the base level. The pyramid lets
+/// sampler_sample_compare_pcf() skip the comparisons of regions that are
+/// entirely lit or entirely in shadow.
+///
+/// The pyramid is not updated automatically. Any function that may modify the
+/// base level, including get_texture_pixels(), marks it out of date, and it is
+/// not used until this function is called again. Call it after rendering to
+/// the depth texture.
+///
+/// Fails if texture is a null pointer. Fails if the texture format is not
+/// TEXTURE_FORMAT_DEPTH_FLOAT. Fails if memory allocation fails.
+///
+/// \param texture The texture pointer.
+/// \return Returns true on success, false on failure.
+///
+bool generate_texture_depth_bounds(struct texture *texture);
+
 ///
 /// \brief Gets pixel data in the texture.
 ///
-/// If texture is a null pointer, returns a null pointer.
+/// The pixel data of the base level is returned in the linear layout. For a
+/// texture in the linear layout, the pointer points to the storage of the
+/// texture, so the texture can be modified through it. For a texture in other
+/// layouts, the pixel data is converted into a buffer owned by the texture;
+/// modifying the buffer does not modify the texture, and the buffer is valid
+/// until the next call to this function or until the texture is destroyed.
+/// For block compressed formats, the pointer points to the compressed blocks.
+/// For multisampled formats, the pointer points to the samples arranged as
+/// described by the format.
+///
+/// If texture is a null pointer, returns a null pointer. Returns a null pointer
+/// if the texture is a virtual texture. Returns a null pointer if memory
+/// allocation fails.
 ///
 /// \param texture Pointer to the texture to get.
 /// \return Returns a pixel data pointer on success, null pointer on failure.
 ///
 void *get_texture_pixels(struct texture *texture);
 
+///
+/// \brief Clears a rectangle of the base level of the texture to a value,
+///        deferring the writes where possible.
+///
+/// The base level is divided into tiles of TEXTURE_CLEAR_TILE_SIZE x
+/// TEXTURE_CLEAR_TILE_SIZE texels. The tiles entirely inside the rectangle are
+/// only marked as cleared, the texels of the rectangle in other tiles are
+/// written at once. Clearing costs a flag per tile, and tiles that are never
+/// drawn to or read back are never written. The texture holds a single clear
+/// value: clearing to another value writes the tiles still marked with the
+/// previous one.
+///
+/// The marked tiles are written by the rasterizer when it first draws to them,
+/// by the readback with get_texture_pixels(), and by the other functions of
+/// this file that modify the texture. The functions taking a constant texture,
+/// including sampling and copy_texture() for its source, read the clear value
+/// for the marked tiles and never write to the texture. Code writing the pixels
+/// through get_texture_storage() must call flush_texture_clear() on the texels
+/// it is about to access, code reading them through
+/// get_texture_storage_const() reads the marked tiles with
+/// get_texture_clear_texel().
+///
+/// The value points to one pixel in the format of the texture. For
+/// multisampled formats, it points to one sample, which every sample is set
+/// to, and the pixels of TEXTURE_FORMAT_RGBA16F_4X are compressed. The mipmap
+/// chain is not updated.
+///
+/// Fails if texture or value is a null pointer. Fails if the rectangle is empty
+/// or not entirely inside the texture. Fails if the texture is a virtual
+/// texture or has a block compressed format. Fails if memory allocation fails.
+///
+/// \param texture The texture pointer.
+/// \param x The x coordinate of the bottom-left corner of the rectangle.
+/// \param y The y coordinate of the bottom-left corner of the rectangle.
+/// \param width The width of the rectangle.
+/// \param height The height of the rectangle.
+/// \param value Pointer to the clear value.
+/// \return Returns true on success, false on failure.
+///
+bool clear_texture(struct texture *texture, uint32_t x, uint32_t y,
+                   uint32_t width, uint32_t height, const void *value);
+
+///
+/// \brief Writes the deferred clear of the tiles overlapping a rectangle of the
+///        base level, see clear_texture().
+///
+/// The parts of the rectangle outside the texture are ignored. If texture is a
+/// null pointer or the rectangle is empty, the function does nothing.
+///
+/// \param texture The texture pointer.
+/// \param x The x coordinate of the bottom-left corner of the rectangle.
+/// \param y The y coordinate of the bottom-left corner of the rectangle.
+/// \param width The width of the rectangle.
+/// \param height The height of the rectangle.
+///
+void flush_texture_clear(struct texture *texture, uint32_t x, uint32_t y,
+                         uint32_t width, uint32_t height);
+
+///
+/// \brief Gets the storage of the base level of the texture, without writing
+///        its deferred clear.
+///
+/// Unlike get_texture_pixels(), the pixels are in the layout of the texture,
+/// and the tiles marked by clear_texture() hold stale texels until
+/// flush_texture_clear() writes them. Meant for renderers writing to the
+/// texture in place, which flush the tiles they touch.
+///
+/// If texture is a null pointer, returns a null pointer. Returns a null pointer
+/// if the texture is a virtual texture.
+///
+/// \param texture The texture pointer.
+/// \return Returns a pixel data pointer on success, null pointer on failure.
+///
+void *get_texture_storage(struct texture *texture);
+
+///
+/// \brief Gets the storage of the base level of the texture for reading.
+///
+/// The same pixels as get_texture_storage(), but the texture is not modified.
+/// The tiles marked by clear_texture() hold stale texels, the readers get their
+/// value from get_texture_clear_texel() instead.
+///
+/// If texture is a null pointer, returns a null pointer. Returns a null pointer
+/// if the texture is a virtual texture.
+///
+/// \param texture The texture pointer.
+/// \return Returns a pixel data pointer on success, null pointer on failure.
+///
+const void *get_texture_storage_const(const struct texture *texture);
+
+///
+/// \brief Gets the texel a deferred clear leaves at a texel of the base level.
+///
+/// Returns the texel the clear leaves at (x, y) if its tile is still marked by
+/// clear_texture(), in which case the texel in the storage is stale. The
+/// returned texel is in the storage format of the texture, with its padding,
+/// and is the same for all texels of a tile of TEXTURE_CLEAR_TILE_SIZE x
+/// TEXTURE_CLEAR_TILE_SIZE texels. For TEXTURE_FORMAT_RGBA16F_4X it is the
+/// color of a compressed pixel, in TEXTURE_FORMAT_RGBA16F.
+///
+/// Returns a null pointer if the texel is not in a marked tile, and the
+/// storage holds its value. Returns a null pointer if texture is a null
+/// pointer or the texel is outside the texture.
+///
+/// \param texture The texture pointer.
+/// \param x The x coordinate of the texel.
+/// \param y The y coordinate of the texel.
+/// \return Returns a pointer to the texel, or a null pointer.
+///
+const void *get_texture_clear_texel(const struct texture *texture, uint32_t x,
+                                    uint32_t y);
+
+///
+/// \brief Rearranges the texels of the texture, including the mipmap chain, to
+///        the specified layout.
+///
+/// Fails if texture is a null pointer. Fails if the layout is an invalid value.
+/// Fails if the texture format is block compressed and the layout is not
+/// TEXTURE_LAYOUT_TILED. Fails if the texture is a virtual texture and the
+/// layout is not TEXTURE_LAYOUT_TILED. Fails if the texture format is
+/// multisampled and the layout is not TEXTURE_LAYOUT_LINEAR. Fails if memory
+/// allocation fails, in which case the texture is unchanged.
+///
+/// \param texture The texture pointer.
+/// \param layout The new layout.
+/// \return Returns true on success, false on failure.
+///
+bool set_texture_layout(struct texture *texture, enum texture_layout layout);
+
+///
+/// \brief Creates a block compressed copy of the texture.
+///
+/// Each level of the source texture, including the mipmap chain, is encoded to
+/// the compressed format. The filter of the copy is the same as the source.
+/// This is slow and is intended to be done once when importing assets. Valid
+/// source formats for each compressed format are:
+///
+/// Compressed Format       | Source Format
+/// ----------------------- | --------------------------------------------
+/// TEXTURE_FORMAT_BC1      | TEXTURE_FORMAT_RGB8, TEXTURE_FORMAT_RGBA8
+/// TEXTURE_FORMAT_BC1_SRGB | TEXTURE_FORMAT_SRGB8, TEXTURE_FORMAT_SRGB8_A8
+/// TEXTURE_FORMAT_BC4      | TEXTURE_FORMAT_R8
+/// TEXTURE_FORMAT_BC5      | TEXTURE_FORMAT_RGB8, TEXTURE_FORMAT_RGBA8
+///
+/// The alpha component of the source is discarded. Returns a null pointer if
+/// source is a null pointer or a virtual texture. Returns a null pointer if the
+/// formats do not match. Returns a null pointer if memory allocation fails.
+///
+/// \param source Pointer to the texture to compress.
+/// \param format The block compressed format.
+/// \return Returns a texture pointer on success, null pointer on failure.
+///
+struct texture *compress_texture(const struct texture *source,
+                                 enum texture_format format);
+
+///
+/// \brief Provides the pages of a virtual texture on demand.
+///
+/// load_page copies the page_index-th page into pixels, which can hold
+/// page_size bytes, and returns false if the page cannot be loaded. The pages
+/// are in the same order and format as get_texture_page() produces. release is
+/// called with user_data when the virtual texture is destroyed, it may be a
+/// null pointer.
+///
+struct texture_page_source {
+    bool (*load_page)(void *user_data, uint32_t page_index, void *pixels,
+                      size_t page_size);
+    void (*release)(void *user_data);
+    void *user_data;
+};
+
+///
+/// \brief Creates a virtual texture.
+///
+/// A virtual texture is split into pages of 64x64 texels per level, the last
+/// page of a row or column may be partially used. Only a fixed number of pages
+/// are kept in memory: when sampling touches a page that is not in memory, it
+/// is loaded from the page source, replacing the least recently used page if
+/// the cache is full. The memory used by the texture is therefore bounded by
+/// the cache size no matter how large the texture is, and only the pages that
+/// are actually sampled are ever loaded. The cache should be large enough to
+/// hold the pages touched by a frame, otherwise pages are loaded repeatedly.
+///
+/// The pixels of a virtual texture cannot be set or read directly, its layout
+/// is always TEXTURE_LAYOUT_TILED. Sampling a virtual texture modifies its
+/// cache, so it must not be sampled from multiple threads at the same time.
+///
+/// Returns a null pointer if the width, height, level count or cache page count
+/// is 0, or if the level count is larger than the size of a complete mipmap
+/// chain. Returns a null pointer if the format is invalid, is
+/// TEXTURE_FORMAT_DEPTH_FLOAT or is multisampled. Returns a null pointer if
+/// source is a null pointer. Returns a null pointer if memory allocation fails.
+/// source->release is not called on failure.
+///
+/// \param format The pixel format of the texture.
+/// \param width The width of the base level.
+/// \param height The height of the base level.
+/// \param level_count The number of levels, including the base level.
+/// \param cache_page_count The maximum number of pages kept in memory.
+/// \param source Where the pages are loaded from.
+/// \return Returns a texture pointer on success, null pointer on failure.
+///
+struct texture *create_virtual_texture(
+    enum texture_format format, uint32_t width, uint32_t height,
+    uint32_t level_count, uint32_t cache_page_count,
+    const struct texture_page_source *source);
+
+///
+/// \brief Gets the number of pages of the texture, over all its levels.
+///
+/// The pages are numbered level by level starting from the base level, and in
+/// each level row by row starting from the bottom-left page. This works for
+/// any texture, so that the pages of an ordinary texture can be stored and
+/// later used as the source of a virtual texture with the same format, size
+/// and level count.
+///
+/// The behavior is undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to get.
+/// \return Returns the number of pages.
+///
+uint32_t get_texture_page_count(const struct texture *texture);
+
+///
+/// \brief Gets the number of bytes of a page of the texture.
+///
+/// The behavior is undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to get.
+/// \return Returns the size of a page in bytes.
+///
+size_t get_texture_page_size(const struct texture *texture);
+
+///
+/// \brief Copies a page of an ordinary texture.
+///
+/// Fails if texture or pixels is a null pointer. Fails if the texture is a
+/// virtual texture. Fails if page_index is out of range. The behavior is
+/// undefined if the size of the array pointed to by pixels is smaller than
+/// get_texture_page_size().
+///
+/// \param texture Pointer to the texture to copy from.
+/// \param page_index The index of the page.
+/// \param pixels Where to copy the page to.
+/// \return Returns true on success, false on failure.
+///
+bool get_texture_page(const struct texture *texture, uint32_t page_index,
+                      void *pixels);
+
+///
+/// \brief Gets the pages of a virtual texture touched by sampling.
+///
+/// Sampling records every page it reads. The indices of the pages recorded
+/// since the last call to clear_texture_page_feedback() are written to
+/// page_indices in ascending order, at most max_count of them. This tells
+/// which parts of the texture the camera actually sees.
+///
+/// Returns 0 if texture is a null pointer or is not a virtual texture.
+///
+/// \param texture Pointer to the virtual texture.
+/// \param page_indices Where to write the page indices, may be a null pointer
+///                     if max_count is 0.
+/// \param max_count The maximum number of page indices to write.
+/// \return Returns the number of touched pages, which may be larger than
+///         max_count.
+///
+uint32_t get_texture_page_feedback(const struct texture *texture,
+                                   uint32_t *page_indices, uint32_t max_count);
+
+///
+/// \brief Clears the pages recorded by sampling the virtual texture.
+///
+/// If texture is a null pointer or is not a virtual texture, the function does
+/// nothing.
+///
+/// \param texture Pointer to the virtual texture.
+///
+void clear_texture_page_feedback(struct texture *texture);
+
+///
+/// \brief Gets the layout of the texture.
+///
+/// The behavior is undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to get.
+/// \return Returns texture layout.
+///
+enum texture_layout get_texture_layout(const struct texture *texture);
+
 ///
 /// \brief Gets the texture format of the texture.
 ///
@@ -133,10 +715,43 @@ uint32_t get_texture_width(const struct texture *texture);
 uint32_t get_texture_height(const struct texture *texture);
 
 ///
-/// \brief Samples pixel from the texture.
+/// \brief Gets the number of levels in the texture, including the base level.
+///
+/// Returns 1 if the texture has no mipmap chain. The behavior is undefined if
+/// texture is a null pointer.
+///
+/// \param texture Pointer to the texture to get.
+/// \return Returns the number of levels.
+///
+uint32_t get_texture_level_count(const struct texture *texture);
+
+///
+/// \brief Sets the filter used when sampling the texture.
+///
+/// The initial filter is TEXTURE_FILTER_NEAREST. If texture is a null pointer,
+/// the function does nothing.
+///
+/// \param texture The texture pointer.
+/// \param filter The filter to use.
+///
+void set_texture_filter(struct texture *texture, enum texture_filter filter);
+
+///
+/// \brief Gets the filter used when sampling the texture.
+///
+/// The behavior is undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to get.
+/// \return Returns the texture filter.
+///
+enum texture_filter get_texture_filter(const struct texture *texture);
+
+///
+/// \brief Samples pixel from the base level of the texture.
 ///
 /// If the texture's format is sRGB encoded, the function will inverse-correct
-/// pixel values to linear color space.
+/// pixel values to linear color space. Equivalent to calling
+/// texture_sample_lod() with a level of detail of 0.
 ///
 /// The behavior is undefined if texture is a null pointer.
 ///
@@ -146,4 +761,274 @@ uint32_t get_texture_height(const struct texture *texture);
 ///
 vector4 texture_sample(const struct texture *texture, vector2 texcoord);
 
+///
+/// \brief Samples pixel from the texture with an explicit level of detail.
+///
+/// The level of detail is clamped to the range of mipmap levels contained in
+/// the texture, then the texture's filter is used to select the levels and the
+/// texels to read. The values of sRGB encoded texels are converted to linear
+/// color space before filtering.
+///
+/// The behavior is undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to retrieve.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \param lod The level of detail, 0 is the base level.
+/// \return Returns pixel on success. Returns fallback pixel on failure.
+///
+vector4 texture_sample_lod(const struct texture *texture, vector2 texcoord,
+                           float lod);
+
+///
+/// \brief Samples pixel from the texture, the level of detail is computed from
+///        the screen space derivatives of the texture coordinate.
+///
+/// The derivatives are usually obtained by shader_context_ddx_vector2() and
+/// shader_context_ddy_vector2() in the fragment shader. The level of detail is
+/// the base 2 logarithm of the larger footprint of a pixel in texel units,
+/// refer to the OpenGL specification section 3.8.11 equation 3.18:
+/// https://www.khronos.org/registry/OpenGL/specs/gl/glspec33.core.pdf
+///
+/// The behavior is undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to retrieve.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \param ddx The derivative of the texture coordinate along screen space x.
+/// \param ddy The derivative of the texture coordinate along screen space y.
+/// \return Returns pixel on success. Returns fallback pixel on failure.
+///
+vector4 texture_sample_grad(const struct texture *texture, vector2 texcoord,
+                            vector2 ddx, vector2 ddy);
+
+///
+/// \brief Checks whether all pixels of the base level of the texture are the
+///        same.
+///
+/// Scans every pixel, so it is meant to be called when importing a texture,
+/// not while rendering. A constant texture can be replaced with its value to
+/// skip sampling it. The value is the decoded pixel, as returned by sampling,
+/// e.g. sRGB encoded pixels are converted to linear space.
+///
+/// Returns false if texture is a null pointer or a virtual texture.
+///
+/// \param texture Pointer to the texture to check.
+/// \param value Returns the value of all pixels if the texture is constant, may
+///              be a null pointer.
+/// \return Returns true if the texture is constant, false otherwise.
+///
+bool is_texture_constant(const struct texture *texture, vector4 *value);
+
+///
+/// \brief Samples pixels from the texture at many texture coordinates.
+///
+/// Gives the same result as calling texture_sample_lod() for each coordinate,
+/// i.e. r[i], g[i], b[i] and a[i] are the components of the pixel sampled at
+/// (u[i], v[i]) with a level of detail of lod[i]. The arrays hold count
+/// elements each, one array per component, so that batched shading code can
+/// keep its data in this layout. The coordinates are processed in batches of
+/// 8: the address computation and the filtering are done for the whole batch
+/// at once, which lets the compiler vectorize them.
+///
+/// lod may be a null pointer to sample the base level. Any of r, g, b and a
+/// may be a null pointer if the component is not needed. The behavior is
+/// undefined if texture is a null pointer.
+///
+/// \param texture Pointer to the texture to retrieve.
+/// \param count The number of texture coordinates.
+/// \param u The u components of the texture coordinates.
+/// \param v The v components of the texture coordinates.
+/// \param lod The levels of detail.
+/// \param r The R components of the sampled pixels.
+/// \param g The G components of the sampled pixels.
+/// \param b The B components of the sampled pixels.
+/// \param a The A components of the sampled pixels.
+///
+void texture_sample_n(const struct texture *texture, size_t count,
+                      const float *u, const float *v, const float *lod,
+                      float *r, float *g, float *b, float *a);
+
+struct sampler;
+
+typedef vector4 (*sampler_function)(const struct sampler *sampler,
+                                    vector2 texcoord, float lod);
+
+typedef void (*sampler_batch_function)(const struct sampler *sampler,
+                                       size_t count, const float *u,
+                                       const float *v, const float *lod,
+                                       float *const result[4]);
+
+typedef float (*sampler_compare_function)(const struct sampler *sampler,
+                                          vector2 texcoord, float reference);
+
+///
+/// \brief A sampler binds a texture with the filter and wrap mode used to
+///        sample it.
+///
+/// texture_sample() and its variants decide how to decode a texel from the
+/// texture format on every call. A sampler makes that decision once when the
+/// texture is bound: bind_sampler() selects a sampling function specialized
+/// for the format of the texture and the filter, so sampling through the
+/// sampler does not branch on the format.
+///
+/// The members are set by bind_sampler() and should not be modified directly.
+///
+struct sampler {
+    const struct texture *texture;
+    enum texture_filter filter;
+    enum texture_wrap wrap;
+    // The size of the base level, used to compute the level of detail.
+    float width, height;
+    sampler_function sample;
+    sampler_batch_function sample_n;
+    // Only available for TEXTURE_FORMAT_DEPTH_FLOAT textures, otherwise a null
+    // pointer.
+    sampler_compare_function compare;
+};
+
+///
+/// \brief Binds a texture to the sampler.
+///
+/// The filter and wrap mode of the sampler are used instead of the filter of
+/// the texture. The texture must not be destroyed while it is bound.
+///
+/// Fails if sampler or texture is a null pointer. Fails if the filter or the
+/// wrap mode is an invalid value, in which case the sampler is unchanged.
+///
+/// \param sampler The sampler to bind to.
+/// \param texture The texture to bind.
+/// \param filter The filter used when sampling.
+/// \param wrap How texture coordinates out of [0,1] are handled.
+/// \return Returns true on success, false on failure.
+///
+bool bind_sampler(struct sampler *sampler, const struct texture *texture,
+                  enum texture_filter filter, enum texture_wrap wrap);
+
+///
+/// \brief Unbinds the texture from the sampler.
+///
+/// The texture member of an unbound sampler is a null pointer, which lets
+/// shaders tell whether a texture is bound. Sampling through an unbound sampler
+/// is undefined. If sampler is a null pointer, the function does nothing.
+///
+/// \param sampler The sampler to unbind.
+///
+void unbind_sampler(struct sampler *sampler);
+
+///
+/// \brief Samples pixel from the base level of the texture bound to the
+///        sampler.
+///
+/// Same as texture_sample(), but uses the filter and wrap mode of the sampler.
+/// The behavior is undefined if no texture is bound to the sampler.
+///
+/// \param sampler Pointer to the sampler.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \return Returns pixel on success. Returns fallback pixel on failure.
+///
+vector4 sampler_sample(const struct sampler *sampler, vector2 texcoord);
+
+///
+/// \brief Samples pixel from the texture bound to the sampler with an explicit
+///        level of detail.
+///
+/// Same as texture_sample_lod(), but uses the filter and wrap mode of the
+/// sampler. The behavior is undefined if no texture is bound to the sampler.
+///
+/// \param sampler Pointer to the sampler.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \param lod The level of detail, 0 is the base level.
+/// \return Returns pixel on success. Returns fallback pixel on failure.
+///
+vector4 sampler_sample_lod(const struct sampler *sampler, vector2 texcoord,
+                           float lod);
+
+///
+/// \brief Samples pixel from the texture bound to the sampler, the level of
+///        detail is computed from the screen space derivatives of the texture
+///        coordinate.
+///
+/// Same as texture_sample_grad(), but uses the filter and wrap mode of the
+/// sampler. The behavior is undefined if no texture is bound to the sampler.
+///
+/// \param sampler Pointer to the sampler.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \param ddx The derivative of the texture coordinate along screen space x.
+/// \param ddy The derivative of the texture coordinate along screen space y.
+/// \return Returns pixel on success. Returns fallback pixel on failure.
+///
+vector4 sampler_sample_grad(const struct sampler *sampler, vector2 texcoord,
+                            vector2 ddx, vector2 ddy);
+
+///
+/// \brief Samples pixels from the texture bound to the sampler at many texture
+///        coordinates.
+///
+/// Same as texture_sample_n(), but uses the filter and wrap mode of the
+/// sampler, and the texel decoding is specialized for the format of the
+/// texture. The behavior is undefined if no texture is bound to the sampler.
+///
+/// \param sampler Pointer to the sampler.
+/// \param count The number of texture coordinates.
+/// \param u The u components of the texture coordinates.
+/// \param v The v components of the texture coordinates.
+/// \param lod The levels of detail.
+/// \param r The R components of the sampled pixels.
+/// \param g The G components of the sampled pixels.
+/// \param b The B components of the sampled pixels.
+/// \param a The A components of the sampled pixels.
+///
+void sampler_sample_n(const struct sampler *sampler, size_t count,
+                      const float *u, const float *v, const float *lod,
+                      float *r, float *g, float *b, float *a);
+
+///
+/// \brief Compares a reference value with the depth stored in the texture
+///        bound to the sampler.
+///
+/// This is the sampling function of shadow maps. The depths are read from the
+/// base level. If the filter of the sampler is TEXTURE_FILTER_NEAREST, the
+/// depth of the texel nearest to the texture coordinate is compared. Otherwise
+/// the 2x2 texels around the texture coordinate are compared and the results
+/// are bilinearly interpolated, which is known as percentage closer filtering.
+///
+/// The behavior is undefined if the format of the bound texture is not
+/// TEXTURE_FORMAT_DEPTH_FLOAT.
+///
+/// \param sampler Pointer to the sampler.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \param reference The depth to compare with.
+/// \return Returns the fraction of the compared texels whose depth is greater
+///         than or equal to the reference, 1 or 0 for the nearest filter.
+///
+float sampler_sample_compare(const struct sampler *sampler, vector2 texcoord,
+                             float reference);
+
+///
+/// \brief Compares a reference value with the depths stored in the texture
+///        bound to the sampler, filtered by a kernel of the given radius.
+///
+/// The result is the average of (2 * radius + 1)^2 bilinear 2x2 comparisons
+/// at one texel spacing around the texture coordinate, which covers
+/// (2 * radius + 2)^2 texels of the base level. A radius of 0 is the same as
+/// sampler_sample_compare() with a bilinear filter. The filter of the sampler
+/// is ignored.
+///
+/// If the depth bounds of the texture are up to date, see
+/// generate_texture_depth_bounds(), the kernel is skipped when all texels it
+/// covers are in front of or behind the reference.
+///
+/// The behavior is undefined if the format of the bound texture is not
+/// TEXTURE_FORMAT_DEPTH_FLOAT.
+///
+/// \param sampler Pointer to the sampler.
+/// \param texcoord Texture coordinate at which the texture will be sampled.
+/// \param reference The depth to compare with.
+/// \param radius The radius of the kernel in texels.
+/// \return Returns the filtered fraction of the texels whose depth is greater
+///         than or equal to the reference.
+///
+float sampler_sample_compare_pcf(const struct sampler *sampler,
+                                 vector2 texcoord, float reference,
+                                 uint32_t radius);
+
 #endif  // FOOLRENDERER_GRAPHICS_TEXTURE_H_
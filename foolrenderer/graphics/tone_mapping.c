@@ -0,0 +1,234 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "graphics/tone_mapping.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "graphics/color.h"
+#include "graphics/texture.h"
+#include "math/math_utility.h"
+#include "math/vector.h"
+
+// The number of pixels processed together. Each step of the resolve runs over
+// a whole batch stored as separate arrays of components, which keeps the loops
+// simple enough for the compiler to vectorize.
+#define BATCH_SIZE 64
+
+static struct {
+    enum tone_mapping_operator operator;
+    float exposure;
+} tone_mapping = {TONE_MAPPING_CLAMP, 1.0f};
+
+void set_tone_mapping(enum tone_mapping_operator tone_mapping_operator,
+                      float exposure) {
+    tone_mapping.operator = tone_mapping_operator;
+    tone_mapping.exposure = exposure;
+}
+
+// Reads count pixels starting from the pixel pointed to by pixels.
+static void decode_batch(float *restrict components[4], const uint8_t *pixels,
+                         enum texture_format format, uint32_t count) {
+    if (format == TEXTURE_FORMAT_RGBA16F) {
+        const uint16_t *half = (const uint16_t *)pixels;
+        for (uint32_t i = 0; i < count; i++) {
+            for (int c = 0; c < 4; c++) {
+                components[c][i] = half_to_float(half[i * 4 + c]);
+            }
+        }
+    } else {
+        // format == TEXTURE_FORMAT_R11G11B10F
+        const uint32_t *packed = (const uint32_t *)pixels;
+        for (uint32_t i = 0; i < count; i++) {
+            float rgb[3];
+            unpack_r11g11b10f(rgb, packed[i]);
+            components[0][i] = rgb[0];
+            components[1][i] = rgb[1];
+            components[2][i] = rgb[2];
+            components[3][i] = 1.0f;
+        }
+    }
+}
+
+static void tone_map_batch(float *restrict values, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] *= tone_mapping.exposure;
+    }
+    switch (tone_mapping.operator) {
+        case TONE_MAPPING_REINHARD:
+            for (uint32_t i = 0; i < count; i++) {
+                float x = float_max(values[i], 0.0f);
+                values[i] = x / (1.0f + x);
+            }
+            break;
+        case TONE_MAPPING_ACES:
+            for (uint32_t i = 0; i < count; i++) {
+                float x = float_max(values[i], 0.0f);
+                values[i] = float_clamp01((x * (2.51f * x + 0.03f)) /
+                                          (x * (2.43f * x + 0.59f) + 0.14f));
+            }
+            break;
+        default:
+            // TONE_MAPPING_CLAMP
+            for (uint32_t i = 0; i < count; i++) {
+                values[i] = float_clamp01(values[i]);
+            }
+            break;
+    }
+}
+
+// Reads count pixels of a row of the texture starting from (x, y). In the tiled
+// layout the pixels of a row are only contiguous within a tile, so they are
+// read a tile at a time. The pixels of the tiles a deferred clear has not
+// written yet are read from the clear, see get_texture_clear_texel().
+static void decode_row(float *components[4], const struct texture *texture,
+                       const uint8_t *pixels, size_t pixel_size, uint32_t x,
+                       uint32_t y, uint32_t count) {
+    enum texture_format format = get_texture_format(texture);
+    uint32_t width = get_texture_width(texture);
+    bool is_linear = get_texture_layout(texture) == TEXTURE_LAYOUT_LINEAR;
+    for (uint32_t i = 0; i < count;) {
+        uint32_t column = x + i;
+        uint32_t span = uint32_min(
+            count - i,
+            TEXTURE_CLEAR_TILE_SIZE - column % TEXTURE_CLEAR_TILE_SIZE);
+        float *parts[4] = {components[0] + i, components[1] + i,
+                           components[2] + i, components[3] + i};
+        const uint8_t *clear_texel =
+            get_texture_clear_texel(texture, column, y);
+        if (clear_texel != NULL) {
+            for (uint32_t j = 0; j < span; j++) {
+                float *pixel[4] = {parts[0] + j, parts[1] + j, parts[2] + j,
+                                   parts[3] + j};
+                decode_batch(pixel, clear_texel, format, 1);
+            }
+        } else if (is_linear) {
+            decode_batch(parts,
+                         pixels + ((size_t)y * width + column) * pixel_size,
+                         format, span);
+        } else {
+            span = uint32_min(span,
+                              TEXTURE_TILE_SIZE - column % TEXTURE_TILE_SIZE);
+            decode_batch(parts,
+                         pixels + get_tiled_texel_index(width, column, y) *
+                                      pixel_size,
+                         format, span);
+        }
+        i += span;
+    }
+}
+
+// Writes count pixels starting from the pixel pointed to by pixels.
+static void encode_batch(uint8_t *pixels, size_t pixel_size, bool is_srgb,
+                         float *const components[4], uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t *pixel = pixels + i * pixel_size;
+        for (int c = 0; c < 3; c++) {
+            float value = components[c][i];
+            pixel[c] = is_srgb ? linear_to_srgb8(value)
+                               : float_to_uint8(float_clamp01(value));
+        }
+        if (pixel_size == 4) {
+            pixel[3] = float_to_uint8(float_clamp01(components[3][i]));
+        }
+    }
+}
+
+bool resolve_texture_region(struct texture *target,
+                            const struct texture *source, uint32_t x,
+                            uint32_t y, uint32_t width, uint32_t height) {
+    if (target == NULL || source == NULL) {
+        return false;
+    }
+    enum texture_format source_format = get_texture_format(source);
+    size_t source_pixel_size;
+    if (source_format == TEXTURE_FORMAT_RGBA16F) {
+        source_pixel_size = 8;
+    } else if (source_format == TEXTURE_FORMAT_R11G11B10F) {
+        source_pixel_size = 4;
+    } else {
+        return false;
+    }
+    enum texture_format target_format = get_texture_format(target);
+    size_t target_pixel_size;
+    if (target_format == TEXTURE_FORMAT_RGB8 ||
+        target_format == TEXTURE_FORMAT_SRGB8) {
+        target_pixel_size = 3;
+    } else if (target_format == TEXTURE_FORMAT_RGBA8 ||
+               target_format == TEXTURE_FORMAT_SRGB8_A8) {
+        target_pixel_size = 4;
+    } else {
+        return false;
+    }
+    bool is_srgb = target_format == TEXTURE_FORMAT_SRGB8 ||
+                   target_format == TEXTURE_FORMAT_SRGB8_A8;
+    uint32_t texture_width = get_texture_width(target);
+    uint32_t texture_height = get_texture_height(target);
+    if (texture_width != get_texture_width(source) ||
+        texture_height != get_texture_height(source) ||
+        get_texture_layout(target) != TEXTURE_LAYOUT_LINEAR ||
+        (get_texture_layout(source) != TEXTURE_LAYOUT_LINEAR &&
+         get_texture_layout(source) != TEXTURE_LAYOUT_TILED)) {
+        return false;
+    }
+    if (x >= texture_width || y >= texture_height) {
+        return true;
+    }
+    width = uint32_min(width, texture_width - x);
+    height = uint32_min(height, texture_height - y);
+
+    // The source is read in place, in its own layout, so that resolving a
+    // region does not convert the whole texture. The target is linear, so
+    // get_texture_pixels() returns its storage.
+    const uint8_t *source_pixels = get_texture_storage_const(source);
+    uint8_t *target_pixels = get_texture_pixels(target);
+    float batch[4][BATCH_SIZE];
+    float *components[4] = {batch[0], batch[1], batch[2], batch[3]};
+    for (uint32_t row = y; row < y + height; row++) {
+        size_t row_offset = (size_t)row * texture_width;
+        for (uint32_t column = x; column < x + width; column += BATCH_SIZE) {
+            uint32_t count = uint32_min(BATCH_SIZE, x + width - column);
+            size_t offset = row_offset + column;
+            decode_row(components, source, source_pixels, source_pixel_size,
+                       column, row, count);
+            for (int c = 0; c < 3; c++) {
+                tone_map_batch(components[c], count);
+            }
+            encode_batch(target_pixels + offset * target_pixel_size,
+                         target_pixel_size, is_srgb, components, count);
+        }
+    }
+    return true;
+}
+
+bool resolve_texture(struct texture *target, const struct texture *source) {
+    if (target == NULL || source == NULL) {
+        return false;
+    }
+    return resolve_texture_region(target, source, 0, 0,
+                                  get_texture_width(target),
+                                  get_texture_height(target));
+}
+
+void tone_map_colors(vector4 *colors, size_t count) {
+    float batch[3][BATCH_SIZE];
+    for (size_t first = 0; first < count; first += BATCH_SIZE) {
+        uint32_t batch_count = (uint32_t)(count - first < BATCH_SIZE
+                                              ? count - first
+                                              : BATCH_SIZE);
+        vector4 *batch_colors = colors + first;
+        for (int c = 0; c < 3; c++) {
+            for (uint32_t i = 0; i < batch_count; i++) {
+                batch[c][i] = batch_colors[i].elements[c];
+            }
+            tone_map_batch(batch[c], batch_count);
+            for (uint32_t i = 0; i < batch_count; i++) {
+                batch_colors[i].elements[c] = batch[c][i];
+            }
+        }
+    }
+}
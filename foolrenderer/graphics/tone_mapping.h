@@ -0,0 +1,105 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_GRAPHICS_TONE_MAPPING_H_
+#define FOOLRENDERER_GRAPHICS_TONE_MAPPING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "graphics/texture.h"
+#include "math/vector.h"
+
+enum tone_mapping_operator {
+    ///
+    /// Clamps each component to [0,1]. This is what the rasterizer does when
+    /// it writes to a low dynamic range color buffer directly.
+    ///
+    TONE_MAPPING_CLAMP,
+    ///
+    /// Maps each component x to x/(1+x), refer to:
+    /// https://www.cs.utah.edu/docs/techreports/2002/pdf/UUCS-02-001.pdf
+    ///
+    TONE_MAPPING_REINHARD,
+    ///
+    /// Krzysztof Narkowicz's curve fit of the ACES filmic tone mapping, refer
+    /// to:
+    /// https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
+    ///
+    TONE_MAPPING_ACES
+};
+
+///
+/// \brief Sets how resolve_texture() maps high dynamic range colors to [0,1].
+///
+/// The color is multiplied by the exposure before the operator is applied. The
+/// initial operator is TONE_MAPPING_CLAMP and the initial exposure is 1.
+///
+/// \param tone_mapping_operator The tone mapping operator.
+/// \param exposure The scale applied to the color.
+///
+void set_tone_mapping(enum tone_mapping_operator tone_mapping_operator,
+                      float exposure);
+
+///
+/// \brief Tone maps a high dynamic range texture into a displayable texture.
+///
+/// The source texture must be in the format TEXTURE_FORMAT_RGBA16F or
+/// TEXTURE_FORMAT_R11G11B10F. The target texture must be in the format
+/// TEXTURE_FORMAT_RGB8, TEXTURE_FORMAT_SRGB8, TEXTURE_FORMAT_RGBA8 or
+/// TEXTURE_FORMAT_SRGB8_A8. The tone mapped color is converted to sRGB if the
+/// target is sRGB encoded, then quantized to 8 bits. The alpha component is
+/// clamped to [0,1] without tone mapping, it is 1 if the source has no alpha.
+///
+/// This is the only place where the colors of a high dynamic range color
+/// buffer are clamped, gamma corrected and quantized, once per pixel in a
+/// single pass over memory instead of once per shaded fragment.
+///
+/// Fails if target or source is a null pointer. Fails if the format of either
+/// texture is not supported. Fails if the textures differ in size. Fails if
+/// the target is not in TEXTURE_LAYOUT_LINEAR. The source may be in
+/// TEXTURE_LAYOUT_LINEAR or TEXTURE_LAYOUT_TILED, it is read in place.
+///
+/// \param target The texture to write to.
+/// \param source The high dynamic range texture to read from.
+/// \return Returns true on success, false on failure.
+///
+bool resolve_texture(struct texture *target, const struct texture *source);
+
+///
+/// \brief Tone maps a rectangle of a high dynamic range texture into a
+///        displayable texture.
+///
+/// Same as resolve_texture(), but only resolves the pixels in the rectangle
+/// whose bottom-left corner is (x, y). This allows the resolve to run per
+/// tile, for example right after the tile is rendered while it is still in
+/// the cache. The rectangle is clipped to the size of the textures.
+///
+/// \param target The texture to write to.
+/// \param source The high dynamic range texture to read from.
+/// \param x The left of the rectangle in pixels.
+/// \param y The bottom of the rectangle in pixels.
+/// \param width The width of the rectangle in pixels.
+/// \param height The height of the rectangle in pixels.
+/// \return Returns true on success, false on failure.
+///
+bool resolve_texture_region(struct texture *target,
+                            const struct texture *source, uint32_t x,
+                            uint32_t y, uint32_t width, uint32_t height);
+
+///
+/// \brief Tone maps colors in place with the operator and exposure set by
+///        set_tone_mapping().
+///
+/// Only the RGB components are tone mapped, the results are in [0,1] and still
+/// in linear color space. The alpha component is left unchanged.
+///
+/// \param colors The colors to tone map.
+/// \param count The number of colors.
+///
+void tone_map_colors(vector4 *colors, size_t count);
+
+#endif  // FOOLRENDERER_GRAPHICS_TONE_MAPPING_H_
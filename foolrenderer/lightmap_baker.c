@@ -0,0 +1,215 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+// Bakes the direct lighting and the shadow of the directional light on the
+// model into a lightmap page file. The renderer reads it with the
+// --baked-lighting option instead of rendering and sampling shadow maps, which
+// is valid as long as the model and the light do not move.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "graphics/color.h"
+#include "graphics/framebuffer.h"
+#include "graphics/rasterizer.h"
+#include "graphics/texture.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+#include "shaders/lightmap_baking.h"
+#include "utilities/image.h"
+#include "utilities/mesh.h"
+#include "utilities/scene.h"
+
+#define LIGHTMAP_WIDTH 1024
+#define LIGHTMAP_HEIGHT 1024
+// A single shadow map covers the whole model, its texels are about as large as
+// those of the finest cascade of the renderer.
+#define SHADOW_MAP_WIDTH 2048
+#define SHADOW_MAP_HEIGHT 2048
+// The number of texels the lighting is extended beyond the edges of each UV
+// chart, so that bilinear filtering at the edges does not read unbaked texels.
+#define LIGHTMAP_DILATION 4
+
+static void render_shadow_map(struct framebuffer *framebuffer,
+                              struct texture *shadow_map,
+                              matrix4x4 world2clip, const struct mesh *mesh) {
+    set_viewport(0, 0, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT);
+    clear_framebuffer(framebuffer);
+    draw_shadow_casters(framebuffer, mesh, world2clip);
+    // Let the filtering skip the regions that are entirely lit or entirely in
+    // shadow.
+    generate_texture_depth_bounds(shadow_map);
+}
+
+static void bake_lightmap(struct framebuffer *framebuffer,
+                          const struct mesh *mesh,
+                          const struct texture *normal_map,
+                          const struct texture *shadow_map,
+                          matrix4x4 world2clip) {
+    set_viewport(0, 0, LIGHTMAP_WIDTH, LIGHTMAP_HEIGHT);
+    set_vertex_shader(lightmap_baking_vertex_shader);
+    set_fragment_shader(lightmap_baking_fragment_shader);
+    set_uniform_prepare(NULL);
+    set_clear_color(0.0f, 0.0f, 0.0f, 0.0f);
+    clear_framebuffer(framebuffer);
+
+    struct lightmap_baking_uniform uniform;
+    uniform.local2world = MATRIX4X4_IDENTITY;
+    uniform.local2world_direction = matrix4x4_to_3x3(uniform.local2world);
+    uniform.local2world_normal = uniform.local2world_direction;
+    uniform.light_direction = vector3_normalize(SCENE_LIGHT_DIRECTION);
+    uniform.illuminance = SCENE_LIGHT_ILLUMINANCE;
+    // Remap each component of position from [-1, 1] to [0, 1].
+    matrix4x4 scale_bias = {{{0.5f, 0.0f, 0.0f, 0.5f},
+                             {0.0f, 0.5f, 0.0f, 0.5f},
+                             {0.0f, 0.0f, 0.5f, 0.5f},
+                             {0.0f, 0.0f, 0.0f, 1.0f}}};
+    uniform.world2light = matrix4x4_multiply(scale_bias, world2clip);
+    bind_sampler(&uniform.shadow_map, shadow_map, TEXTURE_FILTER_BILINEAR,
+                 TEXTURE_WRAP_CLAMP);
+    uniform.shadow_filter_radius = 1;
+    bind_sampler(&uniform.normal_map, normal_map, TEXTURE_FILTER_TRILINEAR,
+                 TEXTURE_WRAP_CLAMP);
+
+    for (size_t t = 0; t < mesh->triangle_count; t++) {
+        struct lightmap_baking_vertex_attribute attributes[3];
+        const void *attribute_ptrs[3];
+        for (uint32_t v = 0; v < 3; v++) {
+            get_mesh_position(&attributes[v].position, mesh, t, v);
+            get_mesh_normal(&attributes[v].normal, mesh, t, v);
+            get_mesh_tangent(&attributes[v].tangent, mesh, t, v);
+            get_mesh_texcoord(&attributes[v].texcoord, mesh, t, v);
+            attribute_ptrs[v] = attributes + v;
+        }
+        draw_triangle(framebuffer, &uniform, attribute_ptrs);
+        // Only one of the two orders is front-facing in texture space.
+        const void *reversed_ptrs[3] = {attribute_ptrs[2], attribute_ptrs[1],
+                                        attribute_ptrs[0]};
+        draw_triangle(framebuffer, &uniform, reversed_ptrs);
+    }
+}
+
+// Extends the lighting beyond the edges of the UV charts: each pass sets the
+// texels next to baked texels to the average of their baked neighbors. The
+// baked texels are those whose depth was written by bake_lightmap().
+static bool dilate_lightmap(struct texture *lightmap,
+                            struct texture *depth_buffer) {
+    uint16_t(*pixels)[4] = get_texture_pixels(lightmap);
+    float *depths = get_texture_pixels(depth_buffer);
+    if (pixels == NULL || depths == NULL) {
+        return false;
+    }
+    // The depth buffer is reused to mark the texels baked in previous passes.
+    for (uint32_t pass = 0; pass < LIGHTMAP_DILATION; pass++) {
+        bool is_changed = false;
+        for (uint32_t y = 0; y < LIGHTMAP_HEIGHT; y++) {
+            for (uint32_t x = 0; x < LIGHTMAP_WIDTH; x++) {
+                size_t index = (size_t)y * LIGHTMAP_WIDTH + x;
+                if (depths[index] < 1.0f) {
+                    continue;
+                }
+                float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                uint32_t count = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = (int)x + dx;
+                        int ny = (int)y + dy;
+                        if (nx < 0 || nx >= LIGHTMAP_WIDTH || ny < 0 ||
+                            ny >= LIGHTMAP_HEIGHT) {
+                            continue;
+                        }
+                        size_t neighbor = (size_t)ny * LIGHTMAP_WIDTH + nx;
+                        // Only the texels baked before this pass count.
+                        if (depths[neighbor] >= 1.0f) {
+                            continue;
+                        }
+                        for (int c = 0; c < 4; c++) {
+                            sum[c] += half_to_float(pixels[neighbor][c]);
+                        }
+                        count++;
+                    }
+                }
+                if (count == 0) {
+                    continue;
+                }
+                for (int c = 0; c < 4; c++) {
+                    pixels[index][c] = float_to_half(sum[c] / (float)count);
+                }
+                // Above 1, so that the texel is not read in this pass, but is
+                // told apart from the texels that are not baked.
+                depths[index] = 2.0f;
+                is_changed = true;
+            }
+        }
+        for (size_t i = 0; i < (size_t)LIGHTMAP_WIDTH * LIGHTMAP_HEIGHT; i++) {
+            if (depths[i] > 1.0f) {
+                depths[i] = 0.0f;
+            }
+        }
+        if (!is_changed) {
+            break;
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    const char *model_path = "assets/cut_fish/cut_fish.obj";
+    const char *normal_map_path = "assets/cut_fish/normal.tga";
+    const char *lightmap_path = "assets/cut_fish/lightmap.pages";
+
+    struct mesh *mesh = load_mesh(model_path);
+    if (mesh == NULL) {
+        printf("Cannot load .obj file.\n");
+        return 0;
+    }
+    // Baking is offline, so the normal map is not compressed.
+    struct texture *normal_map = load_image(normal_map_path, false);
+    if (normal_map == NULL) {
+        printf("Cannot load texture files.\n");
+        destroy_mesh(mesh);
+        return 0;
+    }
+    vector3 bounds_min, bounds_max;
+    get_mesh_bounds(&bounds_min, &bounds_max, mesh);
+    // The same light space as the renderer's cascades share.
+    matrix4x4 light_world2clip =
+        fit_light_space(SCENE_LIGHT_DIRECTION, bounds_min, bounds_max);
+
+    struct framebuffer *shadow_framebuffer = create_framebuffer();
+    struct texture *shadow_map = create_texture(
+        TEXTURE_FORMAT_DEPTH_FLOAT, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT);
+    attach_texture_to_framebuffer(shadow_framebuffer, DEPTH_ATTACHMENT,
+                                  shadow_map);
+    render_shadow_map(shadow_framebuffer, shadow_map, light_world2clip, mesh);
+
+    // The depth buffer tells which texels are covered by the mesh.
+    struct framebuffer *framebuffer = create_framebuffer();
+    struct texture *lightmap =
+        create_texture(TEXTURE_FORMAT_RGBA16F, LIGHTMAP_WIDTH, LIGHTMAP_HEIGHT);
+    struct texture *depth_buffer = create_texture(
+        TEXTURE_FORMAT_DEPTH_FLOAT, LIGHTMAP_WIDTH, LIGHTMAP_HEIGHT);
+    attach_texture_to_framebuffer(framebuffer, COLOR_ATTACHMENT, lightmap);
+    attach_texture_to_framebuffer(framebuffer, DEPTH_ATTACHMENT, depth_buffer);
+    bake_lightmap(framebuffer, mesh, normal_map, shadow_map, light_world2clip);
+
+    if (dilate_lightmap(lightmap, depth_buffer) &&
+        save_texture_pages(lightmap, lightmap_path)) {
+        printf("Saved the lightmap to %s.\n", lightmap_path);
+    } else {
+        printf("Cannot save the lightmap.\n");
+    }
+
+    destroy_texture(depth_buffer);
+    destroy_texture(lightmap);
+    destroy_framebuffer(framebuffer);
+    destroy_texture(shadow_map);
+    destroy_framebuffer(shadow_framebuffer);
+    destroy_texture(normal_map);
+    destroy_mesh(mesh);
+    return 0;
+}
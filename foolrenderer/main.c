@@ -3,137 +3,609 @@
 // Licensed under the MIT License. See LICENSE file in the project root for
 // license information.
 
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "graphics/color.h"
+#include "graphics/dirty_region.h"
 #include "graphics/framebuffer.h"
+#include "graphics/post_processing.h"
 #include "graphics/rasterizer.h"
+#include "graphics/reprojection_cache.h"
+#include "graphics/temporal_anti_aliasing.h"
 #include "graphics/texture.h"
+#include "graphics/tone_mapping.h"
 #include "math/math_utility.h"
 #include "math/matrix.h"
 #include "math/vector.h"
-#include "shaders/shadow_casting.h"
 #include "shaders/standard.h"
 #include "utilities/image.h"
 #include "utilities/mesh.h"
+#include "utilities/scene.h"
 
-#define SHADOW_MAP_WIDTH 1024
-#define SHADOW_MAP_HEIGHT 1024
+// The cascades together take as much memory as a single 1024x1024 shadow map,
+// and their caches of the static shadows as much again.
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_MAP_WIDTH 512
+#define SHADOW_MAP_HEIGHT 512
+// The size of a cascade is rounded up to one of 4 steps per doubling, so that
+// it only changes when the camera moves far enough.
+#define SHADOW_CASCADE_SIZE_STEPS 4.0f
+// Blends the logarithmic and the uniform split of the camera depth range into
+// cascades, 1 is fully logarithmic.
+#define SHADOW_CASCADE_SPLIT_LAMBDA 0.5f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 10.0f
+// The light clusters divide the screen into 16x16 tiles and the view depth into
+// 16 slices.
+#define LIGHT_CLUSTER_TILE_COUNT 16
+#define LIGHT_CLUSTER_SLICE_COUNT 16
 #define IMAGE_WIDTH 1024
 #define IMAGE_HEIGHT 1024
+// The number of pages each virtual texture keeps in memory.
+#define TEXTURE_CACHE_PAGE_COUNT 256
+// The jitter of temporal anti-aliasing repeats every 8 frames, and each frame
+// is blended into the history with a weight of 0.1.
+#define TAA_JITTER_PERIOD 8
+#define TAA_CURRENT_WEIGHT 0.1f
+// The reprojection cache reuses colors within about 0.01 units of view depth,
+// and shades every pixel again at least once every 16 frames.
+#define REPROJECTION_DEPTH_TOLERANCE 0.001f
+#define REPROJECTION_REFRESH_PERIOD 16
 
 struct model {
     struct mesh *mesh;
+    // The maps whose pixels are all the same are null pointers, their value is
+    // stored in the matching constant instead.
     struct texture *base_color_map;
     struct texture *normal_map;
-    struct texture *metallic_map;
-    struct texture *roughness_map;
+    // Ambient occlusion, roughness and metallic maps packed together.
+    struct texture *material_map;
+    vector4 base_color;
+    vector4 material;
+    // The axis-aligned bounding box of the mesh in world space.
+    vector3 bounds_min;
+    vector3 bounds_max;
+    // Static models never move, their shadows are cached across frames.
+    bool is_static;
+    // Code moving the model or changing its material increments the version,
+    // and updates the bounds, so that the incremental rendering draws the
+    // model again where it was and where it is, see update_dirty_region().
+    uint32_t version;
 };
 
-static vector3 light_direction = (vector3){{1.0f, 4.0f, -1.0f}};
-static vector3 camera_position = (vector3){{-2.0f, 4.5f, 2.0f}};
-static vector3 camera_target = (vector3){{0.0f, 0.4f, 0.0f}};
+// The shadow map of the static models of a cascade. It is rendered again only
+// when the light space of the cascade or the static geometry changes. The
+// light space of a cascade is snapped, see stabilize_cascade(), so it stays the
+// same while the camera moves a little.
+struct shadow_cache {
+    struct framebuffer *framebuffer;
+    struct texture *map;
+    // The light space and the static geometry the map was rendered with.
+    matrix4x4 world2clip;
+    uint32_t geometry_version;
+    bool is_valid;
+};
+
+static vector3 camera_position = {{-2.0f, 4.5f, 2.0f}};
+static vector3 camera_target = {{0.0f, 0.4f, 0.0f}};
 
-static struct framebuffer *shadow_framebuffer;
-static struct texture *shadow_map;
+static struct framebuffer *shadow_framebuffers[SHADOW_CASCADE_COUNT];
+static struct texture *shadow_maps[SHADOW_CASCADE_COUNT];
+static struct shadow_cache shadow_caches[SHADOW_CASCADE_COUNT];
+// Incremented whenever a static model is added, removed or modified.
+static uint32_t static_geometry_version = 0;
+// The shadow map sampled for each cascade, the cached map if there are no
+// dynamic models, otherwise the cached map with the dynamic models drawn over.
+static const struct texture *cascade_shadow_maps[SHADOW_CASCADE_COUNT];
 static struct framebuffer *framebuffer;
-static struct texture *color_buffer;
+static struct texture *hdr_color_buffer;
 static struct texture *depth_buffer;
+static struct texture *color_buffer;
+// Set by the --msaa command line option. The model is then rendered into the
+// multisampled buffers, which are resolved into the HDR color buffer.
+static bool is_multisampled = false;
+static struct texture *multisample_color_buffer = NULL;
+static struct texture *multisample_depth_buffer = NULL;
+// Set by the --taa command line option. Each frame is then rendered with a
+// subpixel jitter and blended into one of the histories, which take turns being
+// read and written. The camera of the previous frame gives the motion vectors.
+static bool is_temporal_anti_aliased = false;
+static struct texture *motion_vector_buffer = NULL;
+static struct texture *taa_histories[2] = {NULL, NULL};
+static matrix4x4 previous_world2clip;
+// Created with the --reprojection-cache command line option. The model is then
+// only shaded where its colors of the previous frame cannot be reused.
+static struct reprojection_cache *reprojection_cache = NULL;
+// Set by the --incremental command line option. After the first frame, only
+// the dirty region is rendered again, the rest of the last frame is kept. The
+// camera, the screen bounds and the version of the model the last frame was
+// rendered with tell what has changed.
+static bool is_incremental = false;
+static struct dirty_region dirty_region;
+static matrix4x4 rendered_world2clip;
+static struct pixel_rectangle rendered_bounds;
+static uint32_t rendered_version;
 
+// The light space shared by all cascades covers the whole scene, the light
+// space of each cascade covers a part of it.
 static matrix4x4 light_world2clip;
+static matrix4x4 cascade_world2clip[SHADOW_CASCADE_COUNT];
+// Map the x and y of the shared light space to those of each cascade, see
+// standard_uniform.shadow_cascade_transforms.
+static vector4 cascade_transforms[SHADOW_CASCADE_COUNT];
+// Set by the --fast-math command line option.
+static bool fast_math = false;
+// The point and spot lights, their bounding spheres, and the clusters they are
+// assigned to every frame. The number of lights is set by the --lights command
+// line option.
+static struct standard_light *lights = NULL;
+static vector4 *light_bounds = NULL;
+static uint32_t light_count = 0;
+static struct light_clusters *light_clusters;
+// The lighting of the directional light baked by lightmap_baker, loaded with
+// the --baked-lighting command line option. If loaded, no shadow map is
+// rendered.
+static struct texture *lightmap = NULL;
+// Tone mapping, FXAA and sharpening fused into a single pass over the HDR color
+// buffer, used instead of resolve_texture() with the --post-process command
+// line option.
+static struct post_process_chain *post_process_chain = NULL;
+static struct post_process_sharpen_parameters sharpen_parameters = {0.2f};
+// Set by the --tiled command line option. The framebuffer attachments are then
+// stored in TEXTURE_LAYOUT_TILED, except the multisampled ones and those
+// sharing a framebuffer with them.
+static bool is_tiled = false;
+// Set by the --frames command line option. The frames are all the same but for
+// the jitter of temporal anti-aliasing, only the last one is saved.
+static uint32_t frame_count = 1;
+
+// Creates a texture to attach to a framebuffer, in the tiled layout if
+// tiled is true.
+static struct texture *create_attachment(enum texture_format format,
+                                         uint32_t width, uint32_t height,
+                                         bool tiled) {
+    struct texture *texture = create_texture(format, width, height);
+    if (texture != NULL && tiled) {
+        set_texture_layout(texture, TEXTURE_LAYOUT_TILED);
+    }
+    return texture;
+}
 
 static void initialize_rendering(void) {
-    shadow_framebuffer = create_framebuffer();
-    shadow_map = create_texture(TEXTURE_FORMAT_DEPTH_FLOAT, SHADOW_MAP_WIDTH,
-                                SHADOW_MAP_HEIGHT);
-    attach_texture_to_framebuffer(shadow_framebuffer, DEPTH_ATTACHMENT,
-                                  shadow_map);
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        shadow_framebuffers[i] = create_framebuffer();
+        shadow_maps[i] = create_attachment(TEXTURE_FORMAT_DEPTH_FLOAT,
+                                           SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT,
+                                           is_tiled);
+        attach_texture_to_framebuffer(shadow_framebuffers[i],
+                                      DEPTH_ATTACHMENT, shadow_maps[i]);
+        struct shadow_cache *cache = &shadow_caches[i];
+        cache->framebuffer = create_framebuffer();
+        cache->map = create_attachment(TEXTURE_FORMAT_DEPTH_FLOAT,
+                                       SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT,
+                                       is_tiled);
+        attach_texture_to_framebuffer(cache->framebuffer, DEPTH_ATTACHMENT,
+                                      cache->map);
+        cache->is_valid = false;
+    }
 
     framebuffer = create_framebuffer();
+    // With multisampling, the HDR color buffer is the linear target of the
+    // resolve instead of an attachment.
+    bool tiled = is_tiled && !is_multisampled;
+    hdr_color_buffer = create_attachment(TEXTURE_FORMAT_RGBA16F, IMAGE_WIDTH,
+                                         IMAGE_HEIGHT, tiled);
+    depth_buffer = create_attachment(TEXTURE_FORMAT_DEPTH_FLOAT, IMAGE_WIDTH,
+                                     IMAGE_HEIGHT, tiled);
+    if (is_multisampled) {
+        multisample_color_buffer = create_texture(
+            TEXTURE_FORMAT_RGBA16F_4X, IMAGE_WIDTH, IMAGE_HEIGHT);
+        multisample_depth_buffer = create_texture(
+            TEXTURE_FORMAT_DEPTH_FLOAT_4X, IMAGE_WIDTH, IMAGE_HEIGHT);
+        attach_texture_to_framebuffer(framebuffer, COLOR_ATTACHMENT,
+                                      multisample_color_buffer);
+        attach_texture_to_framebuffer(framebuffer, DEPTH_ATTACHMENT,
+                                      multisample_depth_buffer);
+    } else {
+        attach_texture_to_framebuffer(framebuffer, COLOR_ATTACHMENT,
+                                      hdr_color_buffer);
+        attach_texture_to_framebuffer(framebuffer, DEPTH_ATTACHMENT,
+                                      depth_buffer);
+    }
+    if (is_temporal_anti_aliased) {
+        motion_vector_buffer = create_attachment(
+            TEXTURE_FORMAT_RGBA16F, IMAGE_WIDTH, IMAGE_HEIGHT, tiled);
+        attach_texture_to_framebuffer(framebuffer, MOTION_VECTOR_ATTACHMENT,
+                                      motion_vector_buffer);
+        for (uint32_t i = 0; i < 2; i++) {
+            taa_histories[i] = create_texture(TEXTURE_FORMAT_RGBA16F,
+                                              IMAGE_WIDTH, IMAGE_HEIGHT);
+        }
+    }
+    if (is_temporal_anti_aliased || reprojection_cache != NULL) {
+        set_previous_position_variable(STANDARD_PREVIOUS_CLIP_POSITION);
+    }
+
+    light_clusters = create_light_clusters(LIGHT_CLUSTER_TILE_COUNT,
+                                           LIGHT_CLUSTER_TILE_COUNT,
+                                           LIGHT_CLUSTER_SLICE_COUNT);
+
+    // The final image, the HDR color buffer is resolved into it after
+    // rendering.
     color_buffer =
         create_texture(TEXTURE_FORMAT_SRGB8_A8, IMAGE_WIDTH, IMAGE_HEIGHT);
-    depth_buffer =
-        create_texture(TEXTURE_FORMAT_DEPTH_FLOAT, IMAGE_WIDTH, IMAGE_HEIGHT);
-    attach_texture_to_framebuffer(framebuffer, COLOR_ATTACHMENT, color_buffer);
-    attach_texture_to_framebuffer(framebuffer, DEPTH_ATTACHMENT, depth_buffer);
 }
 
 static void end_rendering(void) {
-    destroy_texture(shadow_map);
-    destroy_texture(color_buffer);
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        destroy_texture(shadow_maps[i]);
+        destroy_framebuffer(shadow_framebuffers[i]);
+        destroy_texture(shadow_caches[i].map);
+        destroy_framebuffer(shadow_caches[i].framebuffer);
+    }
+    destroy_texture(hdr_color_buffer);
+    destroy_light_clusters(light_clusters);
     destroy_texture(depth_buffer);
-    destroy_framebuffer(shadow_framebuffer);
+    destroy_texture(multisample_color_buffer);
+    destroy_texture(multisample_depth_buffer);
+    destroy_texture(motion_vector_buffer);
+    destroy_texture(taa_histories[0]);
+    destroy_texture(taa_histories[1]);
+    destroy_texture(color_buffer);
     destroy_framebuffer(framebuffer);
 }
 
+static matrix4x4 get_camera_world2view(void) {
+    return matrix4x4_look_at(camera_position, camera_target,
+                             (vector3){{0.0f, 1.0f, 0.0f}});
+}
+
+static matrix4x4 get_camera_view2clip(void) {
+    return matrix4x4_orthographic(2.0f, 2.0f, CAMERA_NEAR, CAMERA_FAR);
+}
+
+static matrix4x4 get_camera_world2clip(void) {
+    return matrix4x4_multiply(get_camera_view2clip(), get_camera_world2view());
+}
+
+// Gets the element of the Halton sequence with the base, in [0,1).
+static float halton(uint32_t index, uint32_t base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= (float)base;
+        result += fraction * (float)(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// Gets the matrix offsetting clip space by the subpixel jitter of the frame.
+// The jitter follows the Halton sequence of bases 2 and 3, which spreads the
+// samples of the frames evenly over the pixel.
+static matrix4x4 get_jitter(uint32_t frame) {
+    if (!is_temporal_anti_aliased) {
+        return MATRIX4X4_IDENTITY;
+    }
+    // The first element of the sequence is 0, skip it.
+    uint32_t index = frame % TAA_JITTER_PERIOD + 1;
+    float x = halton(index, 2) - 0.5f;
+    float y = halton(index, 3) - 0.5f;
+    // A pixel is 2 / size wide in normalized device coordinates.
+    return matrix4x4_translate((vector3){
+        {x * 2.0f / IMAGE_WIDTH, y * 2.0f / IMAGE_HEIGHT, 0.0f}});
+}
+
+// Transforms a point and performs the homogeneous division.
+static vector3 transform_point(matrix4x4 m, vector3 point) {
+    vector4 result =
+        matrix4x4_multiply_vector4(m, vector3_to_4(point, 1.0f));
+    return vector3_divide_scalar(vector4_to_3(result), result.w);
+}
+
+// Gets the corner of the box selected by the three lowest bits of the index.
+static vector3 get_box_corner(vector3 min, vector3 max, uint32_t index) {
+    return (vector3){{index & 1 ? max.x : min.x, index & 2 ? max.y : min.y,
+                      index & 4 ? max.z : min.z}};
+}
+
+// Gets the part of the camera depth range in which the model is visible.
+static void get_model_depth_range(const struct model *model, float *near,
+                                  float *far) {
+    matrix4x4 world2view = get_camera_world2view();
+    *near = CAMERA_FAR;
+    *far = CAMERA_NEAR;
+    for (uint32_t i = 0; i < 8; i++) {
+        vector3 corner = transform_point(
+            world2view,
+            get_box_corner(model->bounds_min, model->bounds_max, i));
+        *near = float_min(*near, -corner.z);
+        *far = float_max(*far, -corner.z);
+    }
+    *near = float_clamp(*near, CAMERA_NEAR, CAMERA_FAR);
+    *far = float_clamp(*far, *near, CAMERA_FAR);
+}
+
+// Rounds the half extent of a cascade along an axis of the shared light space
+// up, and moves its center to a whole texel of the cascade. The extent is
+// padded by a texel first, so the slice stays covered after the move. Small
+// changes of the slice then leave the light space of the cascade as it is,
+// and the shadow edges do not shimmer as the camera moves.
+static void stabilize_cascade(float *center, float *extent,
+                              uint32_t resolution) {
+    float padded = *extent * (1.0f + 2.0f / (float)resolution);
+    *extent = exp2f(ceilf(log2f(padded) * SHADOW_CASCADE_SIZE_STEPS) /
+                    SHADOW_CASCADE_SIZE_STEPS);
+    float texel_size = 2.0f * *extent / (float)resolution;
+    *center = roundf(*center / texel_size) * texel_size;
+}
+
+// Fits the light space of each cascade to its slice of the camera frustum,
+// and the shared light space to the model. For the algorithm, refer to:
+// https://learn.microsoft.com/en-us/windows/win32/dxtecharticles/common-techniques-to-improve-shadow-depth-maps
+static void fit_shadow_cascades(const struct model *model) {
+    // The shared light space encloses the bounding box of the model, so every
+    // shadow caster is rendered and every receiver is covered.
+    light_world2clip = fit_light_space(SCENE_LIGHT_DIRECTION, model->bounds_min,
+                                       model->bounds_max);
+
+    float near, far;
+    get_model_depth_range(model, &near, &far);
+    matrix4x4 camera_world2clip = get_camera_world2clip();
+    matrix4x4 camera_clip2world = matrix4x4_inverse(camera_world2clip);
+    matrix4x4 camera_view2clip = get_camera_view2clip();
+    float split_near = near;
+    for (uint32_t c = 0; c < SHADOW_CASCADE_COUNT; c++) {
+        float ratio = (float)(c + 1) / SHADOW_CASCADE_COUNT;
+        float log_split = near * powf(far / near, ratio);
+        float uniform_split = near + (far - near) * ratio;
+        float split_far = float_lerp(uniform_split, log_split,
+                                     SHADOW_CASCADE_SPLIT_LAMBDA);
+        // The depths of the slice in the normalized device coordinates of the
+        // camera.
+        float z_near = transform_point(camera_view2clip,
+                                       (vector3){{0.0f, 0.0f, -split_near}})
+                           .z;
+        float z_far = transform_point(camera_view2clip,
+                                      (vector3){{0.0f, 0.0f, -split_far}})
+                          .z;
+        // Bound the corners of the slice in the shared light space, and clamp
+        // the bounds to the shared light space, outside of which there is
+        // nothing to shadow.
+        vector3 slice_min = (vector3){{1.0f, 1.0f, 0.0f}};
+        vector3 slice_max = (vector3){{-1.0f, -1.0f, 0.0f}};
+        for (uint32_t i = 0; i < 8; i++) {
+            vector3 corner = get_box_corner((vector3){{-1.0f, -1.0f, z_near}},
+                                            (vector3){{1.0f, 1.0f, z_far}}, i);
+            corner = transform_point(
+                light_world2clip, transform_point(camera_clip2world, corner));
+            slice_min = vector3_min(slice_min, corner);
+            slice_max = vector3_max(slice_max, corner);
+        }
+        slice_min = vector3_max(slice_min, (vector3){{-1.0f, -1.0f, 0.0f}});
+        slice_max = vector3_min(slice_max, (vector3){{1.0f, 1.0f, 0.0f}});
+        vector2 slice_center = {{(slice_min.x + slice_max.x) * 0.5f,
+                                 (slice_min.y + slice_max.y) * 0.5f}};
+        vector2 slice_extent = {
+            {float_max((slice_max.x - slice_min.x) * 0.5f, 1e-4f),
+             float_max((slice_max.y - slice_min.y) * 0.5f, 1e-4f)}};
+        stabilize_cascade(&slice_center.x, &slice_extent.x, SHADOW_MAP_WIDTH);
+        stabilize_cascade(&slice_center.y, &slice_extent.y, SHADOW_MAP_HEIGHT);
+        // Scale and move the slice to fill the clip space of the cascade.
+        matrix4x4 fit = matrix4x4_multiply(
+            matrix4x4_scale((vector3){
+                {1.0f / slice_extent.x, 1.0f / slice_extent.y, 1.0f}}),
+            matrix4x4_translate(
+                (vector3){{-slice_center.x, -slice_center.y, 0.0f}}));
+        cascade_world2clip[c] = matrix4x4_multiply(fit, light_world2clip);
+        // The same mapping between texture coordinates in [0, 1].
+        cascade_transforms[c] = (vector4){
+            {1.0f / slice_extent.x, 1.0f / slice_extent.y,
+             0.5f - (1.0f + slice_center.x) * 0.5f / slice_extent.x,
+             0.5f - (1.0f + slice_center.y) * 0.5f / slice_extent.y}};
+        split_near = split_far;
+    }
+}
+
 static void render_shadow_map(const struct model *model) {
     set_viewport(0, 0, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT);
-    set_vertex_shader(shadow_casting_vertex_shader);
-    set_fragment_shader(shadow_casting_fragment_shader);
-    clear_framebuffer(shadow_framebuffer);
-
-    struct shadow_casting_uniform uniform;
-    vector3 light_position =
-        vector3_multiply_scalar(vector3_normalize(light_direction), 5.0f);
-    matrix4x4 world2view = matrix4x4_look_at(light_position, VECTOR3_ZERO,
-                                             (vector3){{0.0f, 1.0f, 0.0f}});
-    matrix4x4 view2clip = matrix4x4_orthographic(1.5f, 1.5f, 0.1f, 6.0f);
-    light_world2clip = matrix4x4_multiply(view2clip, world2view);
-    // No rotation, scaling, or translation of the model, so the local2clip
-    // matrix is the world2clip matrix.
-    uniform.local2clip = light_world2clip;
+    fit_shadow_cascades(model);
 
-    const struct mesh *mesh = model->mesh;
-    uint32_t triangle_count = mesh->triangle_count;
-    for (size_t t = 0; t < triangle_count; t++) {
-        struct shadow_casting_vertex_attribute attributes[3];
-        const void *attribute_ptrs[3];
-        for (uint32_t v = 0; v < 3; v++) {
-            get_mesh_position(&attributes[v].position, mesh, t, v);
-            attribute_ptrs[v] = attributes + v;
+    for (uint32_t c = 0; c < SHADOW_CASCADE_COUNT; c++) {
+        struct shadow_cache *cache = &shadow_caches[c];
+        if (!cache->is_valid ||
+            cache->geometry_version != static_geometry_version ||
+            memcmp(&cache->world2clip, &cascade_world2clip[c],
+                   sizeof(matrix4x4)) != 0) {
+            clear_framebuffer(cache->framebuffer);
+            if (model->is_static) {
+                draw_shadow_casters(cache->framebuffer, model->mesh,
+                                    cascade_world2clip[c]);
+            }
+            // Let the shadow filtering skip the regions that are entirely lit
+            // or entirely in shadow.
+            generate_texture_depth_bounds(cache->map);
+            cache->world2clip = cascade_world2clip[c];
+            cache->geometry_version = static_geometry_version;
+            cache->is_valid = true;
+        }
+        if (model->is_static) {
+            cascade_shadow_maps[c] = cache->map;
+            continue;
+        }
+        // The dynamic models are drawn over a copy of the cached map, the
+        // depth test keeps the nearest caster of the two.
+        copy_texture(shadow_maps[c], cache->map);
+        draw_shadow_casters(shadow_framebuffers[c], model->mesh,
+                            cascade_world2clip[c]);
+        generate_texture_depth_bounds(shadow_maps[c]);
+        cascade_shadow_maps[c] = shadow_maps[c];
+    }
+}
+
+// Places the lights on a ring around the model, every fourth light is a spot
+// light pointing down.
+static bool create_lights(const struct model *model, uint32_t count) {
+    lights = malloc(count * sizeof(struct standard_light));
+    light_bounds = malloc(count * sizeof(vector4));
+    if (lights == NULL || light_bounds == NULL) {
+        free(lights);
+        free(light_bounds);
+        lights = NULL;
+        light_bounds = NULL;
+        return false;
+    }
+    vector3 center = vector3_multiply_scalar(
+        vector3_add(model->bounds_min, model->bounds_max), 0.5f);
+    vector3 extent = vector3_subtract(model->bounds_max, model->bounds_min);
+    float ring_radius = 0.4f * float_max(extent.x, extent.z);
+    for (uint32_t i = 0; i < count; i++) {
+        struct standard_light *light = &lights[i];
+        float angle = 2.0f * PI * (float)i / (float)count;
+        light->position = (vector3){
+            {center.x + ring_radius * cosf(angle),
+             model->bounds_min.y + (0.3f + 0.05f * (float)(i % 3)) * extent.y,
+             center.z + ring_radius * sinf(angle)}};
+        // Saturated colors around the hue circle.
+        light->intensity = (vector3){{0.5f + 0.5f * cosf(angle),
+                                      0.5f + 0.5f * cosf(angle - 2.094f),
+                                      0.5f + 0.5f * cosf(angle + 2.094f)}};
+        light->intensity = vector3_multiply_scalar(light->intensity, 0.2f);
+        light->range = 0.6f;
+        light->type = STANDARD_LIGHT_POINT;
+        if (i % 4 == 3) {
+            light->type = STANDARD_LIGHT_SPOT;
+            light->direction = (vector3){{0.0f, -1.0f, 0.0f}};
+            light->inner_cone_cos = cosf(0.4f);
+            light->outer_cone_cos = cosf(0.7f);
+            light->range = 1.0f;
         }
-        draw_triangle(shadow_framebuffer, &uniform, attribute_ptrs);
+        light_bounds[i] = vector3_to_4(light->position, light->range);
     }
+    light_count = count;
+    return true;
 }
 
-static void render_model(const struct model *model) {
+// Assigns the lights to the clusters of the camera view, once per frame. The
+// slices only cover the depth range of the model, so that they are thin.
+static void assign_lights(const struct model *model) {
+    float near, far;
+    get_model_depth_range(model, &near, &far);
+    assign_lights_to_clusters(light_clusters, get_camera_world2view(),
+                              get_camera_view2clip(), near, far, light_bounds,
+                              light_count);
+}
+
+// Tone maps with the ACES curve, then anti-aliases and sharpens the result.
+static bool create_post_processing(void) {
+    post_process_chain = create_post_process_chain();
+    if (post_process_chain == NULL) {
+        return false;
+    }
+    set_tone_mapping(TONE_MAPPING_ACES, 1.0f);
+    add_post_process_pass(post_process_chain, post_process_tone_mapping,
+                          POST_PROCESS_TONE_MAPPING_RADIUS, NULL);
+    add_post_process_pass(post_process_chain, post_process_fxaa,
+                          POST_PROCESS_FXAA_RADIUS, NULL);
+    add_post_process_pass(post_process_chain, post_process_sharpen,
+                          POST_PROCESS_SHARPEN_RADIUS, &sharpen_parameters);
+    return true;
+}
+
+// Binds the material map to the sampler, or unbinds the sampler if the map is
+// absent.
+static void bind_material_map(struct sampler *sampler,
+                              const struct texture *map) {
+    if (map != NULL) {
+        bind_sampler(sampler, map, TEXTURE_FILTER_TRILINEAR,
+                     TEXTURE_WRAP_CLAMP);
+    } else {
+        unbind_sampler(sampler);
+    }
+}
+
+static void render_model(const struct model *model, uint32_t frame) {
     set_viewport(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
     set_vertex_shader(standard_vertex_shader);
-    set_fragment_shader(standard_fragment_shader);
-    set_clear_color(0.49f, 0.33f, 0.41f, 1.0f);
+    // The clear color is written to the HDR color buffer as is, so it must be
+    // in linear space to look the same after the resolve.
+    set_clear_color(convert_to_linear_color(0.49f),
+                    convert_to_linear_color(0.33f),
+                    convert_to_linear_color(0.41f), 1.0f);
     clear_framebuffer(framebuffer);
 
     struct standard_uniform uniform;
     uniform.local2world = MATRIX4X4_IDENTITY;
-    matrix4x4 world2view = matrix4x4_look_at(camera_position, camera_target,
-                                             (vector3){{0.0f, 1.0f, 0.0f}});
-    matrix4x4 view2clip = matrix4x4_orthographic(2.0f, 2.0f, 0.1f, 10.0f);
-    uniform.world2clip = matrix4x4_multiply(view2clip, world2view);
+    matrix4x4 world2clip = get_camera_world2clip();
+    if (frame == 0) {
+        previous_world2clip = world2clip;
+    }
+    matrix4x4 jitter = get_jitter(frame);
+    uniform.world2clip = matrix4x4_multiply(jitter, world2clip);
+    // Both positions have the jitter of this frame, so the motion vectors only
+    // hold the movement of the camera and the model.
+    uniform.outputs_previous_position =
+        is_temporal_anti_aliased || reprojection_cache != NULL;
+    uniform.previous_local2clip = matrix4x4_multiply(
+        matrix4x4_multiply(jitter, previous_world2clip), uniform.local2world);
+    previous_world2clip = world2clip;
     uniform.local2world_direction = matrix4x4_to_3x3(uniform.local2world);
     // There is no non-uniform scaling so the normal transformation matrix is
     // the direction transformation matrix.
     uniform.local2world_normal = uniform.local2world_direction;
     uniform.camera_position = camera_position;
-    uniform.light_direction = vector3_normalize(light_direction);
-    uniform.illuminance = (vector3){{4.0f, 4.0f, 4.0f}};
+    uniform.light_direction = vector3_normalize(SCENE_LIGHT_DIRECTION);
+    uniform.illuminance = SCENE_LIGHT_ILLUMINANCE;
     // Remap each component of position from [-1, 1] to [0, 1].
     matrix4x4 scale_bias = {{{0.5f, 0.0f, 0.0f, 0.5f},
                              {0.0f, 0.5f, 0.0f, 0.5f},
                              {0.0f, 0.0f, 0.5f, 0.5f},
                              {0.0f, 0.0f, 0.0f, 1.0f}}};
     uniform.world2light = matrix4x4_multiply(scale_bias, light_world2clip);
-    uniform.shadow_map = shadow_map;
-    uniform.ambient_luminance = (vector3){{1.0f, 0.5f, 0.8f}};
-    uniform.normal_map = model->normal_map;
-    uniform.base_color = VECTOR3_ONE;
-    uniform.base_color_map = model->base_color_map;
-    uniform.metallic = 1.0f;
-    uniform.metallic_map = model->metallic_map;
-    uniform.roughness = 1.0f;
-    uniform.roughness_map = model->roughness_map;
+    uniform.shadow_cascade_count = 0;
+    uniform.shadow_filter_radius = 1;
+    if (lightmap != NULL) {
+        // The lightmap is bilinearly filtered like the shadow maps, it has no
+        // mipmap chain.
+        bind_sampler(&uniform.lightmap, lightmap, TEXTURE_FILTER_BILINEAR,
+                     TEXTURE_WRAP_CLAMP);
+    } else {
+        unbind_sampler(&uniform.lightmap);
+        uniform.shadow_cascade_count = SHADOW_CASCADE_COUNT;
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+            uniform.shadow_cascade_transforms[i] = cascade_transforms[i];
+            bind_sampler(&uniform.shadow_maps[i], cascade_shadow_maps[i],
+                         TEXTURE_FILTER_BILINEAR, TEXTURE_WRAP_CLAMP);
+        }
+    }
+    // A constant ambient occlusion is applied to the ambient lighting.
+    uniform.fast_math = fast_math;
+    uniform.ambient_luminance = vector3_multiply_scalar(
+        (vector3){{1.0f, 0.5f, 0.8f}}, model->material.r);
+    bind_material_map(&uniform.normal_map, model->normal_map);
+    uniform.base_color = vector4_to_3(model->base_color);
+    bind_material_map(&uniform.base_color_map, model->base_color_map);
+    uniform.material_maps = STANDARD_MATERIAL_MAPS_PACKED;
+    uniform.roughness = model->material.g;
+    uniform.metallic = model->material.b;
+    bind_material_map(&uniform.occlusion_roughness_metallic_map,
+                      model->material_map);
     uniform.reflectance = 0.5f;  // Common dielectric surfaces F0.
+    uniform.lights = lights;
+    // Without clusters, the lights are not evaluated.
+    uniform.light_count = light_clusters != NULL ? light_count : 0;
+    uniform.light_clusters = light_clusters;
+    set_fragment_shader(select_standard_fragment_shader(&uniform));
+    // The shadow maps are drawn without the cache, it is only set for the draws
+    // of the camera.
+    set_reprojection_cache(reprojection_cache);
+    set_uniform_prepare(standard_prepare_uniform);
 
     const struct mesh *mesh = model->mesh;
     uint32_t triangle_count = mesh->triangle_count;
@@ -149,14 +621,156 @@ static void render_model(const struct model *model) {
         }
         draw_triangle(framebuffer, &uniform, attribute_ptrs);
     }
+    set_reprojection_cache(NULL);
+}
+
+// Resolves the frame into the HDR color buffer and blends it into the history
+// of the previous frames, returns the new history.
+static struct texture *accumulate_frame(uint32_t frame) {
+    if (is_multisampled) {
+        resolve_multisample_texture(hdr_color_buffer, multisample_color_buffer);
+    }
+    struct texture *target = taa_histories[frame % 2];
+    const struct texture *history =
+        frame == 0 ? NULL : taa_histories[(frame + 1) % 2];
+    apply_temporal_anti_aliasing(target, hdr_color_buffer, history,
+                                 motion_vector_buffer, TAA_CURRENT_WEIGHT);
+    return target;
+}
+
+// Computes the region to render again since the last frame. The model is the
+// whole scene and only casts shadows on itself, so its shadows change within
+// its bounds.
+static void update_dirty_region(const struct model *model, uint32_t frame) {
+    clear_dirty_region(&dirty_region);
+    matrix4x4 world2clip = get_camera_world2clip();
+    struct pixel_rectangle bounds =
+        get_screen_bounds(world2clip, model->bounds_min, model->bounds_max,
+                          IMAGE_WIDTH, IMAGE_HEIGHT);
+    if (frame == 0 || memcmp(&rendered_world2clip, &world2clip,
+                             sizeof(matrix4x4)) != 0) {
+        struct pixel_rectangle screen = {0, 0, IMAGE_WIDTH, IMAGE_HEIGHT};
+        add_dirty_rectangle(&dirty_region, screen);
+    } else if (model->version != rendered_version) {
+        // Erase the model where it was and draw it where it is.
+        add_dirty_rectangle(&dirty_region, rendered_bounds);
+        add_dirty_rectangle(&dirty_region, bounds);
+    }
+    rendered_world2clip = world2clip;
+    rendered_bounds = bounds;
+    rendered_version = model->version;
+}
+
+// Renders the model again in the dirty rectangles only.
+static void render_dirty_region(const struct model *model, uint32_t frame) {
+    update_dirty_region(model, frame);
+    for (uint32_t i = 0; i < dirty_region.rectangle_count; i++) {
+        const struct pixel_rectangle *r = &dirty_region.rectangles[i];
+        set_scissor(r->left, r->bottom, r->right - r->left, r->top - r->bottom);
+        render_model(model, frame);
+    }
+    disable_scissor();
+}
+
+// Saves the imported texture as a page file, then streams the pages from the
+// file as a virtual texture. In a real application the page file is created
+// once when importing assets.
+static struct texture *stream_texture(struct texture *texture,
+                                      const char *page_file_path) {
+    bool is_saved = save_texture_pages(texture, page_file_path);
+    destroy_texture(texture);
+    if (!is_saved) {
+        return NULL;
+    }
+    return load_virtual_texture(page_file_path, TEXTURE_CACHE_PAGE_COUNT);
+}
+
+// Streams the page file of an image imported by an earlier run. The images are
+// only imported when their page file is missing, delete the page files to
+// import the images again.
+static struct texture *load_page_file(const char *page_file_path) {
+    return load_virtual_texture(page_file_path, TEXTURE_CACHE_PAGE_COUNT);
+}
+
+// Imports the image as a block compressed texture and streams it.
+static struct texture *load_streamed_image(const char *image_path,
+                                           const char *page_file_path,
+                                           enum texture_format format) {
+    struct texture *texture = load_page_file(page_file_path);
+    if (texture != NULL) {
+        return texture;
+    }
+    return stream_texture(load_compressed_image(image_path, format),
+                          page_file_path);
 }
 
-int main(void) {
+// Streams the material map from its page file if an earlier run saved one, the
+// constant is then set to 1.0. Returns false if there is no page file.
+static bool load_material_map(const char *page_file_path, struct texture **map,
+                              vector4 *constant) {
+    *map = load_page_file(page_file_path);
+    *constant = VECTOR4_ONE;
+    return *map != NULL;
+}
+
+// Streams the imported material map, unless its pixels are all the same. Then
+// the map is replaced with a null pointer and the constant is set to its value,
+// so that the shader does not sample it. Otherwise the constant is set to 1.0.
+static bool import_material_map(struct texture *texture,
+                                const char *page_file_path,
+                                struct texture **map, vector4 *constant) {
+    *map = NULL;
+    *constant = VECTOR4_ONE;
+    if (texture == NULL) {
+        return false;
+    }
+    if (is_texture_constant(texture, constant)) {
+        destroy_texture(texture);
+        return true;
+    }
+    *map = stream_texture(texture, page_file_path);
+    return *map != NULL;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t requested_light_count = 0;
+    bool is_baked_lighting = false;
+    bool is_post_processed = false;
+    bool is_reprojection_cached = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fast-math") == 0) {
+            fast_math = true;
+        } else if (strcmp(argv[i], "--msaa") == 0) {
+            is_multisampled = true;
+        } else if (strcmp(argv[i], "--taa") == 0) {
+            is_temporal_anti_aliased = true;
+        } else if (strcmp(argv[i], "--reprojection-cache") == 0) {
+            is_reprojection_cached = true;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            is_incremental = true;
+        } else if (strcmp(argv[i], "--tiled") == 0) {
+            is_tiled = true;
+        } else if (strcmp(argv[i], "--post-process") == 0) {
+            is_post_processed = true;
+        } else if (strcmp(argv[i], "--baked-lighting") == 0) {
+            is_baked_lighting = true;
+        } else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            requested_light_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frame_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+            frame_count = uint32_max(frame_count, 1);
+        }
+    }
+
     const char *model_path = "assets/cut_fish/cut_fish.obj";
     const char *base_color_map_path = "assets/cut_fish/base_color.tga";
     const char *normal_map_path = "assets/cut_fish/normal.tga";
     const char *metallic_map_path = "assets/cut_fish/metallic.tga";
     const char *roughness_map_path = "assets/cut_fish/roughness.tga";
+    const char *base_color_pages_path = "assets/cut_fish/base_color.pages";
+    const char *normal_pages_path = "assets/cut_fish/normal.pages";
+    const char *material_pages_path = "assets/cut_fish/material.pages";
+    const char *lightmap_path = "assets/cut_fish/lightmap.pages";
 
     struct model model;
     model.mesh = load_mesh(model_path);
@@ -164,31 +778,117 @@ int main(void) {
         printf("Cannot load .obj file.\n");
         return 0;
     }
-    model.base_color_map = load_image(base_color_map_path, true);
-    model.normal_map = load_image(normal_map_path, false);
-    model.metallic_map = load_image(metallic_map_path, false);
-    model.roughness_map = load_image(roughness_map_path, false);
-    if (model.base_color_map == NULL || model.normal_map == NULL ||
-        model.metallic_map == NULL || model.roughness_map == NULL) {
+    // The constant maps have no page file, they are imported on every run.
+    bool is_loaded =
+        load_material_map(base_color_pages_path, &model.base_color_map,
+                          &model.base_color) ||
+        import_material_map(
+            load_compressed_image(base_color_map_path, TEXTURE_FORMAT_BC1_SRGB),
+            base_color_pages_path, &model.base_color_map, &model.base_color);
+    model.normal_map = load_streamed_image(normal_map_path, normal_pages_path,
+                                           TEXTURE_FORMAT_BC5);
+    // The model has no ambient occlusion map.
+    is_loaded = (load_material_map(material_pages_path, &model.material_map,
+                                   &model.material) ||
+                 import_material_map(
+                     load_material_image(NULL, roughness_map_path,
+                                         metallic_map_path),
+                     material_pages_path, &model.material_map,
+                     &model.material)) &&
+                is_loaded;
+    // No transformation is applied to the model, so the bounds in model space
+    // are the bounds in world space.
+    get_mesh_bounds(&model.bounds_min, &model.bounds_max, model.mesh);
+    model.is_static = true;
+    model.version = 0;
+    // Adding a static model changes the shadows cached for the cascades.
+    static_geometry_version++;
+    if (!is_loaded || model.normal_map == NULL) {
         printf("Cannot load texture files.\n");
         destroy_mesh(model.mesh);
         destroy_texture(model.base_color_map);
         destroy_texture(model.normal_map);
-        destroy_texture(model.metallic_map);
-        destroy_texture(model.roughness_map);
+        destroy_texture(model.material_map);
         return 0;
     }
 
+    if (requested_light_count > 0 &&
+        !create_lights(&model, requested_light_count)) {
+        printf("Cannot create lights, rendering without them.\n");
+    }
+
+    if (is_baked_lighting) {
+        lightmap = load_virtual_texture(lightmap_path,
+                                        TEXTURE_CACHE_PAGE_COUNT);
+        if (lightmap == NULL) {
+            printf("Cannot load the lightmap, run lightmap_baker first. "
+                   "Rendering with shadow maps instead.\n");
+        }
+    }
+
+    if (is_post_processed && !create_post_processing()) {
+        printf("Cannot create the post-processing chain, resolving without "
+               "it.\n");
+    }
+
+    // Temporal anti-aliasing jitters every frame, so no part of the last frame
+    // can be kept.
+    if (is_incremental && is_temporal_anti_aliased) {
+        printf("Incremental rendering is not compatible with temporal "
+               "anti-aliasing, rendering whole frames.\n");
+        is_incremental = false;
+    }
+
+    // The cache does not apply to multisampled framebuffers.
+    if (is_reprojection_cached && !is_multisampled) {
+        reprojection_cache = create_reprojection_cache(
+            IMAGE_WIDTH, IMAGE_HEIGHT, REPROJECTION_DEPTH_TOLERANCE,
+            REPROJECTION_REFRESH_PERIOD);
+        if (reprojection_cache == NULL) {
+            printf("Cannot create the reprojection cache, shading every "
+                   "fragment.\n");
+        }
+    }
+
     initialize_rendering();
-    render_shadow_map(&model);
-    render_model(&model);
+    // The light and the model never move, so only the first frame renders the
+    // shadow maps.
+    struct texture *resolved_buffer = hdr_color_buffer;
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        if (lightmap == NULL) {
+            render_shadow_map(&model);
+        }
+        assign_lights(&model);
+        advance_reprojection_cache(reprojection_cache);
+        if (is_incremental) {
+            render_dirty_region(&model, frame);
+        } else {
+            render_model(&model, frame);
+        }
+        if (is_temporal_anti_aliased) {
+            resolved_buffer = accumulate_frame(frame);
+        }
+    }
+    if (is_multisampled && !is_temporal_anti_aliased) {
+        resolve_multisample_texture(hdr_color_buffer, multisample_color_buffer);
+    }
+    if (post_process_chain != NULL) {
+        apply_post_process_chain(post_process_chain, color_buffer,
+                                 resolved_buffer);
+    } else {
+        resolve_texture(color_buffer, resolved_buffer);
+    }
     save_image(color_buffer, "output.tga", false);
     end_rendering();
 
     destroy_mesh(model.mesh);
     destroy_texture(model.base_color_map);
     destroy_texture(model.normal_map);
-    destroy_texture(model.metallic_map);
-    destroy_texture(model.roughness_map);
+    destroy_texture(model.material_map);
+    destroy_texture(lightmap);
+    destroy_post_process_chain(post_process_chain);
+    destroy_reprojection_cache(reprojection_cache);
+    free(lights);
+    free(light_bounds);
     return 0;
 }
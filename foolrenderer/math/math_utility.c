@@ -32,3 +32,7 @@ extern float float_clamp(float n, float min, float max);
 extern float float_clamp01(float n);
 
 extern float float_lerp(float a, float b, float t);
+
+extern float float_rsqrt_fast(float x);
+
+extern float float_log2_fast(float x);
@@ -43,4 +43,33 @@ inline float float_clamp01(float n) { return float_clamp(n, 0.0f, 1.0f); }
 
 inline float float_lerp(float a, float b, float t) { return a + t * (b - a); }
 
+// Approximates 1 / sqrt(x) for x > 0, with a relative error below 4.8e-6. Uses
+// the bit-level initial guess followed by two Newton-Raphson iterations, refer
+// to:
+// https://en.wikipedia.org/wiki/Fast_inverse_square_root
+inline float float_rsqrt_fast(float x) {
+    union {
+        float f;
+        uint32_t u;
+    } bits = {x};
+    bits.u = 0x5F375A86u - (bits.u >> 1);
+    float y = bits.f;
+    y = y * (1.5f - 0.5f * x * y * y);
+    return y * (1.5f - 0.5f * x * y * y);
+}
+
+// Approximates log2(x) for normal x > 0, with an absolute error below 8.8e-4.
+// The exponent is read from the bits, log2 of the mantissa m in [1,2) is
+// approximated by a cubic polynomial of t = m - 1 which is exact at both ends.
+inline float float_log2_fast(float x) {
+    union {
+        float f;
+        uint32_t u;
+    } bits = {x};
+    float exponent = (float)((int32_t)(bits.u >> 23) - 127);
+    bits.u = (bits.u & 0x007FFFFFu) | 0x3F800000u;
+    float t = bits.f - 1.0f;
+    return exponent + t + t * (1.0f - t) * (0.42286530f - 0.15921936f * t);
+}
+
 #endif  // FOOLRENDERER_MATH_MATH_UTILITY_H_
@@ -67,8 +67,14 @@ extern float vector3_magnitude_squared(vector3 v);
 
 extern vector3 vector3_normalize(vector3 v);
 
+extern vector3 vector3_normalize_fast(vector3 v);
+
 extern vector3 vector3_lerp(vector3 a, vector3 b, float t);
 
+extern vector3 vector3_min(vector3 v1, vector3 v2);
+
+extern vector3 vector3_max(vector3 v1, vector3 v2);
+
 extern vector4 vector4_add(vector4 v1, vector4 v2);
 
 extern vector4 vector4_add_scalar(vector4 v, float scalar);
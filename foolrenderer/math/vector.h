@@ -322,6 +322,22 @@ inline vector3 vector3_normalize(vector3 v) {
     return vector3_multiply_scalar(v, 1.0f / sqrtf(square_magnitude));
 }
 
+///
+/// \brief Gets an approximately normalized copy of the 3D vector.
+///
+/// Faster than vector3_normalize() by using float_rsqrt_fast() instead of a
+/// square root and a division. The magnitude of the result differs from 1 by
+/// less than 4.8e-6. Returns a zero vector if the vector magnitude is 0.
+///
+/// \param v The vector to be normalized.
+/// \return Returns an approximately normalized copy of the vector.
+///
+inline vector3 vector3_normalize_fast(vector3 v) {
+    // float_rsqrt_fast(0) is finite, so a zero vector stays a zero vector.
+    return vector3_multiply_scalar(
+        v, float_rsqrt_fast(vector3_magnitude_squared(v)));
+}
+
 inline vector3 vector3_lerp(vector3 a, vector3 b, float t) {
     float x = float_lerp(a.x, b.x, t);
     float y = float_lerp(a.y, b.y, t);
@@ -329,6 +345,16 @@ inline vector3 vector3_lerp(vector3 a, vector3 b, float t) {
     return (vector3){{x, y, z}};
 }
 
+inline vector3 vector3_min(vector3 v1, vector3 v2) {
+    return (vector3){{float_min(v1.x, v2.x), float_min(v1.y, v2.y),
+                      float_min(v1.z, v2.z)}};
+}
+
+inline vector3 vector3_max(vector3 v1, vector3 v2) {
+    return (vector3){{float_max(v1.x, v2.x), float_max(v1.y, v2.y),
+                      float_max(v1.z, v2.z)}};
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // 4D vector functions.
@@ -77,9 +77,12 @@ vector4 basic_fragment_shader(struct shader_context *input,
                               const void *uniform) {
     const struct basic_uniform *unif = uniform;
     vector2 texcoord = *shader_context_vector2(input, TEXCOORD);
+    vector2 texcoord_ddx = shader_context_ddx_vector2(input, TEXCOORD);
+    vector2 texcoord_ddy = shader_context_ddy_vector2(input, TEXCOORD);
 
     // Get the normal in tangent space.
-    vector3 normal = vector4_to_3(texture_sample(unif->normal_map, texcoord));
+    vector3 normal = vector4_to_3(texture_sample_grad(
+        unif->normal_map, texcoord, texcoord_ddx, texcoord_ddy));
     normal =
         vector3_subtract_scalar(vector3_multiply_scalar(normal, 2.0f), 1.0f);
     // Transform the normal from tangent space to view space
@@ -132,7 +135,8 @@ vector4 basic_fragment_shader(struct shader_context *input,
     diffuse_lighting = vector3_multiply_scalar(diffuse_lighting, visibility);
     specular_lighting = vector3_multiply_scalar(specular_lighting, visibility);
 
-    vector4 texture_color = texture_sample(unif->diffuse_map, texcoord);
+    vector4 texture_color = texture_sample_grad(unif->diffuse_map, texcoord,
+                                                texcoord_ddx, texcoord_ddy);
     vector3 fragment_color = vector3_add(ambient_lighting, diffuse_lighting);
     fragment_color =
         vector3_multiply(fragment_color, vector4_to_3(texture_color));
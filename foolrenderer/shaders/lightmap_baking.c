@@ -0,0 +1,107 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "shaders/lightmap_baking.h"
+
+#include "graphics/shader_context.h"
+#include "graphics/texture.h"
+#include "math/math_utility.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+#include "shaders/shadow_casting.h"
+
+#define TEXCOORD 0
+#define WORLD_SPACE_NORMAL 0
+#define WORLD_SPACE_TANGENT 1
+#define WORLD_SPACE_BITANGENT 2
+#define LIGHT_SPACE_POSITION 3
+
+vector4 lightmap_baking_vertex_shader(struct shader_context *output,
+                                      const void *uniform,
+                                      const void *vertex_attribute) {
+    const struct lightmap_baking_uniform *unif = uniform;
+    const struct lightmap_baking_vertex_attribute *attr = vertex_attribute;
+
+    vector2 *out_texcoord = shader_context_vector2(output, TEXCOORD);
+    *out_texcoord = attr->texcoord;
+
+    vector3 *out_normal = shader_context_vector3(output, WORLD_SPACE_NORMAL);
+    *out_normal =
+        matrix3x3_multiply_vector3(unif->local2world_normal, attr->normal);
+
+    vector3 *out_tangent = shader_context_vector3(output, WORLD_SPACE_TANGENT);
+    *out_tangent = matrix3x3_multiply_vector3(unif->local2world_direction,
+                                              vector4_to_3(attr->tangent));
+
+    vector3 *out_bitangent =
+        shader_context_vector3(output, WORLD_SPACE_BITANGENT);
+    *out_bitangent = vector3_multiply_scalar(
+        vector3_cross(*out_normal, *out_tangent), attr->tangent.w);
+
+    vector4 world_position = matrix4x4_multiply_vector4(
+        unif->local2world, vector3_to_4(attr->position, 1.0f));
+    vector4 light_space_position =
+        matrix4x4_multiply_vector4(unif->world2light, world_position);
+    vector3 *out_light_space_position =
+        shader_context_vector3(output, LIGHT_SPACE_POSITION);
+    // The light space of a directional light is orthogonal, no need for
+    // homogeneous division.
+    *out_light_space_position = vector4_to_3(light_space_position);
+
+    // Remap the texture coordinate from [0, 1] to [-1, 1]. The depth is not
+    // used, all texels are at the same depth.
+    return (vector4){{attr->texcoord.u * 2.0f - 1.0f,
+                      attr->texcoord.v * 2.0f - 1.0f, 0.0f, 1.0f}};
+}
+
+static inline float shadow(struct shader_context *input,
+                           const struct lightmap_baking_uniform *uniform) {
+    vector3 position = *shader_context_vector3(input, LIGHT_SPACE_POSITION);
+    float reference = position.z - SHADOW_DEPTH_BIAS;
+    vector2 texcoord = {{position.x, position.y}};
+    if (uniform->shadow_filter_radius == 0) {
+        return sampler_sample_compare(&uniform->shadow_map, texcoord,
+                                      reference);
+    }
+    return sampler_sample_compare_pcf(&uniform->shadow_map, texcoord,
+                                      reference, uniform->shadow_filter_radius);
+}
+
+// Gets the normalized normal in world space.
+static inline vector3 get_normal(
+    struct shader_context *input,
+    const struct lightmap_baking_uniform *uniform) {
+    vector3 n = vector3_normalize(
+        *shader_context_vector3(input, WORLD_SPACE_NORMAL));
+    if (uniform->normal_map.texture == NULL) {
+        return n;
+    }
+    vector2 texcoord = *shader_context_vector2(input, TEXCOORD);
+    // The derivatives of the texture coordinate are the size of a texel of the
+    // lightmap, so the normal map is filtered down to its resolution.
+    vector2 ddx = shader_context_ddx_vector2(input, TEXCOORD);
+    vector2 ddy = shader_context_ddy_vector2(input, TEXCOORD);
+    vector3 normal = vector4_to_3(
+        sampler_sample_grad(&uniform->normal_map, texcoord, ddx, ddy));
+    normal =
+        vector3_subtract_scalar(vector3_multiply_scalar(normal, 2.0f), 1.0f);
+    vector3 t = vector3_normalize(
+        *shader_context_vector3(input, WORLD_SPACE_TANGENT));
+    vector3 b = vector3_normalize(
+        *shader_context_vector3(input, WORLD_SPACE_BITANGENT));
+    matrix3x3 tangent2world = matrix3x3_construct(t, b, n);
+    return matrix3x3_multiply_vector3(tangent2world, normal);
+}
+
+vector4 lightmap_baking_fragment_shader(struct shader_context *input,
+                                        const void *uniform) {
+    const struct lightmap_baking_uniform *unif = uniform;
+    vector3 normal = get_normal(input, unif);
+    float n_dot_l = float_max(vector3_dot(normal, unif->light_direction), 0.0f);
+    float visibility = shadow(input, unif);
+    vector3 lighting =
+        vector3_multiply_scalar(unif->illuminance, n_dot_l * visibility);
+    return vector3_to_4(lighting, visibility);
+}
@@ -0,0 +1,68 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_SHADERS_LIGHTMAP_BAKING_H_
+#define FOOLRENDERER_SHADERS_LIGHTMAP_BAKING_H_
+
+#include <stdint.h>
+
+#include "graphics/shader_context.h"
+#include "graphics/texture.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+
+// The lightmap baking shader rasterizes a mesh in texture space instead of
+// screen space, so that every texel of the lightmap covered by the mesh is
+// shaded once. For each texel, it stores the direct lighting of the
+// directional light that the standard shader would compute for the diffuse
+// term, and the shadow visibility. For lightmaps, refer to:
+// https://en.wikipedia.org/wiki/Lightmap
+//
+// The lightmap is a TEXTURE_FORMAT_RGBA16F texture: its RGB components are
+// illuminance * n_dot_l * visibility, and its A component is the visibility.
+// The texture coordinates of the mesh must not overlap.
+
+struct lightmap_baking_uniform {
+    matrix4x4 local2world;
+    matrix3x3 local2world_direction;
+    matrix3x3 local2world_normal;
+    // Normalized directional light direction in world space.
+    vector3 light_direction;
+    // Directional light illuminance.
+    vector3 illuminance;
+    // Transform vertex positions from world space to the light space of the
+    // shadow map, each component of position ranges from 0 to 1 in it.
+    matrix4x4 world2light;
+    // The shadow map covering the whole mesh, sampled by depth comparison.
+    struct sampler shadow_map;
+    // The radius in texels of the percentage closer filtering kernel.
+    uint32_t shadow_filter_radius;
+    // The normal map of the material. If unbound, the interpolated normal is
+    // used.
+    struct sampler normal_map;
+};
+
+struct lightmap_baking_vertex_attribute {
+    vector3 position;
+    vector3 normal;
+    vector4 tangent;
+    vector2 texcoord;
+};
+
+///
+/// \brief Places the vertex at its texture coordinate.
+///
+/// The texture coordinates in [0,1] cover the whole viewport, so the viewport
+/// should be the size of the lightmap. Triangles mirrored in texture space are
+/// back-facing, draw them with the reversed vertex order.
+///
+vector4 lightmap_baking_vertex_shader(struct shader_context *output,
+                                      const void *uniform,
+                                      const void *vertex_attribute);
+
+vector4 lightmap_baking_fragment_shader(struct shader_context *input,
+                                        const void *uniform);
+
+#endif  // FOOLRENDERER_SHADERS_LIGHTMAP_BAKING_H_
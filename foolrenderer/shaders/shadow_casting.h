@@ -14,6 +14,12 @@
 // algorithm, refer to:
 // https://en.wikipedia.org/wiki/Shadow_mapping
 
+// The offset subtracted from the depth of a receiver before comparing it with a
+// shadow map rendered by this shader, which solves shadow acne. Every shader
+// sampling the shadow maps uses it, so that the baked shadows match the
+// rendered ones.
+#define SHADOW_DEPTH_BIAS 0.005f
+
 struct shadow_casting_uniform {
     matrix4x4 local2clip;
 };
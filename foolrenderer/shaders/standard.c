@@ -5,13 +5,19 @@
 
 #include "shaders/standard.h"
 
+#include <assert.h>
 #include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
 
+#include "graphics/light_clusters.h"
+#include "graphics/rasterizer.h"
 #include "graphics/shader_context.h"
 #include "graphics/texture.h"
 #include "math/math_utility.h"
 #include "math/matrix.h"
 #include "math/vector.h"
+#include "shaders/shadow_casting.h"
 
 #define TEXCOORD 0
 #define WORLD_SPACE_POSITION 0
@@ -19,64 +25,217 @@
 #define WORLD_SPACE_TANGENT 2
 #define WORLD_SPACE_BITANGENT 3
 #define LIGHT_SPACE_POSITION 4
+#define PREVIOUS_CLIP_POSITION STANDARD_PREVIOUS_CLIP_POSITION
+
+// Flags telling which material maps are bound, and whether the fast math mode
+// is enabled. A variant of the fragment shader is compiled for every valid
+// combination, METALLIC_MAP and ROUGHNESS_MAP are never combined with
+// PACKED_MATERIAL_MAP.
+#define NORMAL_MAP 0x1
+#define BASE_COLOR_MAP 0x2
+#define METALLIC_MAP 0x4
+#define ROUGHNESS_MAP 0x8
+#define PACKED_MATERIAL_MAP 0x10
+#define FAST_MATH 0x20
+#define VARIANT_COUNT (FAST_MATH + PACKED_MATERIAL_MAP + 4)
+
+// The constants read by the fragment shader, prepared once per draw from the
+// standard_uniform by standard_prepare_uniform(). The members used by every
+// fragment come first, the samplers last.
+struct standard_constants {
+    // The flags of the bound material maps.
+    uint32_t maps;
+    float shadow_bias;
+    uint32_t shadow_filter_radius;
+    uint32_t shadow_cascade_count;
+    vector4 shadow_cascade_transforms[MAX_SHADOW_CASCADES];
+    // The margin of each cascade in texture coordinates. The kernel of the
+    // fragments in the margin would reach beyond the edge of the shadow map.
+    vector2 shadow_cascade_margins[MAX_SHADOW_CASCADES];
+    vector3 camera_position;
+    vector3 light_direction;
+    vector3 illuminance;
+    vector3 ambient_luminance;
+    // The material parameters of the uniform.
+    vector3 base_color;
+    float metallic;
+    float roughness;
+    // 0.16 * reflectance^2, the F0 of dielectric surfaces.
+    float dielectric_f0;
+    // Derived from the material parameters of the uniform. Used as they are
+    // when no map modulates the parameters they depend on.
+    vector3 diffuse_color;
+    vector3 f0;
+    // The roughness remapped from the perceptual roughness, and its square.
+    float alpha;
+    float a2;
+    const struct standard_light *lights;
+    uint32_t light_count;
+    const struct light_clusters *light_clusters;
+    struct sampler shadow_maps[MAX_SHADOW_CASCADES];
+    struct sampler normal_map;
+    struct sampler base_color_map;
+    struct sampler metallic_map;
+    struct sampler roughness_map;
+    struct sampler occlusion_roughness_metallic_map;
+    struct sampler lightmap;
+};
+
+static_assert(sizeof(struct standard_constants) <= MAX_PREPARED_UNIFORM_SIZE,
+              "The constants of the standard shader are too large.");
 
 struct material_parameter {
     vector3 normal;  // In tangent space.
     vector3 base_color;
     float metallic;
     float roughness;
-    float reflectance;
+    float occlusion;
 };
 
+static inline float shadow_cascade(const struct sampler *shadow_map,
+                                   vector2 texcoord, float reference,
+                                   uint32_t filter_radius) {
+    if (filter_radius == 0) {
+        return sampler_sample_compare(shadow_map, texcoord, reference);
+    }
+    return sampler_sample_compare_pcf(shadow_map, texcoord, reference,
+                                      filter_radius);
+}
+
 static inline float shadow(struct shader_context *input,
-                           const struct standard_uniform *uniform) {
+                           const struct standard_constants *constants) {
     vector3 position = *shader_context_vector3(input, LIGHT_SPACE_POSITION);
-    float current_depth = position.z;
-    float bias = 0.005f;  // Slove shadow acne.
-    float closest_depth =
-        texture_sample(uniform->shadow_map, vector3_to_2(position)).r;
-    float visibility = current_depth - bias > closest_depth ? 0.0f : 1.0f;
-    return visibility;
+    float reference = position.z - constants->shadow_bias;
+    for (uint32_t i = 0; i < constants->shadow_cascade_count; i++) {
+        vector4 transform = constants->shadow_cascade_transforms[i];
+        vector2 margin = constants->shadow_cascade_margins[i];
+        vector2 texcoord = {{position.x * transform.x + transform.z,
+                             position.y * transform.y + transform.w}};
+        if (texcoord.u >= margin.u && texcoord.u <= 1.0f - margin.u &&
+            texcoord.v >= margin.v && texcoord.v <= 1.0f - margin.v) {
+            return shadow_cascade(&constants->shadow_maps[i], texcoord,
+                                  reference, constants->shadow_filter_radius);
+        }
+    }
+    return 1.0f;
+}
+
+// Gets the flags of the material maps bound in the uniform and of the shading
+// mode.
+static inline uint32_t get_material_maps(
+    const struct standard_uniform *uniform) {
+    uint32_t maps = 0;
+    if (uniform->normal_map.texture != NULL) {
+        maps |= NORMAL_MAP;
+    }
+    if (uniform->base_color_map.texture != NULL) {
+        maps |= BASE_COLOR_MAP;
+    }
+    if (uniform->material_maps == STANDARD_MATERIAL_MAPS_PACKED) {
+        if (uniform->occlusion_roughness_metallic_map.texture != NULL) {
+            maps |= PACKED_MATERIAL_MAP;
+        }
+    } else {
+        if (uniform->metallic_map.texture != NULL) {
+            maps |= METALLIC_MAP;
+        }
+        if (uniform->roughness_map.texture != NULL) {
+            maps |= ROUGHNESS_MAP;
+        }
+    }
+    if (uniform->fast_math) {
+        maps |= FAST_MATH;
+    }
+    return maps;
+}
+
+// Samples a material map, the level of detail is computed from the derivatives
+// of the texture coordinate. In the fast math mode, the logarithm is
+// approximated, which changes the level of detail by less than 5e-4.
+static inline vector4 sample_map(const struct sampler *sampler,
+                                 vector2 texcoord, vector2 ddx, vector2 ddy,
+                                 bool fast) {
+    if (!fast) {
+        return sampler_sample_grad(sampler, texcoord, ddx, ddy);
+    }
+    vector2 dx = (vector2){{ddx.u * sampler->width, ddx.v * sampler->height}};
+    vector2 dy = (vector2){{ddy.u * sampler->width, ddy.v * sampler->height}};
+    float rho_squared = float_max(vector2_dot(dx, dx), vector2_dot(dy, dy));
+    // Zero derivatives give a large negative value clamped to the base level.
+    float lod = 0.5f * float_log2_fast(rho_squared);
+    return sampler_sample_lod(sampler, texcoord, lod);
 }
 
 // Process user input of material properties into a form that is convenient for
-// the shader to use.
+// the shader to use. Only the maps in the maps flags are sampled, the material
+// parameters of the other maps are the values of the uniform.
 static inline void compute_material_parameter(
-    struct material_parameter *param, const struct standard_uniform *uniform,
-    vector2 texcoord) {
-    vector3 normal =
-        vector4_to_3(texture_sample(uniform->normal_map, texcoord));
-    normal =
-        vector3_subtract_scalar(vector3_multiply_scalar(normal, 2.0f), 1.0f);
-    param->normal = normal;
-    vector3 base_color =
-        vector4_to_3(texture_sample(uniform->base_color_map, texcoord));
-    base_color = vector3_multiply(uniform->base_color, base_color);
-    param->base_color = base_color;
-    float metallic = texture_sample(uniform->metallic_map, texcoord).r;
-    metallic *= uniform->metallic;
-    param->metallic = metallic;
-    float roughness = texture_sample(uniform->roughness_map, texcoord).r;
-    roughness *= uniform->roughness;
-    param->roughness = roughness;
-    param->reflectance = uniform->reflectance;
-}
-
-static inline float perceptual_roughness_to_a2(float perceptual_roughness) {
+    struct material_parameter *param,
+    const struct standard_constants *uniform, struct shader_context *input,
+    uint32_t maps) {
+    param->normal = (vector3){{0.0f, 0.0f, 1.0f}};
+    param->base_color = uniform->base_color;
+    param->metallic = uniform->metallic;
+    param->roughness = uniform->roughness;
+    param->occlusion = 1.0f;
+    if (maps == 0) {
+        return;
+    }
+    vector2 texcoord = *shader_context_vector2(input, TEXCOORD);
+    // All material maps share the same texture coordinate, so their level of
+    // detail are computed from the same derivatives.
+    vector2 ddx = shader_context_ddx_vector2(input, TEXCOORD);
+    vector2 ddy = shader_context_ddy_vector2(input, TEXCOORD);
+    bool fast = maps & FAST_MATH;
+    if (maps & NORMAL_MAP) {
+        vector3 normal = vector4_to_3(
+            sample_map(&uniform->normal_map, texcoord, ddx, ddy, fast));
+        param->normal = vector3_subtract_scalar(
+            vector3_multiply_scalar(normal, 2.0f), 1.0f);
+    }
+    if (maps & BASE_COLOR_MAP) {
+        vector3 base_color = vector4_to_3(
+            sample_map(&uniform->base_color_map, texcoord, ddx, ddy, fast));
+        param->base_color = vector3_multiply(param->base_color, base_color);
+    }
+    if (maps & PACKED_MATERIAL_MAP) {
+        vector4 orm = sample_map(&uniform->occlusion_roughness_metallic_map,
+                                 texcoord, ddx, ddy, fast);
+        param->occlusion = orm.r;
+        param->roughness *= orm.g;
+        param->metallic *= orm.b;
+    }
+    if (maps & METALLIC_MAP) {
+        param->metallic *=
+            sample_map(&uniform->metallic_map, texcoord, ddx, ddy, fast).r;
+    }
+    if (maps & ROUGHNESS_MAP) {
+        param->roughness *=
+            sample_map(&uniform->roughness_map, texcoord, ddx, ddy, fast).r;
+    }
+}
+
+static inline float perceptual_roughness_to_roughness(
+    float perceptual_roughness) {
     // Prevent being zero, and prevent perceptual_oughness^4 from going out of
     // range of precision.
     perceptual_roughness = float_max(perceptual_roughness, 0.045f);
-    float roughness = perceptual_roughness * perceptual_roughness;
-    return roughness * roughness;
+    return perceptual_roughness * perceptual_roughness;
 }
 
-static inline matrix3x3 construct_tangent2world(struct shader_context *input) {
+// Normalizes the vector, approximately in the fast math mode.
+static inline vector3 normalize(vector3 v, bool fast) {
+    return fast ? vector3_normalize_fast(v) : vector3_normalize(v);
+}
+
+static inline matrix3x3 construct_tangent2world(struct shader_context *input,
+                                                bool fast) {
     vector3 t =
-        vector3_normalize(*shader_context_vector3(input, WORLD_SPACE_TANGENT));
-    vector3 b = vector3_normalize(
-        *shader_context_vector3(input, WORLD_SPACE_BITANGENT));
+        normalize(*shader_context_vector3(input, WORLD_SPACE_TANGENT), fast);
+    vector3 b =
+        normalize(*shader_context_vector3(input, WORLD_SPACE_BITANGENT), fast);
     vector3 n =
-        vector3_normalize(*shader_context_vector3(input, WORLD_SPACE_NORMAL));
+        normalize(*shader_context_vector3(input, WORLD_SPACE_NORMAL), fast);
     return matrix3x3_construct(t, b, n);
 }
 
@@ -112,13 +271,26 @@ static inline float v_smith_ggx_correlated(float a2, float n_dot_l,
     return 0.5 / (lambda_v + lambda_l);
 }
 
-static inline vector3 specular_lobe(float a2, vector3 f0, float n_dot_h,
-                                    float n_dot_l, float n_dot_v,
-                                    float l_dot_h) {
+static inline float v_smith_ggx_correlated_fast(float roughness, float n_dot_l,
+                                                float n_dot_v) {
+    // Approximation of v_smith_ggx_correlated() without square roots, refer
+    // to:
+    // https://google.github.io/filament/Filament.html#listing_approximatedspecularv
+    // The relative error is up to 26% at grazing angles on smooth surfaces, and
+    // below 14% when n_dot_l and n_dot_v are both at least 0.5.
+    float v = float_lerp(2.0f * n_dot_l * n_dot_v, n_dot_l + n_dot_v,
+                         roughness);
+    return 0.5f / v;
+}
+
+static inline vector3 specular_lobe(float roughness, float a2, vector3 f0,
+                                    float n_dot_h, float n_dot_l,
+                                    float n_dot_v, float l_dot_h, bool fast) {
     // Using Cook-Torrance microfacet BRDF.
     vector3 f = f_schlick(f0, l_dot_h);
     float d = d_ggx(a2, n_dot_h);
-    float v = v_smith_ggx_correlated(a2, n_dot_l, n_dot_v);
+    float v = fast ? v_smith_ggx_correlated_fast(roughness, n_dot_l, n_dot_v)
+                   : v_smith_ggx_correlated(a2, n_dot_l, n_dot_v);
     return vector3_multiply_scalar(f, d * v);
 }
 
@@ -127,6 +299,61 @@ static inline vector3 diffuse_lobe(vector3 diffuse_color) {
     return vector3_multiply_scalar(diffuse_color, 1.0f / PI);
 }
 
+// Adds up the light reflected towards the viewer from the point and spot lights
+// of the cluster containing the position.
+static inline vector3 shade_lights(const struct standard_constants *constants,
+                                   vector3 position, vector3 normal,
+                                   vector3 view, float n_dot_v, vector3 fd,
+                                   vector3 f0, float roughness, float a2,
+                                   bool fast) {
+    vector3 output = VECTOR3_ZERO;
+    uint32_t light_count;
+    const uint32_t *light_indices =
+        get_cluster_lights(constants->light_clusters, position, &light_count);
+    for (uint32_t i = 0; i < light_count; i++) {
+        const struct standard_light *light =
+            &constants->lights[light_indices[i]];
+        vector3 to_light = vector3_subtract(light->position, position);
+        float distance2 = vector3_dot(to_light, to_light);
+        float range2 = light->range * light->range;
+        if (distance2 >= range2) {
+            continue;
+        }
+        vector3 light_direction = normalize(to_light, fast);
+        float n_dot_l = vector3_dot(normal, light_direction);
+        if (n_dot_l <= 0.0f) {
+            continue;
+        }
+        // The inverse square law, smoothly reaching 0 at the range.
+        float factor = distance2 / range2;
+        float falloff = float_clamp01(1.0f - factor * factor);
+        float attenuation = falloff * falloff / float_max(distance2, 1e-4f);
+        if (light->type == STANDARD_LIGHT_SPOT) {
+            float cd = -vector3_dot(light_direction, light->direction);
+            float cone_width =
+                light->inner_cone_cos - light->outer_cone_cos;
+            float scale = 1.0f / float_max(cone_width, 1e-4f);
+            float angular = float_clamp01((cd - light->outer_cone_cos) * scale);
+            attenuation *= angular * angular;
+        }
+        vector3 halfway = normalize(vector3_add(view, light_direction), fast);
+        float n_dot_h = float_max(vector3_dot(normal, halfway), 0.0f);
+        float l_dot_h = float_max(vector3_dot(light_direction, halfway), 0.0f);
+        if (fast) {
+            n_dot_l = float_min(n_dot_l, 1.0f);
+            n_dot_h = float_min(n_dot_h, 1.0f);
+            l_dot_h = float_min(l_dot_h, 1.0f);
+        }
+        vector3 fr = specular_lobe(roughness, a2, f0, n_dot_h, n_dot_l,
+                                   n_dot_v, l_dot_h, fast);
+        vector3 illuminance = vector3_multiply_scalar(light->intensity,
+                                                      n_dot_l * attenuation);
+        output = vector3_add(
+            output, vector3_multiply(vector3_add(fr, fd), illuminance));
+    }
+    return output;
+}
+
 vector4 standard_vertex_shader(struct shader_context *output,
                                const void *uniform,
                                const void *vertex_attribute) {
@@ -164,48 +391,128 @@ vector4 standard_vertex_shader(struct shader_context *output,
     // always equal to 1.0f, so no need for homogeneous division.
     *out_light_space_position = vector4_to_3(light_space_position);
 
+    if (unif->outputs_previous_position) {
+        vector4 *out_previous_position =
+            shader_context_vector4(output, PREVIOUS_CLIP_POSITION);
+        *out_previous_position =
+            matrix4x4_multiply_vector4(unif->previous_local2clip,
+                                       vector3_to_4(attr->position, 1.0f));
+    }
+
     return matrix4x4_multiply_vector4(unif->world2clip, world_position);
 }
 
-vector4 standard_fragment_shader(struct shader_context *input,
-                                 const void *uniform) {
-    vector2 texcoord = *shader_context_vector2(input, TEXCOORD);
-    vector3 position = *shader_context_vector3(input, WORLD_SPACE_POSITION);
+static inline void compute_reflectance(vector3 *diffuse_color, vector3 *f0,
+                                       vector3 base_color, float metallic,
+                                       float dielectric_f0) {
+    *diffuse_color = vector3_multiply_scalar(base_color, (1.0f - metallic));
+    vector3 conductor_f0 = vector3_multiply_scalar(base_color, metallic);
+    *f0 = vector3_add_scalar(conductor_f0, dielectric_f0 * (1.0f - metallic));
+}
+
+void standard_prepare_uniform(void *prepared, const void *uniform) {
+    struct standard_constants *constants = prepared;
     const struct standard_uniform *unif = uniform;
-    vector3 camera_position = unif->camera_position;
-    vector3 light_direction = unif->light_direction;
-    vector3 illuminance = unif->illuminance;
-    vector3 ambient_luminance = unif->ambient_luminance;
+    constants->maps = get_material_maps(unif);
+    constants->shadow_bias = SHADOW_DEPTH_BIAS;
+    constants->shadow_filter_radius = unif->shadow_filter_radius;
+    constants->camera_position = unif->camera_position;
+    constants->light_direction = unif->light_direction;
+    constants->illuminance = unif->illuminance;
+    constants->ambient_luminance = unif->ambient_luminance;
+    constants->base_color = unif->base_color;
+    constants->metallic = unif->metallic;
+    constants->roughness = unif->roughness;
+    constants->dielectric_f0 = 0.16f * unif->reflectance * unif->reflectance;
+    compute_reflectance(&constants->diffuse_color, &constants->f0,
+                        unif->base_color, unif->metallic,
+                        constants->dielectric_f0);
+    float roughness = perceptual_roughness_to_roughness(unif->roughness);
+    constants->alpha = roughness;
+    constants->a2 = roughness * roughness;
+    constants->lights = unif->lights;
+    constants->light_count = unif->light_count;
+    constants->light_clusters = unif->light_clusters;
+    constants->shadow_cascade_count = unif->shadow_cascade_count;
+    for (uint32_t i = 0; i < unif->shadow_cascade_count; i++) {
+        const struct sampler *shadow_map = &unif->shadow_maps[i];
+        // The kernel reaches filter_radius + 1 texels from the coordinate.
+        float texels = (float)unif->shadow_filter_radius + 1.0f;
+        constants->shadow_cascade_transforms[i] =
+            unif->shadow_cascade_transforms[i];
+        constants->shadow_cascade_margins[i] = (vector2){
+            {texels / shadow_map->width, texels / shadow_map->height}};
+        constants->shadow_maps[i] = *shadow_map;
+    }
+    constants->normal_map = unif->normal_map;
+    constants->base_color_map = unif->base_color_map;
+    constants->metallic_map = unif->metallic_map;
+    constants->roughness_map = unif->roughness_map;
+    constants->occlusion_roughness_metallic_map =
+        unif->occlusion_roughness_metallic_map;
+    constants->lightmap = unif->lightmap;
+}
+
+// The body of all variants of the fragment shader. When maps is a constant, the
+// compiler removes the code of the maps that are not bound.
+static inline vector4 shade(struct shader_context *input,
+                            const struct standard_constants *constants,
+                            uint32_t maps) {
+    vector3 position = *shader_context_vector3(input, WORLD_SPACE_POSITION);
+    vector3 camera_position = constants->camera_position;
+    vector3 light_direction = constants->light_direction;
+    vector3 illuminance = constants->illuminance;
+    vector3 ambient_luminance = constants->ambient_luminance;
 
     struct material_parameter material;
-    compute_material_parameter(&material, unif, texcoord);
-
-    vector3 diffuse_color = vector3_multiply_scalar(material.base_color,
-                                                    (1.0f - material.metallic));
-    float dielectric_f0 = 0.16f * material.reflectance * material.reflectance *
-                          (1.0f - material.metallic);
-    vector3 conductor_f0 =
-        vector3_multiply_scalar(material.base_color, material.metallic);
-    vector3 f0 = vector3_add_scalar(conductor_f0, dielectric_f0);
-    float a2 = perceptual_roughness_to_a2(material.roughness);
-    matrix3x3 tangent2world = construct_tangent2world(input);
+    compute_material_parameter(&material, constants, input, maps);
+
+    vector3 diffuse_color = constants->diffuse_color;
+    vector3 f0 = constants->f0;
+    if (maps & (BASE_COLOR_MAP | METALLIC_MAP | PACKED_MATERIAL_MAP)) {
+        compute_reflectance(&diffuse_color, &f0, material.base_color,
+                            material.metallic, constants->dielectric_f0);
+    }
+    float roughness = constants->alpha;
+    float a2 = constants->a2;
+    if (maps & (ROUGHNESS_MAP | PACKED_MATERIAL_MAP)) {
+        roughness = perceptual_roughness_to_roughness(material.roughness);
+        a2 = roughness * roughness;
+    }
+    bool fast = maps & FAST_MATH;
     // Normalized normal, in world space.
-    vector3 normal = matrix3x3_multiply_vector3(tangent2world, material.normal);
+    vector3 normal;
+    if (maps & NORMAL_MAP) {
+        matrix3x3 tangent2world = construct_tangent2world(input, fast);
+        normal = matrix3x3_multiply_vector3(tangent2world, material.normal);
+    } else {
+        // The tangent space normal is (0, 0, 1), that is the interpolated
+        // normal, the tangent and bitangent are not needed.
+        normal =
+            normalize(*shader_context_vector3(input, WORLD_SPACE_NORMAL), fast);
+    }
     // Normalized vector from the fragment to the camera, in world space.
-    vector3 view =
-        vector3_normalize(vector3_subtract(camera_position, position));
+    vector3 view = normalize(vector3_subtract(camera_position, position), fast);
     // Normalized halfway vector between the light direction and the view
     // direction, in world space.
-    vector3 halfway = vector3_normalize(vector3_add(view, light_direction));
+    vector3 halfway = normalize(vector3_add(view, light_direction), fast);
 
     float n_dot_v =
         float_max(vector3_dot(normal, view), 1e-4f);  // Avoid artifact.
     float n_dot_l = float_max(vector3_dot(normal, light_direction), 0.0f);
     float n_dot_h = float_max(vector3_dot(normal, halfway), 0.0f);
     float l_dot_h = float_max(vector3_dot(light_direction, halfway), 0.0f);
+    if (fast) {
+        // Approximately normalized vectors can give dot products slightly
+        // greater than 1, which d_ggx() turns into a spike on smooth surfaces.
+        n_dot_v = float_min(n_dot_v, 1.0f);
+        n_dot_l = float_min(n_dot_l, 1.0f);
+        n_dot_h = float_min(n_dot_h, 1.0f);
+        l_dot_h = float_min(l_dot_h, 1.0f);
+    }
 
-    float visibility = shadow(input, unif);
-    vector3 fr = specular_lobe(a2, f0, n_dot_h, n_dot_l, n_dot_v, l_dot_h);
+    vector3 fr = specular_lobe(roughness, a2, f0, n_dot_h, n_dot_l, n_dot_v,
+                               l_dot_h, fast);
     vector3 fd = diffuse_lobe(diffuse_color);
     // According to the ambient lighting is uniform:
     // ambient_illuminance = PI * ambient_luminance
@@ -213,9 +520,83 @@ vector4 standard_fragment_shader(struct shader_context *input,
     // ambient_output = fd * ambient_illuminance
     //                = diffuse_color * ambient_luminance
     vector3 ambient_output = vector3_multiply(diffuse_color, ambient_luminance);
-    vector3 output = vector3_multiply(vector3_add(fr, fd), illuminance);
-    output = vector3_multiply_scalar(output, n_dot_l);
-    output = vector3_multiply_scalar(output, visibility);
+    ambient_output =
+        vector3_multiply_scalar(ambient_output, material.occlusion);
+    vector3 output;
+    if (constants->lightmap.texture != NULL) {
+        // The baked lighting is illuminance * n_dot_l * visibility, with the
+        // normal of the lightmap texel.
+        vector2 texcoord = *shader_context_vector2(input, TEXCOORD);
+        vector4 baked = sampler_sample(&constants->lightmap, texcoord);
+        output = vector3_multiply(fr, illuminance);
+        output = vector3_multiply_scalar(output, n_dot_l * baked.a);
+        output = vector3_add(output, vector3_multiply(fd, vector4_to_3(baked)));
+    } else {
+        float visibility = shadow(input, constants);
+        output = vector3_multiply(vector3_add(fr, fd), illuminance);
+        output = vector3_multiply_scalar(output, n_dot_l);
+        output = vector3_multiply_scalar(output, visibility);
+    }
+    if (constants->light_count > 0) {
+        vector3 lights_output = shade_lights(constants, position, normal, view,
+                                             n_dot_v, fd, f0, roughness, a2,
+                                             fast);
+        output = vector3_add(output, lights_output);
+    }
     output = vector3_add(output, ambient_output);
     return vector3_to_4(output, 1.0f);
 }
+
+vector4 standard_fragment_shader(struct shader_context *input,
+                                 const void *uniform) {
+    const struct standard_constants *constants = uniform;
+    return shade(input, constants, constants->maps);
+}
+
+// Defines the reference and the fast math variants for a combination of maps.
+#define DEFINE_VARIANTS(maps)                                                  \
+    static vector4 standard_fragment_shader_##maps(                            \
+        struct shader_context *input, const void *uniform) {                   \
+        return shade(input, uniform, maps);                                    \
+    }                                                                          \
+    static vector4 standard_fragment_shader_fast_##maps(                       \
+        struct shader_context *input, const void *uniform) {                   \
+        return shade(input, uniform, (maps) | FAST_MATH);                      \
+    }
+#define VARIANTS(maps)                        \
+    [maps] = standard_fragment_shader_##maps, \
+    [(maps) | FAST_MATH] = standard_fragment_shader_fast_##maps
+
+DEFINE_VARIANTS(0)
+DEFINE_VARIANTS(1)
+DEFINE_VARIANTS(2)
+DEFINE_VARIANTS(3)
+DEFINE_VARIANTS(4)
+DEFINE_VARIANTS(5)
+DEFINE_VARIANTS(6)
+DEFINE_VARIANTS(7)
+DEFINE_VARIANTS(8)
+DEFINE_VARIANTS(9)
+DEFINE_VARIANTS(10)
+DEFINE_VARIANTS(11)
+DEFINE_VARIANTS(12)
+DEFINE_VARIANTS(13)
+DEFINE_VARIANTS(14)
+DEFINE_VARIANTS(15)
+DEFINE_VARIANTS(16)
+DEFINE_VARIANTS(17)
+DEFINE_VARIANTS(18)
+DEFINE_VARIANTS(19)
+
+// The variants indexed by the flags, the entries of invalid combinations of
+// flags are null pointers.
+static const fragment_shader variants[VARIANT_COUNT] = {
+    VARIANTS(0),  VARIANTS(1),  VARIANTS(2),  VARIANTS(3),  VARIANTS(4),
+    VARIANTS(5),  VARIANTS(6),  VARIANTS(7),  VARIANTS(8),  VARIANTS(9),
+    VARIANTS(10), VARIANTS(11), VARIANTS(12), VARIANTS(13), VARIANTS(14),
+    VARIANTS(15), VARIANTS(16), VARIANTS(17), VARIANTS(18), VARIANTS(19)};
+
+fragment_shader select_standard_fragment_shader(
+    const struct standard_uniform *uniform) {
+    return variants[get_material_maps(uniform)];
+}
@@ -6,6 +6,11 @@
 #ifndef FOOLRENDERER_SHADERS_STANDARD_H_
 #define FOOLRENDERER_SHADERS_STANDARD_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "graphics/light_clusters.h"
+#include "graphics/rasterizer.h"
 #include "graphics/shader_context.h"
 #include "graphics/texture.h"
 #include "math/matrix.h"
@@ -18,6 +23,48 @@
 // This model is composed of a diffuse term and a specular term. Can be used to
 // render common opaque metallic/non-metallic objects.
 
+// The maximum number of cascades of the directional light shadow map.
+#define MAX_SHADOW_CASCADES 4
+
+// The index of the vector4 variable holding the clip space position of the
+// vertex in the previous frame, pass it to set_previous_position_variable()
+// when drawing with motion vectors or a reprojection cache.
+#define STANDARD_PREVIOUS_CLIP_POSITION 0
+
+// How the material maps of the standard shader are stored.
+enum standard_material_maps {
+    // The metallic and roughness maps are separate textures, the value is read
+    // from the R component of each. There is no ambient occlusion.
+    STANDARD_MATERIAL_MAPS_SEPARATE,
+    // The ambient occlusion, roughness and metallic maps are packed into the R,
+    // G and B components of a single texture, see load_material_image(). Saves
+    // a sampling per fragment.
+    STANDARD_MATERIAL_MAPS_PACKED
+};
+
+enum standard_light_type { STANDARD_LIGHT_POINT, STANDARD_LIGHT_SPOT };
+
+// A punctual light, its intensity falls off with the square of the distance
+// and smoothly reaches 0 at its range. For the units and the falloff, refer to:
+// https://google.github.io/filament/Filament.html#lighting/directlighting/punctuallights
+struct standard_light {
+    enum standard_light_type type;
+    // Position in world space.
+    vector3 position;
+    // Normalized direction the spot light points to, in world space. Not used
+    // by point lights.
+    vector3 direction;
+    // Luminous intensity.
+    vector3 intensity;
+    // The distance beyond which the light does not affect surfaces.
+    float range;
+    // The cosines of the angles between the direction and the edges of the
+    // inner and outer cones of a spot light. The intensity is full inside the
+    // inner cone and falls to 0 at the outer cone. Not used by point lights.
+    float inner_cone_cos;
+    float outer_cone_cos;
+};
+
 struct standard_uniform {
     matrix4x4 local2world;
     matrix4x4 world2clip;
@@ -30,31 +77,87 @@ struct standard_uniform {
     // Directional light illuminance.
     vector3 illuminance;
     // Transform vertex positions from world space to directional light‘s light
-    // space.
+    // space. The light space is shared by all cascades, its x and y range from
+    // 0 to 1 over the whole shadowed region and z is the depth stored in the
+    // shadow maps.
     matrix4x4 world2light;
-    // Directional light shadow map
-    struct texture *shadow_map;
+    // The number of shadow cascades, from 1 to MAX_SHADOW_CASCADES, or 0 if the
+    // lightmap is bound.
+    uint32_t shadow_cascade_count;
+    // Map the x and y of the light space position to the texture coordinates
+    // of each cascade: (x * scale.x + offset.x, y * scale.y + offset.y), where
+    // the transform is stored as (scale.x, scale.y, offset.x, offset.y). Each
+    // fragment uses the first cascade that covers it, so the cascades should
+    // be ordered from the smallest to the largest.
+    vector4 shadow_cascade_transforms[MAX_SHADOW_CASCADES];
+    // The shadow map of each cascade, sampled by depth comparison. Fragments
+    // covered by none of the cascades are not shadowed.
+    struct sampler shadow_maps[MAX_SHADOW_CASCADES];
+    // The radius in texels of the percentage closer filtering kernel of the
+    // shadow map. 0 samples the shadow map once with the filter of the
+    // sampler, larger kernels soften the shadow edges.
+    uint32_t shadow_filter_radius;
+    // The lighting of the directional light baked by the lightmap baking
+    // shader, sampled with the texture coordinate of the mesh, see
+    // lightmap_baking.h. If bound, the diffuse term reads the baked lighting,
+    // the specular term reads the baked visibility, and the shadow maps are not
+    // sampled. A lightmap is only valid for a static model lit by the light it
+    // was baked with.
+    struct sampler lightmap;
     // Suppose the ambient lighting is uniform from all directions.
     vector3 ambient_luminance;
+    // The point and spot lights, in addition to the directional light. They
+    // cast no shadows. Each fragment only evaluates the lights assigned to its
+    // cluster, the bounding sphere of a light is its position and range.
+    const struct standard_light *lights;
+    uint32_t light_count;
+    // The lights assigned to the clusters of the view of this draw, see
+    // assign_lights_to_clusters(). Not used if light_count is 0.
+    const struct light_clusters *light_clusters;
+    // Whether to shade with approximations: normalization by an approximate
+    // inverse square root (the magnitude is off by less than 4.8e-6), an
+    // approximate logarithm for the level of detail of the maps (off by less
+    // than 5e-4 levels) and a visibility term without square roots (off by up
+    // to 26% at grazing angles, see Filament's approximated specular V).
+    bool fast_math;
+    // Whether the vertex shader outputs the position of the vertex in the
+    // previous frame, transformed by previous_local2clip, for the motion
+    // vectors and the reprojection cache. The transform should contain the
+    // jitter of the current frame, so that the motion vectors do not contain
+    // the difference of the jitters.
+    bool outputs_previous_position;
+    matrix4x4 previous_local2clip;
 
     ////////////////////////////////////////////////////////////////////////////
     //
     // Material parameters.
     //
     ////////////////////////////////////////////////////////////////////////////
-    struct texture *normal_map;
+    // The samplers of the material maps are bound once before drawing, so the
+    // format of the maps is not checked for every fragment. A map is absent if
+    // its sampler is unbound, see unbind_sampler(), the parameter then only
+    // comes from the value in the uniform. Maps whose pixels are all the same
+    // should be replaced with that value at load, see is_texture_constant().
+    enum standard_material_maps material_maps;
+    struct sampler normal_map;
     // Diffuse albedo for non-metallic surfaces and specular color for metallic
     // surfaces, should be in linear color space. A specular color reference
     // table for metals can be found in the Filament documentation:
     // https://google.github.io/filament/Filament.html#table_fnormalmetals
+    // Only the RGB components of the map are used, its A component is free to
+    // hold another channel.
     vector3 base_color;
-    struct texture *base_color_map;
+    struct sampler base_color_map;
     // Whether a surface appears to be dielectric (0.0) or conductor (1.0).
     float metallic;
-    struct texture *metallic_map;
+    struct sampler metallic_map;
     // Perceived smoothness (0.0) or roughness (1.0) of a surface.
     float roughness;
-    struct texture *roughness_map;
+    struct sampler roughness_map;
+    // Ambient occlusion, roughness and metallic maps packed in one texture,
+    // used instead of metallic_map and roughness_map in the packed mode. The
+    // ambient occlusion only attenuates the ambient lighting.
+    struct sampler occlusion_roughness_metallic_map;
     // Fresnel reflectance at normal incidence for dielectric surfaces, not
     // useful for conductor surfaces. A reference table of reflectance for
     // dielectric can be found in the Filament documentation:
@@ -73,7 +176,38 @@ vector4 standard_vertex_shader(struct shader_context *output,
                                const void *uniform,
                                const void *vertex_attribute);
 
+///
+/// \brief Prepares the constants of the standard fragment shaders from a
+///        standard_uniform.
+///
+/// The fragment shaders do not read the standard_uniform, but the constants
+/// prepared from it, so this function must be passed to set_uniform_prepare()
+/// before drawing with them.
+///
+void standard_prepare_uniform(void *prepared, const void *uniform);
+
+///
+/// \brief The fragment shader handling any combination of material maps.
+///
+/// Checks which material maps are bound for every fragment. Prefer the variant
+/// returned by select_standard_fragment_shader().
+///
 vector4 standard_fragment_shader(struct shader_context *input,
                                  const void *uniform);
 
+///
+/// \brief Selects the variant of the fragment shader compiled for the material
+///        maps bound in the uniform.
+///
+/// Each variant only contains the code of the maps it is compiled for, e.g.
+/// the variant without a normal map neither samples it nor builds the tangent
+/// space. The selection must be done again whenever a material map is bound or
+/// unbound, or the material_maps mode changes.
+///
+/// \param uniform The uniform that will be used for drawing.
+/// \return Returns the fragment shader to pass to set_fragment_shader().
+///
+fragment_shader select_standard_fragment_shader(
+    const struct standard_uniform *uniform);
+
 #endif  // FOOLRENDERER_SHADERS_STANDARD_H_
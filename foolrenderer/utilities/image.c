@@ -8,11 +8,26 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <tgafunc.h>
 
 #include "graphics/texture.h"
 
+// The header of a page file is made of the following 32-bit values, in the
+// byte order of the machine that saved it.
+#define PAGE_FILE_MAGIC 0x47505246  // "FRPG" in little-endian.
+enum page_file_header_field {
+    PAGE_FILE_MAGIC_FIELD,
+    PAGE_FILE_FORMAT_FIELD,
+    PAGE_FILE_WIDTH_FIELD,
+    PAGE_FILE_HEIGHT_FIELD,
+    PAGE_FILE_LEVEL_COUNT_FIELD,
+    PAGE_FILE_HEADER_FIELD_COUNT
+};
+#define PAGE_FILE_HEADER_SIZE (PAGE_FILE_HEADER_FIELD_COUNT * sizeof(uint32_t))
+
 // Convert TGA image pixels to texture's pixels or texture's pixels to TGA image
 // pixels. Each component of the pixel must be an 8-bit unsigned integer type,
 // and the number of components of pixels must be greater than or equal to 3.
@@ -41,7 +56,15 @@ static void modify_tga_image_pixel(uint8_t *image_data, tga_info *image_info) {
     }
 }
 
-struct texture *load_image(const char *filename, bool is_srgb_encoding) {
+// Releases the image data handed over to a texture.
+static void free_image_data(void *pixels, void *user_data) {
+    (void)user_data;
+    tga_free_data(pixels);
+}
+
+// Loads a TGA file as a texture in the linear layout, without a mipmap chain.
+static struct texture *load_tga_texture(const char *filename,
+                                        bool is_srgb_encoding) {
     if (filename == NULL || strlen(filename) == 0) {
         return NULL;
     }
@@ -60,32 +83,106 @@ struct texture *load_image(const char *filename, bool is_srgb_encoding) {
     // the image in the Y-axis direction.
     tga_image_flip_v(image_data, image_info);
 
-    struct texture *texture = NULL;
+    bool is_supported = true;
+    enum texture_format texture_format;
     if (image_pixel_format == TGA_PIXEL_BW8) {
-        texture = create_texture(TEXTURE_FORMAT_R8, width, height);
-        if (texture != NULL) {
-            set_texture_pixels(texture, image_data);
-        }
+        texture_format = TEXTURE_FORMAT_R8;
     } else if (image_pixel_format == TGA_PIXEL_RGB24) {
         modify_tga_image_pixel(image_data, image_info);
-        enum texture_format texture_format =
+        texture_format =
             is_srgb_encoding ? TEXTURE_FORMAT_SRGB8 : TEXTURE_FORMAT_RGB8;
-        texture = create_texture(texture_format, width, height);
-        if (texture != NULL) {
-            set_texture_pixels(texture, image_data);
-        }
     } else if (image_pixel_format == TGA_PIXEL_ARGB32) {
         modify_tga_image_pixel(image_data, image_info);
-        enum texture_format texture_format =
+        texture_format =
             is_srgb_encoding ? TEXTURE_FORMAT_SRGB8_A8 : TEXTURE_FORMAT_RGBA8;
-        texture = create_texture(texture_format, width, height);
-        if (texture != NULL) {
-            set_texture_pixels(texture, image_data);
-        }
+    } else {
+        is_supported = false;
     }
-
-    tga_free_data(image_data);
     tga_free_info(image_info);
+
+    // The texture takes over the image data instead of copying it.
+    struct texture *texture = NULL;
+    if (is_supported) {
+        texture = create_texture_from_buffer(texture_format, width, height,
+                                             image_data, free_image_data, NULL);
+    }
+    if (texture == NULL) {
+        tga_free_data(image_data);
+    }
+    return texture;
+}
+
+struct texture *load_image(const char *filename, bool is_srgb_encoding) {
+    struct texture *texture = load_tga_texture(filename, is_srgb_encoding);
+    if (texture != NULL) {
+        set_texture_layout(texture, TEXTURE_LAYOUT_TILED);
+        generate_texture_mipmaps(texture);
+    }
+    return texture;
+}
+
+struct texture *load_compressed_image(const char *filename,
+                                      enum texture_format format) {
+    bool is_srgb_encoding = format == TEXTURE_FORMAT_BC1_SRGB;
+    struct texture *source = load_image(filename, is_srgb_encoding);
+    if (source == NULL) {
+        return NULL;
+    }
+    struct texture *texture = compress_texture(source, format);
+    destroy_texture(source);
+    return texture;
+}
+
+struct texture *load_material_image(const char *occlusion_filename,
+                                    const char *roughness_filename,
+                                    const char *metallic_filename) {
+    const char *filenames[3] = {occlusion_filename, roughness_filename,
+                                metallic_filename};
+    struct texture *sources[3] = {NULL, NULL, NULL};
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool is_valid = true;
+    for (int i = 0; i < 3 && is_valid; i++) {
+        if (filenames[i] == NULL) {
+            continue;
+        }
+        sources[i] = load_tga_texture(filenames[i], false);
+        if (sources[i] == NULL ||
+            get_texture_format(sources[i]) != TEXTURE_FORMAT_R8) {
+            is_valid = false;
+        } else if (width == 0) {
+            width = get_texture_width(sources[i]);
+            height = get_texture_height(sources[i]);
+        } else if (get_texture_width(sources[i]) != width ||
+                   get_texture_height(sources[i]) != height) {
+            is_valid = false;
+        }
+    }
+    struct texture *texture = NULL;
+    if (is_valid && width != 0) {
+        texture = create_texture(TEXTURE_FORMAT_RGBA8, width, height);
+    }
+    if (texture != NULL) {
+        uint8_t *pixels = get_texture_pixels(texture);
+        size_t pixel_count = (size_t)width * height;
+        for (int c = 0; c < 3; c++) {
+            // A missing map is a constant 1.0, so that the material parameter
+            // is left unchanged.
+            const uint8_t *source =
+                sources[c] != NULL ? get_texture_pixels(sources[c]) : NULL;
+            for (size_t i = 0; i < pixel_count; i++) {
+                pixels[i * 4 + c] = source != NULL ? source[i] : 0xFF;
+            }
+        }
+        for (size_t i = 0; i < pixel_count; i++) {
+            pixels[i * 4 + 3] = 0xFF;
+        }
+        set_texture_layout(texture, TEXTURE_LAYOUT_TILED);
+        generate_texture_mipmaps(texture);
+    }
+    for (int i = 0; i < 3; i++) {
+        destroy_texture(sources[i]);
+    }
     return texture;
 }
 
@@ -150,3 +247,75 @@ bool save_image(struct texture *texture, const char *filename, bool alpha) {
     tga_free_info(image_info);
     return true;
 }
+
+bool save_texture_pages(const struct texture *texture, const char *filename) {
+    if (texture == NULL || filename == NULL) {
+        return false;
+    }
+    size_t page_size = get_texture_page_size(texture);
+    uint8_t *page = malloc(page_size);
+    if (page == NULL) {
+        return false;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        free(page);
+        return false;
+    }
+    uint32_t header[PAGE_FILE_HEADER_FIELD_COUNT];
+    header[PAGE_FILE_MAGIC_FIELD] = PAGE_FILE_MAGIC;
+    header[PAGE_FILE_FORMAT_FIELD] = get_texture_format(texture);
+    header[PAGE_FILE_WIDTH_FIELD] = get_texture_width(texture);
+    header[PAGE_FILE_HEIGHT_FIELD] = get_texture_height(texture);
+    header[PAGE_FILE_LEVEL_COUNT_FIELD] = get_texture_level_count(texture);
+    bool result = fwrite(header, sizeof(header), 1, file) == 1;
+    uint32_t page_count = get_texture_page_count(texture);
+    for (uint32_t i = 0; result && i < page_count; i++) {
+        result = get_texture_page(texture, i, page) &&
+                 fwrite(page, page_size, 1, file) == 1;
+    }
+    result = fclose(file) == 0 && result;
+    free(page);
+    return result;
+}
+
+static bool load_page_from_file(void *user_data, uint32_t page_index,
+                                void *pixels, size_t page_size) {
+    FILE *file = user_data;
+    long offset = (long)(PAGE_FILE_HEADER_SIZE + page_index * page_size);
+    if (fseek(file, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    return fread(pixels, page_size, 1, file) == 1;
+}
+
+static void close_page_file(void *user_data) { fclose(user_data); }
+
+struct texture *load_virtual_texture(const char *filename,
+                                     uint32_t cache_page_count) {
+    if (filename == NULL || strlen(filename) == 0) {
+        return NULL;
+    }
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    uint32_t header[PAGE_FILE_HEADER_FIELD_COUNT];
+    if (fread(header, sizeof(header), 1, file) != 1 ||
+        header[PAGE_FILE_MAGIC_FIELD] != PAGE_FILE_MAGIC) {
+        fclose(file);
+        return NULL;
+    }
+    struct texture_page_source source;
+    source.load_page = load_page_from_file;
+    source.release = close_page_file;
+    source.user_data = file;
+    struct texture *texture = create_virtual_texture(
+        (enum texture_format)header[PAGE_FILE_FORMAT_FIELD],
+        header[PAGE_FILE_WIDTH_FIELD], header[PAGE_FILE_HEIGHT_FIELD],
+        header[PAGE_FILE_LEVEL_COUNT_FIELD], cache_page_count, &source);
+    if (texture == NULL) {
+        fclose(file);
+    }
+    return texture;
+}
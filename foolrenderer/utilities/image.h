@@ -7,6 +7,7 @@
 #define FOOLRENDERER_UTILITIES_IMAGE_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "graphics/texture.h"
 
@@ -17,12 +18,56 @@
 /// pixel format of the current image. Only supports TGA images in the format
 /// TGA_PIXEL_BW8, TGA_PIXEL_RGB24 and TGA_PIXEL_ARGB32.
 ///
+/// The created texture uses TEXTURE_LAYOUT_TILED to speed up sampling, and its
+/// mipmap chain is generated after loading.
+///
 /// \param filename The TGA file to load.
 /// \param is_srgb_encoding Whether the pixel value is sRGB encoded.
 /// \return Returns a texture pointer on success, null pointer on failure.
 ///
 struct texture *load_image(const char *filename, bool is_srgb_encoding);
 
+///
+/// \brief Loads image data from a TGA format file and compresses it.
+///
+/// The image is loaded by load_image() and then compressed to the block
+/// compressed format with compress_texture(), including its mipmap chain. The
+/// uncompressed texture is destroyed after compression. Whether the pixel value
+/// is sRGB encoded is determined by the format, that is only
+/// TEXTURE_FORMAT_BC1_SRGB is sRGB encoded.
+///
+/// \param filename The TGA file to load.
+/// \param format The block compressed format to compress to. It must be
+///               compatible with the pixel format of the image, see
+///               compress_texture().
+/// \return Returns a texture pointer on success, null pointer on failure.
+///
+struct texture *load_compressed_image(const char *filename,
+                                      enum texture_format format);
+
+///
+/// \brief Loads occlusion, roughness and metallic maps from TGA format files
+///        and packs them into a single texture.
+///
+/// The maps are stored in the R (occlusion), G (roughness) and B (metallic)
+/// components of a TEXTURE_FORMAT_RGBA8 texture, the A component is set to
+/// 0xFF. A shader can then read the three parameters with a single sampling.
+/// Each image must be in the format TGA_PIXEL_BW8, and all images must have the
+/// same size. Any filename may be a null pointer, the component is then filled
+/// with 0xFF, but at least one must be given.
+///
+/// Like load_image(), the created texture uses TEXTURE_LAYOUT_TILED and its
+/// mipmap chain is generated after packing.
+///
+/// \param occlusion_filename The TGA file of the ambient occlusion map.
+/// \param roughness_filename The TGA file of the roughness map.
+/// \param metallic_filename The TGA file of the metallic map.
+/// \return Returns a texture pointer on success, null pointer on failure.
+///
+struct texture *load_material_image(const char *occlusion_filename,
+                                    const char *roughness_filename,
+                                    const char *metallic_filename);
+
 ///
 /// \brief Saves the texture as a TGA format file.
 ///
@@ -39,4 +84,36 @@ struct texture *load_image(const char *filename, bool is_srgb_encoding);
 ///
 bool save_image(struct texture *texture, const char *filename, bool alpha);
 
+///
+/// \brief Saves all pages of the texture as a page file.
+///
+/// The page file holds the format, size and level count of the texture, then
+/// every page in the order defined by get_texture_page(). It is the on-disk
+/// storage that load_virtual_texture() streams pages from.
+///
+/// Fails if texture or filename is a null pointer. Fails if the texture is a
+/// virtual texture. Fails if the file cannot be written.
+///
+/// \param texture Pointer to the texture to save.
+/// \param filename The file to save to.
+/// \return Returns true on success, false on failure.
+///
+bool save_texture_pages(const struct texture *texture, const char *filename);
+
+///
+/// \brief Opens a page file saved by save_texture_pages() as a virtual
+///        texture.
+///
+/// Only the header of the file is read here. Pages are read from the file the
+/// first time sampling touches them, and read again if they have been evicted
+/// from the cache in the meantime. The file stays open until the texture is
+/// destroyed. See create_virtual_texture() for details.
+///
+/// \param filename The page file to open.
+/// \param cache_page_count The maximum number of pages kept in memory.
+/// \return Returns a texture pointer on success, null pointer on failure.
+///
+struct texture *load_virtual_texture(const char *filename,
+                                     uint32_t cache_page_count);
+
 #endif  // FOOLRENDERER_UTILITIES_IMAGE_H_
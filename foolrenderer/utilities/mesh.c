@@ -6,6 +6,7 @@
 #include "utilities/mesh.h"
 
 #include <fast_obj.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -373,3 +374,12 @@ void get_mesh_tangent(vector4 *tangent, const struct mesh *mesh,
         *tangent = mesh->tangents[index];
     }
 }
+
+void get_mesh_bounds(vector3 *min, vector3 *max, const struct mesh *mesh) {
+    *min = (vector3){{INFINITY, INFINITY, INFINITY}};
+    *max = (vector3){{-INFINITY, -INFINITY, -INFINITY}};
+    for (uint32_t i = 0; i < mesh->vertex_count; i++) {
+        *min = vector3_min(*min, mesh->positions[i]);
+        *max = vector3_max(*max, mesh->positions[i]);
+    }
+}
@@ -137,4 +137,17 @@ void get_mesh_normal(vector3 *normal, const struct mesh *mesh,
 void get_mesh_tangent(vector4 *tangent, const struct mesh *mesh,
                       uint32_t triangle_index, uint32_t vertex_index);
 
+///
+/// \brief Gets the axis-aligned bounding box of the vertex positions of the
+///        mesh.
+///
+/// If the mesh has no vertex, min is set to positive infinity and max to
+/// negative infinity.
+///
+/// \param min Pointer to the vector where the minimum corner is stored.
+/// \param max Pointer to the vector where the maximum corner is stored.
+/// \param mesh The mesh to read.
+///
+void get_mesh_bounds(vector3 *min, vector3 *max, const struct mesh *mesh);
+
 #endif  // FOOLRENDERER_UTILITIES_MESH_H_
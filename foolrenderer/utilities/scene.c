@@ -0,0 +1,72 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#include "utilities/scene.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "graphics/framebuffer.h"
+#include "graphics/rasterizer.h"
+#include "math/math_utility.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+#include "shaders/shadow_casting.h"
+#include "utilities/mesh.h"
+
+matrix4x4 fit_light_space(vector3 light_direction, vector3 bounds_min,
+                          vector3 bounds_max) {
+    vector3 center =
+        vector3_multiply_scalar(vector3_add(bounds_min, bounds_max), 0.5f);
+    vector3 direction = vector3_normalize(light_direction);
+    vector3 up = fabsf(direction.y) > 0.99f ? (vector3){{1.0f, 0.0f, 0.0f}}
+                                            : (vector3){{0.0f, 1.0f, 0.0f}};
+    matrix4x4 world2view =
+        matrix4x4_look_at(vector3_add(center, direction), center, up);
+    vector3 light_min = (vector3){{INFINITY, INFINITY, INFINITY}};
+    vector3 light_max = (vector3){{-INFINITY, -INFINITY, -INFINITY}};
+    for (uint32_t i = 0; i < 8; i++) {
+        vector3 corner = {{i & 1 ? bounds_max.x : bounds_min.x,
+                           i & 2 ? bounds_max.y : bounds_min.y,
+                           i & 4 ? bounds_max.z : bounds_min.z}};
+        vector4 view = matrix4x4_multiply_vector4(world2view,
+                                                  vector3_to_4(corner, 1.0f));
+        light_min = vector3_min(light_min, vector4_to_3(view));
+        light_max = vector3_max(light_max, vector4_to_3(view));
+    }
+    // The light looks along the negative z axis of its view space.
+    vector3 light_center =
+        vector3_multiply_scalar(vector3_add(light_min, light_max), 0.5f);
+    vector3 light_extent =
+        vector3_multiply_scalar(vector3_subtract(light_max, light_min), 0.5f);
+    matrix4x4 view2clip = matrix4x4_orthographic(
+        float_max(light_extent.x, 1e-4f), float_max(light_extent.y, 1e-4f),
+        -light_max.z, -light_min.z + 1e-4f);
+    matrix4x4 recenter = matrix4x4_translate(
+        (vector3){{-light_center.x, -light_center.y, 0.0f}});
+    return matrix4x4_multiply(view2clip,
+                              matrix4x4_multiply(recenter, world2view));
+}
+
+void draw_shadow_casters(struct framebuffer *framebuffer,
+                         const struct mesh *mesh, matrix4x4 world2clip) {
+    set_vertex_shader(shadow_casting_vertex_shader);
+    set_fragment_shader(shadow_casting_fragment_shader);
+    set_uniform_prepare(NULL);
+    struct shadow_casting_uniform uniform;
+    // No rotation, scaling, or translation of the model, so the local2clip
+    // matrix is the world2clip matrix.
+    uniform.local2clip = world2clip;
+    for (size_t t = 0; t < mesh->triangle_count; t++) {
+        struct shadow_casting_vertex_attribute attributes[3];
+        const void *attribute_ptrs[3];
+        for (uint32_t v = 0; v < 3; v++) {
+            get_mesh_position(&attributes[v].position, mesh, t, v);
+            attribute_ptrs[v] = attributes + v;
+        }
+        draw_triangle(framebuffer, &uniform, attribute_ptrs);
+    }
+}
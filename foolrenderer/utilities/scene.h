@@ -0,0 +1,60 @@
+// Copyright (c) Caden Ji. All rights reserved.
+//
+// Licensed under the MIT License. See LICENSE file in the project root for
+// license information.
+
+#ifndef FOOLRENDERER_UTILITIES_SCENE_H_
+#define FOOLRENDERER_UTILITIES_SCENE_H_
+
+#include "graphics/framebuffer.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+#include "utilities/mesh.h"
+
+// The scene shared by the renderer and the lightmap baker. The baked lighting
+// is only valid for the light the renderer uses, so both take it from here.
+
+///
+/// \brief The direction toward the directional light of the scene, not
+///        normalized.
+///
+#define SCENE_LIGHT_DIRECTION ((const vector3){{1.0f, 4.0f, -1.0f}})
+
+///
+/// \brief The illuminance of the directional light of the scene.
+///
+#define SCENE_LIGHT_ILLUMINANCE ((const vector3){{4.0f, 4.0f, 4.0f}})
+
+///
+/// \brief Fits an orthographic light space to an axis-aligned bounding box.
+///
+/// The light looks along the negative light direction, and the clip space
+/// encloses the box tightly, so every shadow caster inside the box is rendered
+/// into the shadow map and every receiver inside it is covered.
+///
+/// \param light_direction The direction toward the light, not necessarily
+///                        normalized.
+/// \param bounds_min The minimum corner of the box in world space.
+/// \param bounds_max The maximum corner of the box in world space.
+/// \return Returns the world2clip matrix of the light.
+///
+matrix4x4 fit_light_space(vector3 light_direction, vector3 bounds_min,
+                          vector3 bounds_max);
+
+///
+/// \brief Draws the triangles of a mesh into the depth buffer of a shadow
+///        map framebuffer.
+///
+/// Sets the shaders of shadow_casting.h and draws every triangle of the mesh
+/// with the depth test of the rasterizer, so that the nearest caster is kept.
+/// The mesh is not transformed, its positions are in world space. The caller
+/// sets the viewport and clears the framebuffer.
+///
+/// \param framebuffer The framebuffer of the shadow map.
+/// \param mesh The mesh casting shadows.
+/// \param world2clip The world2clip matrix of the light.
+///
+void draw_shadow_casters(struct framebuffer *framebuffer,
+                         const struct mesh *mesh, matrix4x4 world2clip);
+
+#endif  // FOOLRENDERER_UTILITIES_SCENE_H_